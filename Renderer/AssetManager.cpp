@@ -0,0 +1,209 @@
+#include "AssetManager.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "..\utils.h"
+#include "..\Scene\CookedModel.h"
+
+TextureReference AssetManager::AcquireTexture(const std::string& path, const std::string& tag)
+{
+	const uint64_t hash = HashPath(path);
+	if (hash == 0)
+	{
+		LogError("ASSET_MANAGER: Could not read " + path);
+		return nullptr;
+	}
+
+	// Entries are only erased by Update, which runs on this thread too, so the entry outlives the unlocked decode
+	std::unique_lock lock(m_Mutex);
+	Entry& entry = m_Entries[hash];
+	entry.LastUsed = m_Frame;
+	if (auto reference = entry.Reference.lock())
+	{
+		m_Stats.Hits++;
+		return reference;
+	}
+
+	if (entry.Texture)
+	{
+		m_Stats.Hits++;
+	}
+	else
+	{
+		ImageData image = entry.Image;
+		if (image)
+		{
+			m_Stats.CpuHits++;
+		}
+		else
+		{
+			m_Stats.Misses++;
+			lock.unlock();
+			image = ImageData::Load(path);
+			lock.lock();
+			if (!image)
+			{
+				LogError("ASSET_MANAGER: Could not decode " + path);
+				return nullptr;
+			}
+			CacheImage(entry, image);
+		}
+
+		entry.Texture = g_Resources->Textures.Add(std::make_shared<Tex2D>(image, path, tag));
+		entry.GpuBytes = GetGpuBytes(image);
+	}
+
+	auto reference = std::make_shared<const TextureAsset>(TextureAsset{ entry.Texture, hash });
+	entry.Reference = reference;
+	return reference;
+}
+
+size_t AssetManager::PrefetchTexture(const std::string& path)
+{
+	const uint64_t hash = HashPath(path);
+	if (hash == 0)
+		return 0;
+
+	{
+		std::lock_guard lock(m_Mutex);
+		if (const auto iterator = m_Entries.find(hash); iterator != m_Entries.end() && (iterator->second.Texture || iterator->second.Image))
+		{
+			Entry& entry = iterator->second;
+			entry.LastUsed = m_Frame;
+			return entry.Texture ? 0 : GetGpuBytes(entry.Image);
+		}
+	}
+
+	ImageData image = ImageData::Load(path);
+	if (!image)
+		return 0;
+
+	std::lock_guard lock(m_Mutex);
+	Entry& entry = m_Entries[hash];
+	entry.LastUsed = m_Frame;
+	CacheImage(entry, std::move(image));
+	return entry.Texture ? 0 : GetGpuBytes(entry.Image);
+}
+
+JobHandle AssetManager::PrefetchTextureAsync(const std::string& path)
+{
+	return ThreadPool::Get().Submit([manager = shared_from_this(), path] { manager->PrefetchTexture(path); });
+}
+
+void AssetManager::Update()
+{
+	std::lock_guard lock(m_Mutex);
+	m_Frame++;
+
+	// Textures still referenced count as used, so an unreferenced one's age starts when its last reference went
+	size_t gpuBytes = 0, cpuBytes = 0;
+	std::vector<std::pair<uint64_t, uint64_t>> gpuCandidates, cpuCandidates; // Last used and hash
+	for (auto& [hash, entry] : m_Entries)
+	{
+		if (!entry.Reference.expired())
+			entry.LastUsed = m_Frame;
+
+		if (entry.Texture)
+		{
+			gpuBytes += entry.GpuBytes;
+			if (entry.Reference.expired() && m_Frame >= entry.LastUsed + s_ReleaseDelay)
+				gpuCandidates.emplace_back(entry.LastUsed, hash);
+		}
+		if (entry.Image)
+		{
+			cpuBytes += entry.CpuBytes;
+			cpuCandidates.emplace_back(entry.LastUsed, hash);
+		}
+	}
+
+	if (gpuBytes > m_GpuBudget)
+	{
+		std::sort(gpuCandidates.begin(), gpuCandidates.end());
+		for (auto it = gpuCandidates.begin(); it != gpuCandidates.end() && gpuBytes > m_GpuBudget; ++it)
+		{
+			Entry& entry = m_Entries.at(it->second);
+			g_Resources->Textures.Remove(entry.Texture);
+			entry.Texture = TextureHandle();
+			gpuBytes -= entry.GpuBytes;
+			m_Stats.Evictions++;
+		}
+	}
+
+	if (cpuBytes > m_CpuBudget)
+	{
+		std::sort(cpuCandidates.begin(), cpuCandidates.end());
+		for (auto it = cpuCandidates.begin(); it != cpuCandidates.end() && cpuBytes > m_CpuBudget; ++it)
+		{
+			Entry& entry = m_Entries.at(it->second);
+			entry.Image = ImageData();
+			cpuBytes -= entry.CpuBytes;
+			m_Stats.CpuEvictions++;
+		}
+	}
+
+	// Entries with nothing left in either cache are forgotten, the path hashes stay
+	for (auto it = m_Entries.begin(); it != m_Entries.end();)
+		it = !it->second.Texture && !it->second.Image ? m_Entries.erase(it) : std::next(it);
+}
+
+void AssetManager::SetBudgets(const size_t cpuBudget, const size_t gpuBudget)
+{
+	std::lock_guard lock(m_Mutex);
+	m_CpuBudget = cpuBudget;
+	m_GpuBudget = gpuBudget;
+}
+
+AssetStats AssetManager::GetStats() const
+{
+	std::lock_guard lock(m_Mutex);
+	AssetStats stats = m_Stats;
+	for (const auto& [hash, entry] : m_Entries)
+	{
+		if (entry.Texture)
+		{
+			stats.GpuTextures++;
+			stats.GpuBytes += entry.GpuBytes;
+		}
+		if (entry.Image)
+		{
+			stats.CpuImages++;
+			stats.CpuBytes += entry.CpuBytes;
+		}
+	}
+	return stats;
+}
+
+uint64_t AssetManager::HashPath(const std::string& path)
+{
+	std::error_code error;
+	const auto writeTime = std::filesystem::last_write_time(path, error);
+	const uintmax_t size = error ? 0 : std::filesystem::file_size(path, error);
+	if (error)
+		return 0;
+
+	{
+		std::lock_guard lock(m_Mutex);
+		if (const auto iterator = m_Paths.find(path); iterator != m_Paths.end()
+			&& iterator->second.WriteTime == writeTime && iterator->second.Size == size)
+			return iterator->second.Hash;
+	}
+
+	const uint64_t hash = CookedModel::HashFile(path);
+	if (hash == 0)
+		return 0;
+
+	std::lock_guard lock(m_Mutex);
+	m_Paths[path] = { writeTime, size, hash };
+	return hash;
+}
+
+void AssetManager::CacheImage(Entry& entry, ImageData image)
+{
+	if (entry.Image)
+		return;
+
+	entry.CpuBytes = static_cast<size_t>(image.Width) * image.Height * image.Channels;
+	entry.Image = std::move(image);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "..\ThreadPool.h"
+#include "..\Scene\Components\Texture.h"
+#include "Resources.h"
+
+// A texture the asset manager keeps on the GPU for as long as a reference to it lives
+struct TextureAsset
+{
+	TextureHandle Texture;
+	uint64_t Hash = 0; // Of the image file's contents
+};
+
+struct AssetStats
+{
+	uint64_t Hits = 0; // Acquired while already on the GPU
+	uint64_t CpuHits = 0; // Uploaded from an image still decoded in the CPU cache
+	uint64_t Misses = 0; // Read and decoded from the file
+	uint64_t Evictions = 0; // Textures dropped from the GPU
+	uint64_t CpuEvictions = 0; // Decoded images dropped from the CPU cache
+	size_t GpuTextures = 0, GpuBytes = 0;
+	size_t CpuImages = 0, CpuBytes = 0;
+};
+
+/* One cache of texture files for the whole process, keyed by a hash of their contents, so identical images are decoded
+* and uploaded once however many paths and models refer to them.
+* Acquiring a texture returns a reference, and the texture stays on the GPU while any reference to it lives. Once the
+* last one goes the texture is kept for reuse, and only evicted, least recently used first, when resident textures
+* exceed the GPU budget. Decoded images are cached on the CPU under a budget of their own: images prefetched on workers
+* wait there to be acquired, and those of uploaded textures stay so an evicted texture can return without decoding.
+* Paths remember their hash along with the file's size and write time, so a file is only hashed again once it changes.
+*/
+class AssetManager : public std::enable_shared_from_this<AssetManager>
+{
+public:
+	explicit AssetManager(size_t cpuBudget = 256 << 20, size_t gpuBudget = 512 << 20)
+		: m_CpuBudget(cpuBudget), m_GpuBudget(gpuBudget) {}
+	AssetManager(const AssetManager&) = delete;
+	AssetManager& operator=(const AssetManager&) = delete;
+
+	// Returns the texture holding a file's image, uploading it unless the same image is already on the GPU. The first
+	// path and tag an image is acquired with name its texture. GL thread only. Returns nullptr if the file can't be read
+	TextureReference AcquireTexture(const std::string& path, const std::string& tag = std::string());
+	// Decodes a file into the CPU cache unless its image is cached already, so acquiring it only has to upload it.
+	// Safe on any thread. Returns the bytes acquiring it would add to the GPU, 0 if it is resident or can't be read
+	size_t PrefetchTexture(const std::string& path);
+	// Prefetches on the worker pool
+	JobHandle PrefetchTextureAsync(const std::string& path);
+
+	// Evicts unreferenced textures and cached images, least recently used first, until both fit their budgets.
+	// Call once per frame on the GL thread
+	void Update();
+
+	void SetBudgets(size_t cpuBudget, size_t gpuBudget);
+	AssetStats GetStats() const;
+
+	~AssetManager() = default;
+
+private:
+	struct Entry
+	{
+		TextureHandle Texture; // Null while the image is only cached on the CPU
+		std::weak_ptr<const TextureAsset> Reference;
+		ImageData Image; // Null once dropped from the CPU cache
+		size_t GpuBytes = 0, CpuBytes = 0;
+		uint64_t LastUsed = 0; // The last update it was acquired, prefetched or referenced in
+	};
+
+	struct PathHash
+	{
+		std::filesystem::file_time_type WriteTime;
+		uintmax_t Size = 0;
+		uint64_t Hash = 0;
+	};
+
+	// Hashes a file's contents, reusing the last hash while its size and write time match. Returns 0 if it can't be read
+	uint64_t HashPath(const std::string& path);
+	// Keeps a decoded image in the CPU cache, unless the entry has one already
+	static void CacheImage(Entry& entry, ImageData image);
+	// An RGBA8 texture with its mip chain
+	static size_t GetGpuBytes(const ImageData& image) { return static_cast<size_t>(image.Width) * image.Height * 4 * 4 / 3; }
+
+private:
+	mutable std::mutex m_Mutex;
+	std::unordered_map<uint64_t, Entry> m_Entries;
+	std::unordered_map<std::string, PathHash> m_Paths;
+	size_t m_CpuBudget = 0, m_GpuBudget = 0;
+	uint64_t m_Frame = 0;
+	AssetStats m_Stats;
+
+	static constexpr uint64_t s_ReleaseDelay = 3; // Updates before an unreferenced texture may go, snapshots in flight may still draw it
+};
+
+inline std::shared_ptr<AssetManager> g_AssetManager;
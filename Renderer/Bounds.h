@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm\glm.hpp>
+
+// An axis aligned box
+struct Bounds
+{
+	glm::vec3 Min = glm::vec3(0.0f);
+	glm::vec3 Max = glm::vec3(0.0f);
+
+	// The box around this one once transformed, found from its centre and extents instead of all eight corners
+	Bounds Transformed(const glm::mat4& transform) const
+	{
+		const glm::vec3 center = glm::vec3(transform * glm::vec4((Min + Max) * 0.5f, 1.0f));
+		const glm::mat3 absolute(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+		const glm::vec3 extent = absolute * ((Max - Min) * 0.5f);
+		return { center - extent, center + extent };
+	}
+
+	bool Overlaps(const Bounds& other) const
+	{
+		return glm::all(glm::lessThanEqual(Min, other.Max)) && glm::all(glm::lessThanEqual(other.Min, Max));
+	}
+
+	bool operator==(const Bounds& other) const { return Min == other.Min && Max == other.Max; }
+	bool operator!=(const Bounds& other) const { return !(*this == other); }
+};
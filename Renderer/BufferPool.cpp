@@ -0,0 +1,127 @@
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "UploadManager.h"
+#include "..\utils.h"
+
+GLuint BufferAllocation::GetBuffer() const
+{
+	const auto pool = m_Pool.lock();
+	return pool ? pool->GetBuffer() : 0;
+}
+
+BufferAllocation::~BufferAllocation()
+{
+	if (const auto pool = m_Pool.lock())
+		pool->Free(*this);
+}
+
+BufferPool::BufferPool(std::string name, const GLsizeiptr capacity)
+	: m_Name(std::move(name)), m_Capacity(static_cast<GLsizeiptr>(ToUnits(capacity)) * BufferAllocation::s_Granularity), m_Allocator(ToUnits(capacity))
+{
+	// Dynamic storage lets uploads fall back to glNamedBufferSubData when nothing is staging them
+	glCreateBuffers(1, &m_Buffer);
+	glNamedBufferStorage(m_Buffer, m_Capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+}
+
+std::shared_ptr<BufferAllocation> BufferPool::Allocate(const GLsizeiptr size)
+{
+	const uint32_t units = ToUnits(size);
+	OffsetAllocator::Allocation allocation = m_Allocator.Allocate(units);
+
+	// There is enough room in total, it's just split into holes that are too small
+	if (!allocation.IsValid() && m_Allocator.GetFreeStorage() >= units)
+	{
+		Defragment();
+		allocation = m_Allocator.Allocate(units);
+	}
+
+	if (!allocation.IsValid())
+	{
+		const GLsizeiptr usedBytes = m_Capacity - GetFreeBytes();
+		Defragment(std::max(m_Capacity * 2, usedBytes + static_cast<GLsizeiptr>(units) * BufferAllocation::s_Granularity));
+		allocation = m_Allocator.Allocate(units);
+	}
+
+	if (!allocation.IsValid())
+	{
+		LogError("BUFFER_POOL: " + m_Name + " could not fit " + std::to_string(size) + " bytes");
+		return nullptr;
+	}
+
+	auto result = std::shared_ptr<BufferAllocation>(new BufferAllocation(weak_from_this(), allocation, size));
+	m_Live.insert(result.get());
+	return result;
+}
+
+void BufferPool::Defragment(GLsizeiptr capacity)
+{
+	if (capacity == 0)
+		capacity = m_Capacity;
+	capacity = static_cast<GLsizeiptr>(ToUnits(std::max(capacity, m_Capacity - GetFreeBytes()))) * BufferAllocation::s_Granularity;
+
+	// Queued uploads were recorded against the current buffer and offsets, so land them before anything moves
+	if (g_UploadManager)
+		g_UploadManager->Finish();
+
+	auto live = std::vector<BufferAllocation*>(m_Live.begin(), m_Live.end());
+	std::sort(live.begin(), live.end(), [](const BufferAllocation* a, const BufferAllocation* b)
+		{ return a->m_Allocation.Offset < b->m_Allocation.Offset; });
+
+	GLuint buffer = 0;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	// Reallocating in offset order from an empty allocator packs everything against the start
+	m_Allocator.Reset(ToUnits(capacity));
+	for (auto* allocation : live)
+	{
+		const uint32_t units = ToUnits(allocation->m_Size);
+		const GLintptr oldOffset = allocation->GetOffset();
+		allocation->m_Allocation = m_Allocator.Allocate(units);
+		allocation->m_Offset.store(allocation->m_Allocation.Offset, std::memory_order_relaxed);
+		glCopyNamedBufferSubData(m_Buffer, buffer, oldOffset, allocation->GetOffset(),
+			static_cast<GLsizeiptr>(units) * BufferAllocation::s_Granularity);
+	}
+
+	glDeleteBuffers(1, &m_Buffer);
+	m_Buffer = buffer;
+	m_Capacity = capacity;
+	m_Relocations.fetch_add(1, std::memory_order_release);
+
+	for (const auto* allocation : live)
+	{
+		if (allocation->m_OnRelocate)
+			allocation->m_OnRelocate(*allocation);
+	}
+
+	Log("BUFFER_POOL: " + m_Name + " defragmented, " + std::to_string(live.size()) + " allocations in "
+		+ std::to_string(m_Capacity) + " bytes");
+}
+
+float BufferPool::GetFragmentation() const
+{
+	const uint32_t freeStorage = m_Allocator.GetFreeStorage();
+	if (freeStorage == 0)
+		return 0.0f;
+
+	return 1.0f - static_cast<float>(m_Allocator.GetLargestFreeRegion()) / static_cast<float>(freeStorage);
+}
+
+BufferPool::~BufferPool()
+{
+	glDeleteBuffers(1, &m_Buffer);
+}
+
+void BufferPool::Free(BufferAllocation& allocation)
+{
+	m_Allocator.Free(allocation.m_Allocation);
+	m_Live.erase(&allocation);
+}
+
+uint32_t BufferPool::ToUnits(const GLsizeiptr bytes)
+{
+	return static_cast<uint32_t>((std::max<GLsizeiptr>(bytes, 1) + BufferAllocation::s_Granularity - 1) / BufferAllocation::s_Granularity);
+}
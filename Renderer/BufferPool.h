@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+#include "OffsetAllocator.h"
+
+class BufferPool;
+
+// A range of a pooled GPU buffer, returned to its pool as soon as the last reference goes away
+class BufferAllocation
+{
+public:
+	BufferAllocation(const BufferAllocation&) = delete;
+	BufferAllocation& operator=(const BufferAllocation&) = delete;
+
+	GLuint GetBuffer() const;
+	// Safe to read from any thread, defragmentation publishes moved offsets atomically
+	GLintptr GetOffset() const { return static_cast<GLintptr>(m_Offset.load(std::memory_order_relaxed)) * s_Granularity; }
+	GLsizeiptr GetSize() const { return m_Size; }
+
+	// Called whenever defragmentation moves the range, so anything holding its buffer or offset can rebind
+	void SetRelocationCallback(std::function<void(const BufferAllocation&)> onRelocate) { m_OnRelocate = std::move(onRelocate); }
+
+	~BufferAllocation();
+
+private:
+	friend class BufferPool;
+
+	BufferAllocation(std::weak_ptr<BufferPool> pool, OffsetAllocator::Allocation allocation, GLsizeiptr size)
+		: m_Pool(std::move(pool)), m_Allocation(allocation), m_Offset(allocation.Offset), m_Size(size) {}
+
+	static constexpr GLsizeiptr s_Granularity = 16; // Bytes per allocator unit, also the offset alignment
+
+private:
+	std::weak_ptr<BufferPool> m_Pool;
+	OffsetAllocator::Allocation m_Allocation; // Only touched by the pool, on the GL thread
+	std::atomic<uint32_t> m_Offset; // Of m_Allocation, in allocator units, for readers on other threads
+	GLsizeiptr m_Size = 0;
+	std::function<void(const BufferAllocation&)> m_OnRelocate;
+};
+
+/* One large immutable GPU buffer carved into ranges by an OffsetAllocator.
+* Meshes share a handful of these pools instead of owning a buffer each. When an allocation doesn't fit,
+* the pool first compacts its live ranges and, failing that, grows into a larger buffer.
+*/
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+public:
+	BufferPool(std::string name, GLsizeiptr capacity);
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+
+	std::shared_ptr<BufferAllocation> Allocate(GLsizeiptr size);
+
+	// Packs every live allocation to the front of a new buffer of at least capacity bytes (the current capacity if 0)
+	void Defragment(GLsizeiptr capacity = 0);
+
+	GLuint GetBuffer() const { return m_Buffer; }
+	GLsizeiptr GetCapacity() const { return m_Capacity; }
+	GLsizeiptr GetFreeBytes() const { return static_cast<GLsizeiptr>(m_Allocator.GetFreeStorage()) * BufferAllocation::s_Granularity; }
+	// 0 when all free space is one block, approaching 1 as it splinters into small holes
+	float GetFragmentation() const;
+	// Counts how often allocations have moved. Offsets recorded under an older count are stale
+	uint32_t GetRelocationCount() const { return m_Relocations.load(std::memory_order_acquire); }
+
+	~BufferPool();
+
+private:
+	friend class BufferAllocation;
+
+	void Free(BufferAllocation& allocation);
+	static uint32_t ToUnits(GLsizeiptr bytes);
+
+private:
+	std::string m_Name;
+	GLuint m_Buffer = 0;
+	GLsizeiptr m_Capacity = 0;
+	OffsetAllocator m_Allocator;
+	std::unordered_set<BufferAllocation*> m_Live;
+	std::atomic<uint32_t> m_Relocations = 0;
+};
+
+inline std::shared_ptr<BufferPool> g_VertexPool;
+inline std::shared_ptr<BufferPool> g_IndexPool;
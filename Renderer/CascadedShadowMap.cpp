@@ -0,0 +1,258 @@
+#include "CascadedShadowMap.h"
+
+#include <glm\gtc\matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "FrameSnapshot.h"
+#include "Renderer.h"
+
+CascadedShadowMap::CascadedShadowMap(const GLsizei resolution, const float shadowDistance)
+	: m_Resolution(resolution), m_ShadowDistance(shadowDistance), m_DepthShader("shadowDepth.vert", "shadowDepth.frag")
+{
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_Texture);
+	glTextureStorage3D(m_Texture, 1, GL_DEPTH_COMPONENT32F, resolution, resolution, s_CascadeCount);
+	glTextureParameteri(m_Texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_Texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_Texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTextureParameteri(m_Texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	constexpr float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTextureParameterfv(m_Texture, GL_TEXTURE_BORDER_COLOR, border);
+
+	// Linear filtering on a comparison sampler gives 2x2 percentage closer filtering per tap for free
+	glTextureParameteri(m_Texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTextureParameteri(m_Texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glCreateFramebuffers(1, &m_Framebuffer);
+	glNamedFramebufferDrawBuffer(m_Framebuffer, GL_NONE);
+	glNamedFramebufferReadBuffer(m_Framebuffer, GL_NONE);
+}
+
+void CascadedShadowMap::Update(const FrameSnapshot& snapshot)
+{
+	m_RedrawnTexels = 0;
+	m_Active = snapshot.Sun.has_value();
+	if (!m_Active)
+		return;
+
+	const glm::vec3 direction = glm::normalize(snapshot.Sun->m_Direction);
+	if (glm::dot(direction, m_LightDirection) < 0.99999f)
+	{
+		m_LightDirection = direction;
+		const glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		m_LightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+		for (auto& cascade : m_Cascades)
+			cascade.Valid = false;
+	}
+
+	// A bigger jump than this snapshot accounts for means changes went out in a snapshot that was never drawn
+	const uint64_t expectedRevision = m_StaticShadowRevision + (snapshot.StaticShadowChanges.empty() ? 0 : 1);
+	if (snapshot.StaticShadowRevision != expectedRevision)
+	{
+		for (int i = s_FirstCachedCascade; i < s_CascadeCount; i++)
+			m_Cascades[i].Valid = false;
+	}
+	m_StaticShadowRevision = snapshot.StaticShadowRevision;
+
+	// Camera planes, from a glm::perspective projection
+	const glm::mat4& projection = snapshot.Projection;
+	const float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	const float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	const float shadowFar = std::min(farPlane, m_ShadowDistance);
+
+	// World space frustum corners. Points along each corner ray are linear in view depth
+	const glm::mat4 inverseViewProjection = glm::inverse(projection * snapshot.View);
+	std::array<glm::vec3, 4> nearCorners, farCorners;
+	for (int corner = 0; corner < 4; corner++)
+	{
+		const float x = corner & 1 ? 1.0f : -1.0f;
+		const float y = corner & 2 ? 1.0f : -1.0f;
+		const glm::vec4 nearCorner = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+		const glm::vec4 farCorner = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+		nearCorners[corner] = glm::vec3(nearCorner) / nearCorner.w;
+		farCorners[corner] = glm::vec3(farCorner) / farCorner.w;
+	}
+
+	m_LightBounds.resize(snapshot.Draws.size());
+	for (size_t i = 0; i < snapshot.Draws.size(); i++)
+		m_LightBounds[i] = snapshot.Draws[i].WorldBounds.Transformed(m_LightView);
+	m_SubMeshLightBounds.resize(snapshot.SubMeshes.size());
+	for (size_t i = 0; i < snapshot.SubMeshes.size(); i++)
+		m_SubMeshLightBounds[i] = snapshot.SubMeshes[i].WorldBounds.Transformed(m_LightView);
+
+	glViewport(0, 0, m_Resolution, m_Resolution);
+	glEnable(GL_SCISSOR_TEST);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glDepthMask(GL_TRUE);
+	m_DepthShader.Use();
+
+	const Region everything = { 0, 0, m_Resolution, m_Resolution };
+	float sliceNear = nearPlane;
+	for (int i = 0; i < s_CascadeCount; i++)
+	{
+		const float fraction = static_cast<float>(i + 1) / static_cast<float>(s_CascadeCount);
+		const float sliceFar = s_SplitBlend * nearPlane * std::pow(shadowFar / nearPlane, fraction)
+			+ (1.0f - s_SplitBlend) * (nearPlane + (shadowFar - nearPlane) * fraction);
+
+		// Bounding sphere of the slice. Its radius only depends on the projection, so the window keeps its size as the camera turns
+		std::array<glm::vec3, 8> corners;
+		const float nearT = (sliceNear - nearPlane) / (farPlane - nearPlane);
+		const float farT = (sliceFar - nearPlane) / (farPlane - nearPlane);
+		glm::vec3 center(0.0f);
+		for (int corner = 0; corner < 4; corner++)
+		{
+			corners[corner] = glm::mix(nearCorners[corner], farCorners[corner], nearT);
+			corners[corner + 4] = glm::mix(nearCorners[corner], farCorners[corner], farT);
+			center += corners[corner] + corners[corner + 4];
+		}
+		center /= 8.0f;
+
+		float radius = 0.0f;
+		for (const glm::vec3& corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+		sliceNear = sliceFar;
+
+		const glm::vec3 lightCenter = glm::vec3(m_LightView * glm::vec4(center, 1.0f));
+		Cascade& cascade = m_Cascades[i];
+		if (i < s_FirstCachedCascade)
+		{
+			Fit(cascade, lightCenter, radius);
+			Draw(i, everything, snapshot, false);
+			continue;
+		}
+
+		// Cached windows stay put for as long as the slice's sphere stays inside them
+		const glm::vec3 offset = glm::abs(lightCenter - cascade.Center);
+		if (!cascade.Valid || glm::any(glm::greaterThan(offset + radius, glm::vec3(cascade.Radius))))
+		{
+			Fit(cascade, lightCenter, radius * s_CachePadding);
+			Draw(i, everything, snapshot, true);
+			continue;
+		}
+
+		// Otherwise only the texels under static geometry that changed are out of date
+		Region dirty;
+		const Bounds volume = GetVolume(cascade);
+		for (const Bounds& change : snapshot.StaticShadowChanges)
+		{
+			const Bounds lightBounds = change.Transformed(m_LightView);
+			if (!lightBounds.Overlaps(volume))
+				continue;
+
+			const Region region = GetRegion(cascade, lightBounds);
+			if (region.Width <= 0 || region.Height <= 0)
+				continue;
+
+			if (dirty.Width == 0)
+			{
+				dirty = region;
+				continue;
+			}
+
+			const GLint right = std::max(dirty.X + dirty.Width, region.X + region.Width);
+			const GLint top = std::max(dirty.Y + dirty.Height, region.Y + region.Height);
+			dirty.X = std::min(dirty.X, region.X);
+			dirty.Y = std::min(dirty.Y, region.Y);
+			dirty.Width = right - dirty.X;
+			dirty.Height = top - dirty.Y;
+		}
+
+		if (dirty.Width > 0)
+			Draw(i, dirty, snapshot, true);
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void CascadedShadowMap::Bind(const Shader& shader) const
+{
+	shader.SetInt("cascadeCount", m_Active ? s_CascadeCount : 0);
+	if (!m_Active)
+		return;
+
+	glBindTextureUnit(s_TextureUnit, m_Texture);
+	shader.SetInt("shadowMap", static_cast<int>(s_TextureUnit));
+	for (int i = 0; i < s_CascadeCount; i++)
+		shader.SetMat4("cascadeViewProjections[" + std::to_string(i) + "]", m_Cascades[i].ViewProjection);
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+	glDeleteFramebuffers(1, &m_Framebuffer);
+	glDeleteTextures(1, &m_Texture);
+}
+
+void CascadedShadowMap::Fit(Cascade& cascade, const glm::vec3& center, const float radius) const
+{
+	// Moving the window in whole texels keeps casters rasterising onto the same texel pattern
+	const float texel = 2.0f * radius / static_cast<float>(m_Resolution);
+	cascade.Center = glm::vec3(glm::floor(glm::vec2(center) / texel) * texel, center.z);
+	cascade.Radius = radius;
+
+	// The light looks down -z. Depth reaches past the window towards the light to catch casters outside of it
+	const glm::mat4 projection = glm::ortho(cascade.Center.x - radius, cascade.Center.x + radius,
+		cascade.Center.y - radius, cascade.Center.y + radius,
+		-(cascade.Center.z + radius + m_ShadowDistance), -(cascade.Center.z - radius));
+	cascade.ViewProjection = projection * m_LightView;
+	cascade.Valid = true;
+}
+
+CascadedShadowMap::Region CascadedShadowMap::GetRegion(const Cascade& cascade, const Bounds& lightBounds) const
+{
+	const float texelsPerUnit = static_cast<float>(m_Resolution) / (2.0f * cascade.Radius);
+	const glm::vec2 origin = glm::vec2(cascade.Center) - cascade.Radius;
+
+	const auto toTexel = [this](const float value) { return std::clamp(static_cast<GLint>(value), 0, static_cast<GLint>(m_Resolution)); };
+	const GLint left = toTexel(std::floor((lightBounds.Min.x - origin.x) * texelsPerUnit) - s_FilterTexels);
+	const GLint bottom = toTexel(std::floor((lightBounds.Min.y - origin.y) * texelsPerUnit) - s_FilterTexels);
+	const GLint right = toTexel(std::ceil((lightBounds.Max.x - origin.x) * texelsPerUnit) + s_FilterTexels);
+	const GLint top = toTexel(std::ceil((lightBounds.Max.y - origin.y) * texelsPerUnit) + s_FilterTexels);
+	return { left, bottom, right - left, top - bottom };
+}
+
+Bounds CascadedShadowMap::GetVolume(const Cascade& cascade) const
+{
+	const glm::vec3 extent(cascade.Radius);
+	return { cascade.Center - extent, cascade.Center + extent + glm::vec3(0.0f, 0.0f, m_ShadowDistance) };
+}
+
+void CascadedShadowMap::Draw(const int index, const Region& region, const FrameSnapshot& snapshot, const bool staticOnly)
+{
+	const Cascade& cascade = m_Cascades[index];
+
+	// Casters have to overlap both the cascade's volume and the region being redrawn
+	const float unitsPerTexel = 2.0f * cascade.Radius / static_cast<float>(m_Resolution);
+	const glm::vec2 origin = glm::vec2(cascade.Center) - cascade.Radius;
+	Bounds area = GetVolume(cascade);
+	area.Min.x = origin.x + static_cast<float>(region.X) * unitsPerTexel;
+	area.Min.y = origin.y + static_cast<float>(region.Y) * unitsPerTexel;
+	area.Max.x = origin.x + static_cast<float>(region.X + region.Width) * unitsPerTexel;
+	area.Max.y = origin.y + static_cast<float>(region.Y + region.Height) * unitsPerTexel;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+	glNamedFramebufferTextureLayer(m_Framebuffer, GL_DEPTH_ATTACHMENT, m_Texture, 0, index);
+	glScissor(region.X, region.Y, region.Width, region.Height);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	m_DepthShader.SetMat4("lightSpace", cascade.ViewProjection);
+	for (size_t i = 0; i < snapshot.Draws.size(); i++)
+	{
+		const DrawPacket& draw = snapshot.Draws[i];
+		if ((staticOnly && !draw.StaticCaster) || !m_LightBounds[i].Overlaps(area))
+			continue;
+
+		m_DepthShader.SetMat4("model", draw.World);
+		ForEachVisibleRange(snapshot, draw,
+			[this, &area](const uint32_t subMesh) { return m_SubMeshLightBounds[subMesh].Overlaps(area); },
+			[&draw](const uint32_t indexCount, const GLintptr indexOffset) { Renderer::RenderIndexed(draw.VAO, indexCount, indexOffset); });
+	}
+
+	m_RedrawnTexels += static_cast<uint64_t>(region.Width) * static_cast<uint64_t>(region.Height);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.h"
+#include "Shader.h"
+
+struct FrameSnapshot;
+
+/* Shadows from the sun, rendered into one layer of a depth texture array per cascade.
+* Cascades split the camera frustum up to the shadow distance. Each is fitted to a sphere around its slice, so its
+* size doesn't change as the camera turns, and its window is snapped to whole texels so edges don't shimmer as the
+* camera moves. Casters are culled per cascade against the window in light space.
+* The near cascades hold every caster and are redrawn each frame. The distant ones only hold static casters and are
+* cached: their window is padded and stays put until the slice leaves it, and only the texels under static geometry
+* that changed since the last frame are cleared and redrawn. Moving the light or missing a frame's changes redraws
+* them in full. Dynamic casters therefore only cast shadows within the near cascades.
+*/
+class CascadedShadowMap
+{
+public:
+	static constexpr int s_CascadeCount = 4;
+	static constexpr int s_FirstCachedCascade = 2;
+	static constexpr GLuint s_TextureUnit = 8; // Past the material maps
+
+	explicit CascadedShadowMap(GLsizei resolution = 2048, float shadowDistance = 100.0f);
+	CascadedShadowMap(const CascadedShadowMap&) = delete;
+	CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+	// Fits the cascades to the snapshot's camera and redraws whatever is out of date. Leaves the default framebuffer bound
+	void Update(const FrameSnapshot& snapshot);
+	// Binds the shadow map and sets the cascade uniforms of a shader sampling it. Shadows are off until the first Update with a sun
+	void Bind(const Shader& shader) const;
+
+	// Texels cleared and redrawn during the last Update, summed over the cascades
+	uint64_t GetRedrawnTexels() const { return m_RedrawnTexels; }
+
+	~CascadedShadowMap();
+
+private:
+	struct Cascade
+	{
+		glm::vec3 Center = glm::vec3(0.0f); // Window centre in light space, snapped to whole texels
+		float Radius = 0.0f; // Half the window's width
+		glm::mat4 ViewProjection = glm::mat4(1.0f);
+		bool Valid = false;
+	};
+
+	// Texel rectangle of a cascade layer
+	struct Region
+	{
+		GLint X = 0, Y = 0;
+		GLsizei Width = 0, Height = 0;
+	};
+
+	// Centres a cascade's window on center, light space, with the given half width
+	void Fit(Cascade& cascade, const glm::vec3& center, float radius) const;
+	// The part of the cascade's window under a light space box, padded by the filter footprint
+	Region GetRegion(const Cascade& cascade, const Bounds& lightBounds) const;
+	// Light space volume the cascade's window can see, including the extrusion towards the light
+	Bounds GetVolume(const Cascade& cascade) const;
+	// Clears and redraws a region of one layer with the casters that overlap it
+	void Draw(int index, const Region& region, const FrameSnapshot& snapshot, bool staticOnly);
+
+private:
+	GLsizei m_Resolution = 0;
+	float m_ShadowDistance = 0.0f;
+	GLuint m_Texture = 0;
+	GLuint m_Framebuffer = 0;
+	Shader m_DepthShader;
+
+	std::array<Cascade, s_CascadeCount> m_Cascades;
+	glm::vec3 m_LightDirection = glm::vec3(0.0f);
+	glm::mat4 m_LightView = glm::mat4(1.0f);
+	uint64_t m_StaticShadowRevision = 0;
+	bool m_Active = false;
+
+	std::vector<Bounds> m_LightBounds; // Each draw's bounds in light space, rebuilt every Update
+	std::vector<Bounds> m_SubMeshLightBounds; // Likewise for the merged meshes of static batches
+	uint64_t m_RedrawnTexels = 0;
+
+	static constexpr float s_CachePadding = 1.5f; // Cached windows are this much wider than their slice
+	static constexpr float s_SplitBlend = 0.75f; // 0 splits the frustum evenly, 1 logarithmically
+	static constexpr GLint s_FilterTexels = 2; // Reach of the lighting shader's filter, added around redrawn regions
+};
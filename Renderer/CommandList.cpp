@@ -0,0 +1,21 @@
+#include "CommandList.h"
+
+void CommandList::UpdateBuffer(const uint32_t buffer, const int64_t offset, const int64_t size, const void* data)
+{
+	std::byte* payload = Append(CommandType::UpdateBuffer, sizeof(Commands::UpdateBuffer) + static_cast<size_t>(size));
+
+	const Commands::UpdateBuffer command = { buffer, offset, size };
+	std::memcpy(payload, &command, sizeof(command));
+	std::memcpy(payload + sizeof(command), data, static_cast<size_t>(size));
+}
+
+std::byte* CommandList::Append(const CommandType type, const size_t payloadSize)
+{
+	const Header header = { type, static_cast<uint32_t>(Align(payloadSize)) };
+	const size_t start = m_Data.size();
+	m_Data.resize(start + Align(sizeof(Header)) + header.Size);
+	std::memcpy(m_Data.data() + start, &header, sizeof(Header));
+
+	m_CommandCount++;
+	return m_Data.data() + start + Align(sizeof(Header));
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <glm\glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "Resources.h"
+
+enum class CommandType : uint8_t
+{
+	BindPipeline,
+	BindMaterial,
+	BindTexture,
+	SetTransform,
+	DrawIndexed,
+	UpdateBuffer
+};
+
+// Fixed function state that goes with a pipeline's shader
+struct PipelineState
+{
+	bool DepthWrite = true;
+	bool FrontFaceClockwise = false; // For geometry seen from the inside, such as a skybox
+
+	bool operator==(const PipelineState& other) const { return DepthWrite == other.DepthWrite && FrontFaceClockwise == other.FrontFaceClockwise; }
+	bool operator!=(const PipelineState& other) const { return !(*this == other); }
+};
+
+// Command payloads as stored in a CommandList. Buffers and vertex arrays are referred to by their backend names
+namespace Commands
+{
+	struct BindPipeline { ShaderHandle Shader; PipelineState State; };
+	// Binds the material's shader with the default pipeline state, then its maps and uniforms
+	struct BindMaterial { MaterialHandle Material; };
+	struct BindTexture { uint32_t Unit = 0; TextureHandle Texture; };
+	// Model and normal matrices for the draws that follow
+	struct SetTransform { glm::mat4 Model; glm::mat3 Normal; };
+	struct DrawIndexed { uint32_t VertexArray = 0; uint32_t IndexCount = 0; int64_t IndexOffset = 0; };
+	// Followed in the list by Size bytes of data
+	struct UpdateBuffer { uint32_t Buffer = 0; int64_t Offset = 0; int64_t Size = 0; };
+}
+
+/* A flat, backend agnostic recording of draw commands.
+* Recording only appends plain data to a byte stream and never touches the graphics API or the resource pools,
+* so workers can each record a list for their slice of a frame in parallel. The thread owning the context then
+* replays the lists in order with a CommandReplayer. Clearing keeps the storage, so reused lists stop allocating.
+*/
+class CommandList
+{
+public:
+	void BindPipeline(const ShaderHandle shader, const PipelineState state = {}) { Push(CommandType::BindPipeline, Commands::BindPipeline{ shader, state }); }
+	void BindMaterial(const MaterialHandle material) { Push(CommandType::BindMaterial, Commands::BindMaterial{ material }); }
+	void BindTexture(const uint32_t unit, const TextureHandle texture) { Push(CommandType::BindTexture, Commands::BindTexture{ unit, texture }); }
+	void SetTransform(const glm::mat4& model, const glm::mat3& normal) { Push(CommandType::SetTransform, Commands::SetTransform{ model, normal }); }
+	void DrawIndexed(const uint32_t vertexArray, const uint32_t indexCount, const int64_t indexOffset)
+		{ Push(CommandType::DrawIndexed, Commands::DrawIndexed{ vertexArray, indexCount, indexOffset }); }
+	// Copies size bytes of data into the list, to be written to [offset, offset + size) of buffer on replay
+	void UpdateBuffer(uint32_t buffer, int64_t offset, int64_t size, const void* data);
+
+	void Clear() { m_Data.clear(); m_CommandCount = 0; }
+	bool IsEmpty() const { return m_CommandCount == 0; }
+	size_t GetCommandCount() const { return m_CommandCount; }
+	size_t GetByteSize() const { return m_Data.size(); }
+
+	// Calls visitor(type, payload) for every command in recording order. Read the payload with Read<T>
+	template<typename Visitor>
+	void ForEach(Visitor&& visitor) const;
+
+	template<typename T>
+	static T Read(const std::byte* payload)
+	{
+		T command;
+		std::memcpy(&command, payload, sizeof(T));
+		return command;
+	}
+
+private:
+	struct Header
+	{
+		CommandType Type;
+		uint32_t Size; // Payload bytes following the header, padded to s_Alignment
+	};
+
+	static constexpr size_t s_Alignment = 8;
+	static constexpr size_t Align(const size_t size) { return (size + s_Alignment - 1) & ~(s_Alignment - 1); }
+
+	// Reserves a command with payloadSize bytes of payload and returns where the payload goes
+	std::byte* Append(CommandType type, size_t payloadSize);
+
+	template<typename T>
+	void Push(CommandType type, const T& command)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		std::memcpy(Append(type, sizeof(T)), &command, sizeof(T));
+	}
+
+private:
+	std::vector<std::byte> m_Data;
+	size_t m_CommandCount = 0;
+};
+
+template<typename Visitor>
+void CommandList::ForEach(Visitor&& visitor) const
+{
+	const std::byte* data = m_Data.data();
+	for (size_t offset = 0; offset < m_Data.size();)
+	{
+		Header header;
+		std::memcpy(&header, data + offset, sizeof(Header));
+		offset += Align(sizeof(Header));
+		visitor(header.Type, data + offset);
+		offset += header.Size;
+	}
+}
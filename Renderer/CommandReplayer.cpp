@@ -0,0 +1,124 @@
+#include "CommandReplayer.h"
+
+#include <glad\glad.h>
+
+#include "Shader.h"
+#include "..\Scene\Scene.h"
+#include "..\Scene\Components\Texture.h"
+
+void CommandReplayer::Reset()
+{
+	// Matches the state the rest of the renderer leaves behind
+	*this = CommandReplayer();
+	glDepthMask(GL_TRUE);
+	glFrontFace(GL_CCW);
+}
+
+void CommandReplayer::Replay(const CommandList& list)
+{
+	list.ForEach([this](const CommandType type, const std::byte* payload)
+	{
+		switch (type)
+		{
+		case CommandType::BindPipeline:
+		{
+			const auto command = CommandList::Read<Commands::BindPipeline>(payload);
+			BindPipeline(command.Shader, command.State);
+			break;
+		}
+		case CommandType::BindMaterial:
+			BindMaterial(CommandList::Read<Commands::BindMaterial>(payload).Material);
+			break;
+		case CommandType::BindTexture:
+		{
+			const auto command = CommandList::Read<Commands::BindTexture>(payload);
+			m_Material = {}; // The unit may have held one of the material's maps
+			if (const Texture* texture = g_Resources->Textures.TryGet(command.Texture))
+				texture->Use(static_cast<int>(command.Unit));
+			break;
+		}
+		case CommandType::SetTransform:
+		{
+			if (m_Skipping || !m_Shader)
+				break;
+			const auto command = CommandList::Read<Commands::SetTransform>(payload);
+			m_Shader->SetTransform(command.Model, command.Normal);
+			break;
+		}
+		case CommandType::DrawIndexed:
+		{
+			if (m_Skipping)
+				break;
+			const auto command = CommandList::Read<Commands::DrawIndexed>(payload);
+			if (command.VertexArray != m_VertexArray)
+			{
+				glBindVertexArray(command.VertexArray);
+				m_VertexArray = command.VertexArray;
+			}
+			glDrawElements(GL_TRIANGLES, static_cast<int>(command.IndexCount), GL_UNSIGNED_INT,
+				reinterpret_cast<const void*>(command.IndexOffset)); // NOLINT(performance-no-int-to-ptr)
+			m_DrawCount++;
+			break;
+		}
+		case CommandType::UpdateBuffer:
+		{
+			const auto command = CommandList::Read<Commands::UpdateBuffer>(payload);
+			glNamedBufferSubData(command.Buffer, command.Offset, command.Size, payload + sizeof(command));
+			break;
+		}
+		}
+	});
+}
+
+void CommandReplayer::BindPipeline(const ShaderHandle shader, const PipelineState& state)
+{
+	// A pipeline change invalidates whatever material uniforms were sent to the previous program
+	m_Material = {};
+
+	const Shader* program = g_Resources->Shaders.TryGet(shader);
+	m_Skipping = !program;
+	if (!program)
+		return;
+
+	if (shader != m_Pipeline)
+	{
+		program->Use();
+		m_Pipeline = shader;
+		m_Shader = program;
+	}
+	else
+		m_SkippedBinds++;
+
+	if (state != m_State)
+	{
+		if (state.DepthWrite != m_State.DepthWrite)
+			glDepthMask(state.DepthWrite ? GL_TRUE : GL_FALSE);
+		if (state.FrontFaceClockwise != m_State.FrontFaceClockwise)
+			glFrontFace(state.FrontFaceClockwise ? GL_CW : GL_CCW);
+		m_State = state;
+	}
+}
+
+void CommandReplayer::BindMaterial(const MaterialHandle material)
+{
+	if (material == m_Material && !m_Skipping)
+	{
+		m_SkippedBinds++;
+		return;
+	}
+
+	const Material* resolved = g_Resources->Materials.TryGet(material);
+	if (!resolved)
+	{
+		m_Material = {};
+		m_Skipping = true;
+		return;
+	}
+
+	BindPipeline(resolved->Shader, {});
+	if (m_Skipping)
+		return;
+
+	Scene::SendMaterialDataToShader(*resolved);
+	m_Material = material;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CommandList.h"
+
+class Shader;
+
+/* Replays command lists against OpenGL on the thread owning the context.
+* Bound state is tracked across commands and lists, so binds that would change nothing are skipped. Handles are
+* resolved at replay, and commands referring to resources removed since recording are dropped along with the draws
+* that depend on them.
+*/
+class CommandReplayer
+{
+public:
+	// Forgets the tracked state. Call whenever GL state may have been changed outside of replay
+	void Reset();
+	void Replay(const CommandList& list);
+
+	// Draws issued and binds skipped as redundant since the last Reset
+	uint32_t GetDrawCount() const { return m_DrawCount; }
+	uint32_t GetSkippedBindCount() const { return m_SkippedBinds; }
+
+private:
+	void BindPipeline(ShaderHandle shader, const PipelineState& state);
+	void BindMaterial(MaterialHandle material);
+
+private:
+	const Shader* m_Shader = nullptr;
+	ShaderHandle m_Pipeline;
+	PipelineState m_State;
+	MaterialHandle m_Material;
+	uint32_t m_VertexArray = 0;
+	bool m_Skipping = false; // The last pipeline or material bind failed, so draws are dropped until the next one
+
+	uint32_t m_DrawCount = 0;
+	uint32_t m_SkippedBinds = 0;
+};
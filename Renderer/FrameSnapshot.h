@@ -0,0 +1,124 @@
+#pragma once
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "Bounds.h"
+#include "Resources.h"
+#include "..\Scene\Light.h"
+
+// One indexed mesh draw with its material and world matrices resolved. The VAO and index range stay valid until the
+// snapshot is drawn even if the mesh is destroyed meanwhile, since the release queue holds on to them
+struct DrawPacket
+{
+	GLuint VAO = 0;
+	uint32_t IndexCount = 0;
+	GLintptr IndexOffset = 0;
+	MaterialHandle Material;
+	glm::mat4 World = glm::mat4(1.0f);
+	glm::mat3 Normal = glm::mat3(1.0f);
+	Bounds WorldBounds;
+	bool StaticCaster = false; // Cached in the distant shadow cascades
+	// The merged meshes of a static batch, in FrameSnapshot::SubMeshes. None for any other mesh
+	uint32_t FirstSubMesh = 0, SubMeshCount = 0;
+};
+
+// One merged mesh's triangles within a static batch's draw
+struct SubMeshPacket
+{
+	uint32_t IndexCount = 0;
+	GLintptr IndexOffset = 0;
+	Bounds WorldBounds;
+};
+
+struct SkyboxPacket
+{
+	GLuint VAO = 0;
+	uint32_t IndexCount = 0;
+	GLintptr IndexOffset = 0;
+	ShaderHandle Shader;
+	TextureHandle Texture;
+};
+
+/* Everything the render thread needs to draw one frame, copied out of the scene by the simulation thread.
+* A snapshot is never modified after it is published, so drawing it touches neither the registry nor the camera.
+* Resources are referred to by handle and resolved on the render thread, which is the only thread that edits the pools.
+*/
+struct FrameSnapshot
+{
+	uint64_t Frame = 0;
+
+	// Camera
+	glm::mat4 View = glm::mat4(1.0f);
+	glm::mat4 Projection = glm::mat4(1.0f);
+	glm::vec3 CameraPosition = glm::vec3(0.0f);
+	int ViewportWidth = 0, ViewportHeight = 0;
+	bool Wireframe = false;
+
+	// Lights
+	std::vector<PointLight> PointLights;
+	std::optional<DirectionalLight> Sun;
+	std::optional<SpotLight> Flashlight;
+
+	// Geometry
+	std::optional<SkyboxPacket> Skybox;
+	std::vector<DrawPacket> Draws;
+	std::vector<SubMeshPacket> SubMeshes; // Follow each other in index order within a batch
+	// Index pool relocation count the draws' index offsets were read under. Offsets from an older count are stale
+	uint32_t IndexRelocations = 0;
+
+	// World space regions static casters appeared in, moved through or left since the previous snapshot.
+	// The revision advances once for every snapshot carrying changes, so a renderer can tell when it skipped one
+	std::vector<Bounds> StaticShadowChanges;
+	uint64_t StaticShadowRevision = 0;
+
+	// Empties the snapshot for reuse, keeping the vectors' storage
+	void Clear()
+	{
+		PointLights.clear();
+		Sun.reset();
+		Flashlight.reset();
+		Skybox.reset();
+		Draws.clear();
+		SubMeshes.clear();
+		StaticShadowChanges.clear();
+	}
+};
+
+// Calls submit(indexCount, indexOffset) for the triangles of a draw a pass needs: all of them, or for a static batch the
+// merged meshes visible(subMesh) accepts, with neighbouring ones joined into a single call
+template<typename Visible, typename Submit>
+void ForEachVisibleRange(const FrameSnapshot& snapshot, const DrawPacket& draw, const Visible& visible, const Submit& submit)
+{
+	if (draw.SubMeshCount == 0)
+	{
+		submit(draw.IndexCount, draw.IndexOffset);
+		return;
+	}
+
+	uint32_t count = 0;
+	GLintptr offset = 0;
+	for (uint32_t i = draw.FirstSubMesh; i < draw.FirstSubMesh + draw.SubMeshCount; i++)
+	{
+		const SubMeshPacket& subMesh = snapshot.SubMeshes[i];
+		if (!visible(i))
+			continue;
+
+		if (count > 0 && offset + static_cast<GLintptr>(count * sizeof(uint32_t)) == subMesh.IndexOffset)
+		{
+			count += subMesh.IndexCount;
+			continue;
+		}
+
+		if (count > 0)
+			submit(count, offset);
+		count = subMesh.IndexCount;
+		offset = subMesh.IndexOffset;
+	}
+	if (count > 0)
+		submit(count, offset);
+}
@@ -8,20 +8,23 @@
 class Framebuffer
 {
 public:
-	Framebuffer() { glGenFramebuffers(1, &m_ID); }
+	Framebuffer() { glCreateFramebuffers(1, &m_ID); }
 
 	Framebuffer(const std::shared_ptr<TexColorBuffer>& colorBuffer, const std::shared_ptr<Renderbuffer>& renderbuffer)
 	{
-		glGenFramebuffers(1, &m_ID);
-		glBindFramebuffer(GL_FRAMEBUFFER, m_ID);
+		glCreateFramebuffers(1, &m_ID);
 
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffer->m_ID, 0);
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffer->m_ID);
+		glNamedFramebufferTexture(m_ID, GL_COLOR_ATTACHMENT0, colorBuffer->m_ID, 0);
+		glNamedFramebufferRenderbuffer(m_ID, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffer->m_ID);
 
 		CheckFrameBufferStatus();
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer& operator=(const Framebuffer&) = delete;
+
+	~Framebuffer() { glDeleteFramebuffers(1, &m_ID); }
+
 	void Use() const
 	{
 		glBindFramebuffer(GL_FRAMEBUFFER, m_ID);
@@ -31,9 +34,9 @@ public:
 	operator const GLuint& () const { return m_ID; }
 
 private:
-	static void CheckFrameBufferStatus()
+	void CheckFrameBufferStatus() const
 	{
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		if (glCheckNamedFramebufferStatus(m_ID, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 			std::cerr << "ERROR::FRAMEBUFFER: Framebuffer is not complete!" << std::endl;
 	}
 
@@ -2,22 +2,102 @@
 
 #include <glad\glad.h>
 
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "BufferPool.h"
+#include "ReleaseQueue.h"
+
 struct IndexedVAO
 {
 	uint32_t* VAO = new uint32_t;
 	uint32_t IndexCount = 0;
+	// Staged buffer copies that haven't reached the GPU yet, shared with their completion callbacks.
+	// Atomic since the simulation thread checks residency while the render thread completes uploads
+	std::shared_ptr<std::atomic<int>> PendingUploads = std::make_shared<std::atomic<int>>(0);
+	// Pooled storage behind the VAO, returned to its pool when the VAO is destroyed
+	std::shared_ptr<BufferAllocation> Vertices;
+	std::shared_ptr<BufferAllocation> Indices;
 
 	IndexedVAO()
 	{
-		glGenVertexArrays(1, VAO);
+		glCreateVertexArrays(1, VAO);
+	}
+
+	// The VAO name is owned, so it can only move
+	IndexedVAO(const IndexedVAO&) = delete;
+	IndexedVAO& operator=(const IndexedVAO&) = delete;
+
+	IndexedVAO(IndexedVAO&& other) noexcept
+		: VAO(std::exchange(other.VAO, nullptr)), IndexCount(other.IndexCount), PendingUploads(std::move(other.PendingUploads)),
+		Vertices(std::move(other.Vertices)), Indices(std::move(other.Indices)) {}
+
+	IndexedVAO& operator=(IndexedVAO&& other) noexcept
+	{
+		std::swap(VAO, other.VAO);
+		std::swap(IndexCount, other.IndexCount);
+		std::swap(PendingUploads, other.PendingUploads);
+		std::swap(Vertices, other.Vertices);
+		std::swap(Indices, other.Indices);
+		return *this;
 	}
 
 	~IndexedVAO()
 	{
-		glDeleteVertexArrays(1, VAO);
+		if (!VAO)
+			return;
+
+		// Snapshots in flight may still draw this, so the VAO and its ranges outlive it until they are done
+		if (g_ReleaseQueue)
+			g_ReleaseQueue->Defer(*VAO, std::move(Vertices), std::move(Indices));
+		else
+			glDeleteVertexArrays(1, VAO);
 		delete VAO;
 	}
 
+	// Sources binding 0 from a pooled range, following it if the pool is defragmented
+	void SetVertexBuffer(std::shared_ptr<BufferAllocation> vertices, const GLsizei stride)
+	{
+		const GLuint vao = *VAO;
+		const auto bind = [vao, stride](const BufferAllocation& allocation)
+			{ glVertexArrayVertexBuffer(vao, 0, allocation.GetBuffer(), allocation.GetOffset(), stride); };
+
+		Release(Vertices);
+		Vertices = std::move(vertices);
+		bind(*Vertices);
+		Vertices->SetRelocationCallback(bind);
+	}
+
+	// Uses a pooled range as the element buffer. Draws offset into the pool by GetIndexOffset()
+	void SetIndexBuffer(std::shared_ptr<BufferAllocation> indices)
+	{
+		const GLuint vao = *VAO;
+		const auto bind = [vao](const BufferAllocation& allocation)
+			{ glVertexArrayElementBuffer(vao, allocation.GetBuffer()); };
+
+		Release(Indices);
+		Indices = std::move(indices);
+		bind(*Indices);
+		Indices->SetRelocationCallback(bind);
+	}
+
+	// Hands a replaced range to the release queue, which keeps it until no snapshot can draw from it. Its relocation
+	// callback would rebind this VAO, so it goes first
+	static void Release(std::shared_ptr<BufferAllocation>& allocation)
+	{
+		if (!allocation)
+			return;
+
+		allocation->SetRelocationCallback(nullptr);
+		if (g_ReleaseQueue)
+			g_ReleaseQueue->Defer(0, std::move(allocation), nullptr);
+		allocation.reset();
+	}
+
+	GLintptr GetIndexOffset() const { return Indices ? Indices->GetOffset() : 0; }
+	bool IsResident() const { return *PendingUploads == 0; }
+
 	operator uint32_t& () { return *VAO; }
 	operator const uint32_t& () const { return *VAO; }
 	operator uint32_t* () { return VAO; }
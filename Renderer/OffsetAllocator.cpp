@@ -0,0 +1,242 @@
+#include "OffsetAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	uint32_t LowestBit(const uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index = 0;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+	}
+
+	uint32_t HighestBit(const uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index = 0;
+		_BitScanReverse(&index, value);
+		return index;
+#else
+		return 31u - static_cast<uint32_t>(__builtin_clz(value));
+#endif
+	}
+}
+
+OffsetAllocator::OffsetAllocator(const uint32_t size)
+{
+	Reset(size);
+}
+
+OffsetAllocator::Allocation OffsetAllocator::Allocate(uint32_t size)
+{
+	size = std::max(size, 1u);
+
+	const uint32_t bin = FindFreeBin(BinRoundUp(size));
+	if (bin == s_Invalid)
+		return {};
+
+	const uint32_t node = m_BinHeads[bin];
+	RemoveFreeNode(node);
+
+	const uint32_t remainder = m_Nodes[node].Size - size;
+	m_Nodes[node].Size = size;
+	m_Nodes[node].Used = true;
+
+	// Hand the unused tail back as a new free block right after this one
+	if (remainder > 0)
+	{
+		const uint32_t tail = InsertFreeNode(m_Nodes[node].Offset + size, remainder);
+		m_Nodes[tail].NeighborPrev = node;
+		m_Nodes[tail].NeighborNext = m_Nodes[node].NeighborNext;
+		if (m_Nodes[node].NeighborNext != s_Invalid)
+			m_Nodes[m_Nodes[node].NeighborNext].NeighborPrev = tail;
+		m_Nodes[node].NeighborNext = tail;
+	}
+
+	return { m_Nodes[node].Offset, node };
+}
+
+void OffsetAllocator::Free(const Allocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	const uint32_t node = allocation.Node;
+	assert(m_Nodes[node].Used && "OffsetAllocator: double free");
+
+	// Merge with free physical neighbours so free space never stays split
+	const uint32_t prev = m_Nodes[node].NeighborPrev;
+	if (prev != s_Invalid && !m_Nodes[prev].Used)
+	{
+		RemoveFreeNode(prev);
+		m_Nodes[node].Offset = m_Nodes[prev].Offset;
+		m_Nodes[node].Size += m_Nodes[prev].Size;
+		m_Nodes[node].NeighborPrev = m_Nodes[prev].NeighborPrev;
+		if (m_Nodes[node].NeighborPrev != s_Invalid)
+			m_Nodes[m_Nodes[node].NeighborPrev].NeighborNext = node;
+		ReleaseNode(prev);
+	}
+
+	const uint32_t next = m_Nodes[node].NeighborNext;
+	if (next != s_Invalid && !m_Nodes[next].Used)
+	{
+		RemoveFreeNode(next);
+		m_Nodes[node].Size += m_Nodes[next].Size;
+		m_Nodes[node].NeighborNext = m_Nodes[next].NeighborNext;
+		if (m_Nodes[node].NeighborNext != s_Invalid)
+			m_Nodes[m_Nodes[node].NeighborNext].NeighborPrev = node;
+		ReleaseNode(next);
+	}
+
+	// Reuse the freed node as the merged free block
+	LinkFreeNode(node);
+}
+
+void OffsetAllocator::Reset(const uint32_t size)
+{
+	m_Size = size;
+	m_FreeStorage = 0;
+	m_UsedWords = 0;
+	std::fill(std::begin(m_UsedBins), std::end(m_UsedBins), 0u);
+	std::fill(std::begin(m_BinHeads), std::end(m_BinHeads), s_Invalid);
+	m_Nodes.clear();
+	m_FreeNodes.clear();
+
+	if (size > 0)
+		InsertFreeNode(0, size);
+}
+
+uint32_t OffsetAllocator::GetLargestFreeRegion() const
+{
+	if (m_UsedWords == 0)
+		return 0;
+
+	// Blocks in the highest occupied bin are the largest, but sizes within a bin still differ
+	const uint32_t word = HighestBit(m_UsedWords);
+	const uint32_t bin = word * 32 + HighestBit(m_UsedBins[word]);
+
+	uint32_t largest = 0;
+	for (uint32_t node = m_BinHeads[bin]; node != s_Invalid; node = m_Nodes[node].BinNext)
+		largest = std::max(largest, m_Nodes[node].Size);
+
+	return largest;
+}
+
+uint32_t OffsetAllocator::BinRoundUp(const uint32_t size)
+{
+	uint32_t bin = BinRoundDown(size);
+	if (size >= 8)
+	{
+		// Sizes between two bin boundaries must go to the next bin up to be guaranteed a fit
+		const uint32_t lowBits = (1u << (HighestBit(size) - 3)) - 1;
+		if (size & lowBits)
+			bin++;
+	}
+	return bin;
+}
+
+uint32_t OffsetAllocator::BinRoundDown(const uint32_t size)
+{
+	// Sizes below 8 get a bin each, larger ones keep their top bit plus 3 bits of mantissa
+	if (size < 8)
+		return size;
+
+	const uint32_t exponent = HighestBit(size);
+	return ((exponent - 2) << 3) | ((size >> (exponent - 3)) & 7);
+}
+
+uint32_t OffsetAllocator::FindFreeBin(const uint32_t minBin) const
+{
+	if (minBin >= s_BinCount)
+		return s_Invalid;
+
+	const uint32_t word = minBin >> 5;
+	const uint32_t bins = m_UsedBins[word] & (~0u << (minBin & 31));
+	if (bins)
+		return word * 32 + LowestBit(bins);
+
+	const uint32_t words = m_UsedWords & (~0u << (word + 1));
+	if (!words)
+		return s_Invalid;
+
+	const uint32_t nextWord = LowestBit(words);
+	return nextWord * 32 + LowestBit(m_UsedBins[nextWord]);
+}
+
+uint32_t OffsetAllocator::InsertFreeNode(const uint32_t offset, const uint32_t size)
+{
+	const uint32_t node = NewNode();
+	m_Nodes[node].Offset = offset;
+	m_Nodes[node].Size = size;
+	LinkFreeNode(node);
+	return node;
+}
+
+void OffsetAllocator::LinkFreeNode(const uint32_t node)
+{
+	Node& block = m_Nodes[node];
+	const uint32_t bin = BinRoundDown(block.Size);
+
+	block.Used = false;
+	block.BinPrev = s_Invalid;
+	block.BinNext = m_BinHeads[bin];
+	if (m_BinHeads[bin] != s_Invalid)
+		m_Nodes[m_BinHeads[bin]].BinPrev = node;
+	m_BinHeads[bin] = node;
+
+	m_UsedBins[bin >> 5] |= 1u << (bin & 31);
+	m_UsedWords |= 1u << (bin >> 5);
+	m_FreeStorage += block.Size;
+}
+
+void OffsetAllocator::RemoveFreeNode(const uint32_t node)
+{
+	const Node& block = m_Nodes[node];
+	const uint32_t bin = BinRoundDown(block.Size);
+
+	if (block.BinPrev != s_Invalid)
+		m_Nodes[block.BinPrev].BinNext = block.BinNext;
+	else
+		m_BinHeads[bin] = block.BinNext;
+
+	if (block.BinNext != s_Invalid)
+		m_Nodes[block.BinNext].BinPrev = block.BinPrev;
+
+	if (m_BinHeads[bin] == s_Invalid)
+	{
+		m_UsedBins[bin >> 5] &= ~(1u << (bin & 31));
+		if (!m_UsedBins[bin >> 5])
+			m_UsedWords &= ~(1u << (bin >> 5));
+	}
+
+	m_FreeStorage -= block.Size;
+}
+
+uint32_t OffsetAllocator::NewNode()
+{
+	if (!m_FreeNodes.empty())
+	{
+		const uint32_t node = m_FreeNodes.back();
+		m_FreeNodes.pop_back();
+		m_Nodes[node] = Node();
+		return node;
+	}
+
+	m_Nodes.emplace_back();
+	return static_cast<uint32_t>(m_Nodes.size() - 1);
+}
+
+void OffsetAllocator::ReleaseNode(const uint32_t node)
+{
+	m_FreeNodes.emplace_back(node);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/* Two-level segregated fit (TLSF) allocator over an abstract range of units.
+* It only hands out offsets, so the same allocator can manage GPU buffers, texture atlases or anything else
+* addressed by an integer. Free blocks are binned by size on a log2 scale with 8 linear steps per power of two,
+* and two levels of bitmasks find a large enough block in constant time. Freed blocks merge with free neighbours
+* immediately, so fragmentation only comes from live allocations.
+*/
+class OffsetAllocator
+{
+public:
+	static constexpr uint32_t s_Invalid = 0xFFFFFFFF;
+
+	struct Allocation
+	{
+		uint32_t Offset = s_Invalid;
+		uint32_t Node = s_Invalid; // Internal block index, needed to free it
+
+		bool IsValid() const { return Offset != s_Invalid; }
+	};
+
+	explicit OffsetAllocator(uint32_t size = 0);
+
+	// Reserves size units, returning an invalid allocation if no free block is large enough
+	Allocation Allocate(uint32_t size);
+	void Free(const Allocation& allocation);
+	// Forgets every allocation and starts over with a single free block of size units
+	void Reset(uint32_t size);
+
+	uint32_t GetSize() const { return m_Size; }
+	uint32_t GetFreeStorage() const { return m_FreeStorage; }
+	uint32_t GetAllocationSize(const Allocation& allocation) const { return m_Nodes[allocation.Node].Size; }
+	uint32_t GetLargestFreeRegion() const;
+
+private:
+	static constexpr uint32_t s_BinCount = 240; // Enough bins for every 32-bit size
+	static constexpr uint32_t s_BinWords = (s_BinCount + 31) / 32;
+
+	struct Node
+	{
+		uint32_t Offset = 0;
+		uint32_t Size = 0;
+		uint32_t BinPrev = s_Invalid, BinNext = s_Invalid; // Free list of the block's bin
+		uint32_t NeighborPrev = s_Invalid, NeighborNext = s_Invalid; // Physically adjacent blocks
+		bool Used = false;
+	};
+
+	// Smallest bin whose blocks are all at least size units
+	static uint32_t BinRoundUp(uint32_t size);
+	// Bin a free block of size units belongs to
+	static uint32_t BinRoundDown(uint32_t size);
+
+	uint32_t FindFreeBin(uint32_t minBin) const;
+	uint32_t InsertFreeNode(uint32_t offset, uint32_t size);
+	// Pushes a node onto the free list of the bin matching its size
+	void LinkFreeNode(uint32_t node);
+	void RemoveFreeNode(uint32_t node);
+	uint32_t NewNode();
+	void ReleaseNode(uint32_t node);
+
+private:
+	uint32_t m_Size = 0;
+	uint32_t m_FreeStorage = 0;
+	uint32_t m_UsedWords = 0; // Bit per word of m_UsedBins that has any bit set
+	uint32_t m_UsedBins[s_BinWords] = {};
+	uint32_t m_BinHeads[s_BinCount] = {};
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_FreeNodes;
+};
@@ -0,0 +1,34 @@
+#include "ReleaseQueue.h"
+
+#include "BufferPool.h"
+
+void ReleaseQueue::Defer(const GLuint vao, std::shared_ptr<BufferAllocation> vertices, std::shared_ptr<BufferAllocation> indices)
+{
+	// The snapshot after the last published one may be in the middle of being built, so it can hold these too
+	const uint64_t frame = m_Published.load(std::memory_order_acquire) + 1;
+	m_Entries.push_back({ frame, vao, std::move(vertices), std::move(indices) });
+}
+
+void ReleaseQueue::Collect(const uint64_t renderedFrame)
+{
+	// Entries are queued in frame order, so the releasable ones are at the front
+	while (!m_Entries.empty() && m_Entries.front().Frame <= renderedFrame)
+	{
+		Release(m_Entries.front());
+		m_Entries.pop_front();
+	}
+}
+
+ReleaseQueue::~ReleaseQueue()
+{
+	for (Entry& entry : m_Entries)
+		Release(entry);
+}
+
+void ReleaseQueue::Release(Entry& entry)
+{
+	entry.Vertices.reset();
+	entry.Indices.reset();
+	if (entry.VAO)
+		glDeleteVertexArrays(1, &entry.VAO);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+class BufferAllocation;
+
+/* Holds GL objects and pooled ranges whose owner went away while published snapshots may still draw them.
+* Exclusive systems and main thread jobs run on the render thread between frames, so a mesh destroyed there can still be
+* referenced by a snapshot waiting to be drawn. Its VAO is only deleted, and its ranges only returned to their pools,
+* once the render thread has drawn or skipped every snapshot that was published or being built when it was queued.
+*/
+class ReleaseQueue
+{
+public:
+	ReleaseQueue() = default;
+	ReleaseQueue(const ReleaseQueue&) = delete;
+	ReleaseQueue& operator=(const ReleaseQueue&) = delete;
+
+	// Keeps a VAO, 0 for none, and its pooled ranges until no snapshot can draw them. GL thread only
+	void Defer(GLuint vao, std::shared_ptr<BufferAllocation> vertices, std::shared_ptr<BufferAllocation> indices);
+
+	// Called by the simulation thread whenever it publishes a snapshot
+	void SetPublishedFrame(const uint64_t frame) { m_Published.store(frame, std::memory_order_release); }
+	// Releases what no snapshot up to and including the rendered frame can still draw. GL thread only
+	void Collect(uint64_t renderedFrame);
+
+	// Releases everything straight away, on the GL thread
+	~ReleaseQueue();
+
+private:
+	struct Entry
+	{
+		uint64_t Frame = 0; // The first snapshot built after it was queued
+		GLuint VAO = 0;
+		std::shared_ptr<BufferAllocation> Vertices, Indices;
+	};
+
+	// Drops the entry's references and deletes its VAO
+	static void Release(Entry& entry);
+
+private:
+	std::deque<Entry> m_Entries;
+	std::atomic<uint64_t> m_Published = 0;
+};
+
+inline std::shared_ptr<ReleaseQueue> g_ReleaseQueue;
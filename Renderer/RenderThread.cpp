@@ -0,0 +1,293 @@
+#include "RenderThread.h"
+
+#include <glad\glad.h>
+#include <GLFW\glfw3.h>
+#include <glm\gtc\type_ptr.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+#include "BufferPool.h"
+#include "ReleaseQueue.h"
+#include "Renderer.h"
+#include "Shader.h"
+#include "UploadManager.h"
+#include "..\Scene\Scene.h"
+#include "..\Scene\Components\Texture.h"
+#include "..\ThreadPool.h"
+
+RenderThread::RenderThread(GLFWwindow* window, InitFunction init)
+	: m_Window(window)
+{
+	m_Thread = std::thread(&RenderThread::Run, this, std::move(init));
+
+	std::unique_lock lock(m_Mutex);
+	m_Condition.wait(lock, [this] { return m_Started; });
+}
+
+FrameSnapshot& RenderThread::BeginFrame()
+{
+	{
+		// Simulation may run one frame ahead of the render thread, but no further
+		std::unique_lock lock(m_Mutex);
+		m_Condition.wait(lock, [this] { return m_Rendered + 1 >= m_Published || !m_Running; });
+	}
+
+	FrameSnapshot& snapshot = m_Snapshots.GetWriteSlot();
+	snapshot.Clear();
+	snapshot.Frame = m_Published + 1; // Only this thread writes m_Published
+	return snapshot;
+}
+
+void RenderThread::EndFrame()
+{
+	const uint64_t frame = m_Snapshots.GetWriteSlot().Frame;
+	m_Snapshots.Publish();
+	if (g_ReleaseQueue)
+		g_ReleaseQueue->SetPublishedFrame(frame);
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Published = frame;
+	}
+	m_Condition.notify_all();
+}
+
+void RenderThread::Stop(ShutdownFunction shutdown)
+{
+	if (!m_Thread.joinable())
+		return;
+
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Stopping = true;
+		m_Shutdown = std::move(shutdown);
+	}
+	m_Condition.notify_all();
+	m_Thread.join();
+}
+
+RenderThread::~RenderThread()
+{
+	Stop();
+}
+
+void RenderThread::Run(const InitFunction& init)
+{
+	glfwMakeContextCurrent(m_Window);
+
+	// First use of the job system, which makes this its main thread
+	auto& pool = ThreadPool::Get();
+	pool.SetMainThreadWake([this]
+	{
+		{
+			std::lock_guard lock(m_Mutex);
+			m_JobsQueued = true;
+		}
+		m_Condition.notify_all();
+	});
+
+	const bool initialized = init();
+	if (initialized)
+	{
+		m_Matrices = std::make_unique<UniformBuffer>();
+		m_Matrices->SetData(2 * sizeof(glm::mat4), nullptr);
+		m_Matrices->BindDataRange(0, 0, 2 * sizeof(glm::mat4));
+		m_Shadows = std::make_unique<CascadedShadowMap>();
+		m_ShadowAtlas = std::make_unique<ShadowAtlas>();
+	}
+
+	m_Running = initialized;
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Started = true;
+		m_Stopping = !initialized;
+	}
+	m_Condition.notify_all();
+
+	while (initialized)
+	{
+		pool.RunMainThreadJobs();
+
+		if (m_Snapshots.Acquire())
+		{
+			const FrameSnapshot& snapshot = m_Snapshots.GetReadSlot();
+			if (Render(snapshot))
+				glfwSwapBuffers(m_Window);
+
+			{
+				std::lock_guard lock(m_Mutex);
+				m_Rendered = snapshot.Frame;
+			}
+			m_Condition.notify_all();
+
+			// Meshes destroyed since this snapshot was built can go now that it has been drawn
+			if (g_ReleaseQueue)
+				g_ReleaseQueue->Collect(snapshot.Frame);
+			continue;
+		}
+
+		std::unique_lock lock(m_Mutex);
+		m_Condition.wait(lock, [this] { return m_Stopping || m_JobsQueued || m_Published > m_Rendered; });
+		m_JobsQueued = false;
+		if (m_Stopping)
+			break;
+	}
+
+	// Anything the simulation handed over before stopping still has to run against the context
+	pool.RunMainThreadJobs();
+	pool.SetMainThreadWake(nullptr);
+
+	if (m_Shutdown)
+		m_Shutdown();
+	m_Matrices.reset();
+	m_Shadows.reset();
+	m_ShadowAtlas.reset();
+
+	m_Running = false;
+	m_Condition.notify_all();
+	glfwMakeContextCurrent(nullptr);
+}
+
+bool RenderThread::Render(const FrameSnapshot& snapshot)
+{
+	assert(g_Resources);
+	using Clock = std::chrono::steady_clock;
+	const auto milliseconds = [](const Clock::time_point from, const Clock::time_point to)
+		{ return std::chrono::duration<double, std::milli>(to - from).count(); };
+	const auto start = Clock::now();
+
+	// Issue this frame's share of queued buffer and texture uploads, even if the frame itself is not drawn
+	if (g_UploadManager)
+		g_UploadManager->Flush();
+
+	// A defragmentation since the snapshot was built has moved the index ranges its draws point at
+	if (g_IndexPool && snapshot.IndexRelocations != g_IndexPool->GetRelocationCount())
+		return false;
+
+	m_Shadows->Update(snapshot);
+	m_ShadowAtlas->Update(snapshot);
+
+	glViewport(0, 0, snapshot.ViewportWidth, snapshot.ViewportHeight);
+	glPolygonMode(GL_FRONT_AND_BACK, snapshot.Wireframe ? GL_LINE : GL_FILL);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	if (g_LitObjectShader)
+	{
+		const Shader& lit = *g_LitObjectShader;
+		lit.Use();
+		lit.SetInt("pointLightCount", static_cast<int>(snapshot.PointLights.size()));
+		lit.SetPointLights(snapshot.PointLights);
+		if (snapshot.Sun)
+			lit.SetDirectionalLight(*snapshot.Sun);
+		if (snapshot.Flashlight)
+			lit.SetSpotLight(*snapshot.Flashlight);
+		lit.SetCameraPosition(snapshot.CameraPosition);
+		m_Shadows->Bind(lit);
+		m_ShadowAtlas->Bind(lit, snapshot);
+	}
+
+	const auto recordStart = Clock::now();
+	auto recorded = recordStart;
+	if (m_UseCommandLists.load(std::memory_order_relaxed))
+	{
+		Record(snapshot);
+		recorded = Clock::now();
+
+		// Waiting on the workers may have run main thread jobs, which can defragment the index pool
+		if (g_IndexPool && snapshot.IndexRelocations != g_IndexPool->GetRelocationCount())
+			return false;
+
+		m_Replayer.Reset();
+		m_Replayer.Replay(m_FrameCommands);
+		for (size_t slice = 0; slice < m_SliceCount; slice++)
+			m_Replayer.Replay(m_CommandLists[slice]);
+		m_Replayer.Reset();
+	}
+	else
+		SubmitDirect(snapshot);
+
+	const auto end = Clock::now();
+	m_SubmitMilliseconds.store(milliseconds(start, end), std::memory_order_relaxed);
+	m_RecordMilliseconds.store(milliseconds(recordStart, recorded), std::memory_order_relaxed);
+	m_IssueMilliseconds.store(milliseconds(recorded, end), std::memory_order_relaxed);
+	return true;
+}
+
+void RenderThread::Record(const FrameSnapshot& snapshot)
+{
+	m_FrameCommands.Clear();
+	const glm::mat4 matrices[] = { snapshot.Projection, snapshot.View };
+	m_FrameCommands.UpdateBuffer(m_Matrices->m_ID, 0, sizeof(matrices), matrices);
+
+	if (snapshot.Skybox)
+	{
+		// Do not set depth buffer, and since the cube is seen from inside its winding order is backwards
+		const SkyboxPacket& skybox = *snapshot.Skybox;
+		m_FrameCommands.BindPipeline(skybox.Shader, { false, true });
+		m_FrameCommands.BindTexture(0, skybox.Texture);
+		m_FrameCommands.DrawIndexed(skybox.VAO, skybox.IndexCount, skybox.IndexOffset);
+	}
+
+	// Each slice is contiguous, so replaying the lists in order keeps the snapshot's draw order
+	const size_t drawCount = snapshot.Draws.size();
+	m_SliceCount = std::clamp<size_t>(drawCount / s_MinDrawsPerSlice, 1, ThreadPool::Get().GetThreadCount() + 1);
+	const size_t sliceSize = (drawCount + m_SliceCount - 1) / m_SliceCount;
+	if (m_CommandLists.size() < m_SliceCount)
+		m_CommandLists.resize(m_SliceCount);
+
+	ThreadPool::Get().ParallelFor(m_SliceCount, [this, &snapshot, drawCount, sliceSize](const size_t slice)
+	{
+		CommandList& list = m_CommandLists[slice];
+		list.Clear();
+
+		MaterialHandle material;
+		for (size_t i = slice * sliceSize; i < std::min(drawCount, (slice + 1) * sliceSize); i++)
+		{
+			const DrawPacket& draw = snapshot.Draws[i];
+			if (!material || draw.Material != material)
+			{
+				list.BindMaterial(draw.Material);
+				material = draw.Material;
+			}
+			list.SetTransform(draw.World, draw.Normal);
+			ForEachVisibleRange(snapshot, draw, [](uint32_t) { return true; },
+				[&list, &draw](const uint32_t indexCount, const GLintptr indexOffset) { list.DrawIndexed(draw.VAO, indexCount, indexOffset); });
+		}
+	});
+}
+
+void RenderThread::SubmitDirect(const FrameSnapshot& snapshot) const
+{
+	const Resources& resources = *g_Resources;
+
+	m_Matrices->SetSubData(0, sizeof(glm::mat4), glm::value_ptr(snapshot.Projection));
+	m_Matrices->SetSubData(sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(snapshot.View));
+
+	if (snapshot.Skybox)
+	{
+		// Do not set depth buffer, and since the cube is seen from inside its winding order is backwards
+		glDepthMask(GL_FALSE);
+		glFrontFace(GL_CW);
+
+		resources.Shaders.Get(snapshot.Skybox->Shader).Use();
+		resources.Textures.Get(snapshot.Skybox->Texture).Use();
+		Renderer::RenderIndexed(snapshot.Skybox->VAO, snapshot.Skybox->IndexCount, snapshot.Skybox->IndexOffset);
+
+		glFrontFace(GL_CCW);
+		glDepthMask(GL_TRUE);
+	}
+
+	for (const DrawPacket& draw : snapshot.Draws)
+	{
+		// Materials removed after the snapshot was built are skipped for this frame
+		const Material* material = resources.Materials.TryGet(draw.Material);
+		if (!material)
+			continue;
+
+		Scene::UseMaterialShader(*material);
+		resources.Shaders.Get(material->Shader).SetTransform(draw.World, draw.Normal);
+		ForEachVisibleRange(snapshot, draw, [](uint32_t) { return true; },
+			[&draw](const uint32_t indexCount, const GLintptr indexOffset) { Renderer::RenderIndexed(draw.VAO, indexCount, indexOffset); });
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CascadedShadowMap.h"
+#include "CommandList.h"
+#include "CommandReplayer.h"
+#include "FrameSnapshot.h"
+#include "ShadowAtlas.h"
+#include "TripleBuffer.h"
+#include "UniformBuffer.h"
+
+struct GLFWwindow;
+
+/* Owns the GL context on a thread of its own and draws the frame snapshots the simulation thread publishes.
+* Snapshots are handed over through a triple buffer, so the simulation builds frame N + 1 while frame N is being
+* submitted, and is only held back when it gets more than one frame ahead. The render thread is also the job
+* system's main thread: between frames it runs main thread jobs, including the scene's MainThread and Exclusive
+* systems, so all GL work and every edit to the resource pools happen here.
+* Draws are recorded into command lists by the workers, one slice of the snapshot each, and replayed here in order.
+* Submitting directly instead is kept for comparison.
+*/
+class RenderThread
+{
+public:
+	using InitFunction = std::function<bool()>;
+	using ShutdownFunction = std::function<void()>;
+
+	// Moves the window's context to a new thread and runs init there, returning once it has finished.
+	// The calling thread must release the context first and must not have used the job system yet
+	RenderThread(GLFWwindow* window, InitFunction init);
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	// False if init failed or the thread has been stopped
+	bool IsRunning() const { return m_Running; }
+
+	// Returns the snapshot to fill for the next frame, cleared. Blocks while the previous frame is still waiting to be drawn
+	FrameSnapshot& BeginFrame();
+	// Publishes the snapshot returned by BeginFrame
+	void EndFrame();
+
+	// Finishes pending main thread jobs, runs shutdown on the render thread while the context is still current, then joins it
+	void Stop(ShutdownFunction shutdown = {});
+
+	// Switches between recording command lists on the workers and issuing every draw directly on the render thread
+	void SetUseCommandLists(const bool useCommandLists) { m_UseCommandLists.store(useCommandLists, std::memory_order_relaxed); }
+	bool GetUseCommandLists() const { return m_UseCommandLists.load(std::memory_order_relaxed); }
+
+	// How long the render thread spent submitting its last frame, and the parts of that spent recording and issuing draws.
+	// Direct submission records nothing, so its issue time compares against command list replay
+	double GetSubmitMilliseconds() const { return m_SubmitMilliseconds.load(std::memory_order_relaxed); }
+	double GetRecordMilliseconds() const { return m_RecordMilliseconds.load(std::memory_order_relaxed); }
+	double GetIssueMilliseconds() const { return m_IssueMilliseconds.load(std::memory_order_relaxed); }
+
+	~RenderThread();
+
+private:
+	void Run(const InitFunction& init);
+	// Issues the snapshot's draws, returning false if it went stale before it could be drawn
+	bool Render(const FrameSnapshot& snapshot);
+	// Records the frame's commands into m_FrameCommands and the draws into one list per slice, in parallel
+	void Record(const FrameSnapshot& snapshot);
+	// Draws the snapshot with direct GL calls, as before command lists
+	void SubmitDirect(const FrameSnapshot& snapshot) const;
+
+private:
+	GLFWwindow* m_Window = nullptr;
+	std::thread m_Thread;
+	TripleBuffer<FrameSnapshot> m_Snapshots;
+	std::unique_ptr<UniformBuffer> m_Matrices; // Projection and view, binding point 0
+	std::unique_ptr<CascadedShadowMap> m_Shadows;
+	std::unique_ptr<ShadowAtlas> m_ShadowAtlas; // Point and spot lights
+
+	CommandList m_FrameCommands; // Camera matrices and skybox, recorded by the render thread
+	std::vector<CommandList> m_CommandLists; // One per slice of the draws, reused from frame to frame
+	size_t m_SliceCount = 0; // Lists recorded this frame
+	CommandReplayer m_Replayer;
+
+	static constexpr size_t s_MinDrawsPerSlice = 256;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	uint64_t m_Published = 0, m_Rendered = 0; // Frame numbers
+	bool m_Started = false, m_Stopping = false;
+	bool m_JobsQueued = false; // Main thread jobs became runnable while the render thread was asleep
+	ShutdownFunction m_Shutdown;
+
+	std::atomic<bool> m_Running = false;
+	std::atomic<bool> m_UseCommandLists = true;
+	std::atomic<double> m_SubmitMilliseconds = 0.0;
+	std::atomic<double> m_RecordMilliseconds = 0.0;
+	std::atomic<double> m_IssueMilliseconds = 0.0;
+};
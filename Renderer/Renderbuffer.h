@@ -5,22 +5,25 @@
 class Renderbuffer
 {
 public:
-	Renderbuffer() { glGenRenderbuffers(1, &m_ID); }
+	Renderbuffer() { glCreateRenderbuffers(1, &m_ID); }
 
 	Renderbuffer(const unsigned int width, const unsigned int height)
 		: m_Width(width), m_Height(height) {
-		glGenRenderbuffers(1, &m_ID);
+		glCreateRenderbuffers(1, &m_ID);
 	}
 
 	Renderbuffer(const GLenum internalFormat, const unsigned int width, const unsigned int height)
 		: m_Width(width), m_Height(height)
 	{
-		glGenRenderbuffers(1, &m_ID);
-		glBindRenderbuffer(GL_RENDERBUFFER, m_ID);
-		glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, m_Width, m_Height);
-		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glCreateRenderbuffers(1, &m_ID);
+		glNamedRenderbufferStorage(m_ID, internalFormat, static_cast<GLsizei>(m_Width), static_cast<GLsizei>(m_Height));
 	}
 
+	Renderbuffer(const Renderbuffer&) = delete;
+	Renderbuffer& operator=(const Renderbuffer&) = delete;
+
+	~Renderbuffer() { glDeleteRenderbuffers(1, &m_ID); }
+
 	operator GLuint& () { return m_ID; }
 	operator const GLuint& () const { return m_ID; }
 
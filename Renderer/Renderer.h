@@ -11,8 +11,19 @@ public:
 
 	static void RenderIndexed(const IndexedVAO& indexedVAO)
 	{
-		glBindVertexArray(indexedVAO);
-		glDrawElements(GL_TRIANGLES, static_cast<int>(indexedVAO.IndexCount), GL_UNSIGNED_INT, nullptr);
+		// Skip meshes whose data is still in flight through the staging ring
+		if (!indexedVAO.IsResident())
+			return;
+
+		RenderIndexed(indexedVAO, indexedVAO.IndexCount, indexedVAO.GetIndexOffset());
+	}
+
+	// Draws indexCount indices starting indexOffset bytes into the VAO's element buffer
+	static void RenderIndexed(const GLuint VAO, const uint32_t indexCount, const GLintptr indexOffset)
+	{
+		glBindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, static_cast<int>(indexCount), GL_UNSIGNED_INT,
+			reinterpret_cast<const void*>(indexOffset)); // NOLINT(performance-no-int-to-ptr)
 	}
 
 	static void RenderLine(const uint32_t& VAO)
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A 32 bit reference to a resource in a ResourcePool: the low 20 bits index the slot and the high 12 count how often
+// the slot was reused, so a handle to a removed resource never resolves to whatever took its place. Null by default
+template<typename T>
+struct Handle
+{
+	uint32_t Value = 0;
+
+	static constexpr uint32_t s_IndexBits = 20;
+	static constexpr uint32_t s_IndexMask = (1u << s_IndexBits) - 1;
+
+	uint32_t GetIndex() const { return Value & s_IndexMask; }
+	uint32_t GetGeneration() const { return Value >> s_IndexBits; }
+
+	explicit operator bool() const { return Value != 0; }
+	bool operator==(const Handle& other) const { return Value == other.Value; }
+	bool operator!=(const Handle& other) const { return Value != other.Value; }
+};
+
+/* Owns resources of one type and hands out generational handles to them.
+* Resolving a handle is a plain array index, with the generation only checked by asserts, so hot paths can store
+* handles instead of shared_ptrs and never touch a reference count. Slot 0 is reserved so a null handle never resolves.
+* Pools are only modified from the main thread; reading from workers is fine while nothing is added or removed.
+*/
+template<typename T>
+class ResourcePool
+{
+public:
+	ResourcePool()
+		: m_Resources(1, nullptr), m_Generations(1, 0), m_Owners(1) {}
+	ResourcePool(const ResourcePool&) = delete;
+	ResourcePool& operator=(const ResourcePool&) = delete;
+
+	// Takes shared ownership of a resource. Adding one that is already pooled returns its existing handle
+	Handle<T> Add(std::shared_ptr<T> resource);
+	template<typename... Args>
+	Handle<T> Emplace(Args&&... args) { return Add(std::make_shared<T>(std::forward<Args>(args)...)); }
+	// Drops the pool's ownership and invalidates every handle to the resource
+	void Remove(Handle<T> handle);
+
+	bool IsValid(const Handle<T> handle) const
+	{
+		return handle.GetIndex() != 0 && handle.GetIndex() < m_Resources.size()
+			&& m_Resources[handle.GetIndex()] && m_Generations[handle.GetIndex()] == handle.GetGeneration();
+	}
+
+	T& Get(const Handle<T> handle) const
+	{
+		assert(IsValid(handle));
+		return *m_Resources[handle.GetIndex()];
+	}
+	// Returns nullptr instead of asserting when the handle is null or stale
+	T* TryGet(const Handle<T> handle) const { return IsValid(handle) ? m_Resources[handle.GetIndex()] : nullptr; }
+	std::shared_ptr<T> GetShared(const Handle<T> handle) const { return IsValid(handle) ? m_Owners[handle.GetIndex()] : nullptr; }
+
+	size_t GetCount() const { return m_Lookup.size(); }
+
+private:
+	std::vector<T*> m_Resources; // Indexed by slot, what lookups read
+	std::vector<uint32_t> m_Generations;
+	std::vector<std::shared_ptr<T>> m_Owners;
+	std::vector<uint32_t> m_FreeSlots;
+	std::unordered_map<const T*, Handle<T>> m_Lookup; // Finds the handle of an already pooled resource
+};
+
+template<typename T>
+Handle<T> ResourcePool<T>::Add(std::shared_ptr<T> resource)
+{
+	if (!resource)
+		return {};
+
+	if (const auto iterator = m_Lookup.find(resource.get()); iterator != m_Lookup.end())
+		return iterator->second;
+
+	uint32_t index;
+	if (!m_FreeSlots.empty())
+	{
+		index = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_Resources.size());
+		assert(index <= Handle<T>::s_IndexMask);
+		m_Resources.emplace_back(nullptr);
+		m_Generations.emplace_back(0);
+		m_Owners.emplace_back();
+	}
+
+	const Handle<T> handle = { m_Generations[index] << Handle<T>::s_IndexBits | index };
+	m_Resources[index] = resource.get();
+	m_Lookup.emplace(resource.get(), handle);
+	m_Owners[index] = std::move(resource);
+	return handle;
+}
+
+template<typename T>
+void ResourcePool<T>::Remove(const Handle<T> handle)
+{
+	if (!IsValid(handle))
+		return;
+
+	const uint32_t index = handle.GetIndex();
+	m_Lookup.erase(m_Resources[index]);
+	m_Resources[index] = nullptr;
+	m_Owners[index].reset();
+	m_Generations[index] = (m_Generations[index] + 1) & (0xFFFFFFFFu >> Handle<T>::s_IndexBits);
+	m_FreeSlots.emplace_back(index);
+}
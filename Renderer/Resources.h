@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+
+#include "ResourcePool.h"
+
+class Shader;
+class Texture;
+struct Material;
+struct TextureAsset;
+
+using ShaderHandle = Handle<Shader>;
+using TextureHandle = Handle<Texture>;
+using MaterialHandle = Handle<Material>;
+// Keeps a texture of the asset manager resident
+using TextureReference = std::shared_ptr<const TextureAsset>;
+
+// The pools components refer into. Resources stay alive until removed from their pool or the pools are destroyed.
+// The render thread reads them while drawing, so they may only be edited on the GL thread, e.g. from a main thread job
+struct Resources
+{
+	ResourcePool<Shader> Shaders;
+	ResourcePool<Texture> Textures;
+	ResourcePool<Material> Materials;
+};
+
+inline std::shared_ptr<Resources> g_Resources;
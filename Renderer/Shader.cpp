@@ -114,10 +114,10 @@ void Shader::SetMat4(const std::string& name, glm::mat4 m) const
     glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(m));
 }
 
-void Shader::SetTransform(const TransformComponent& transform) const
+void Shader::SetTransform(const glm::mat4& model, const glm::mat3& normal) const
 {
-    SetMat4("model", transform.GetTransform());
-    SetMat4("modelInv", glm::inverse(transform.GetTransform()));
+    SetMat4("model", model);
+    SetMat3("normalMatrix", normal);
 }
 
 void Shader::SetUniformBuffer(const std::shared_ptr<UniformBuffer>& uniformBuffer, const std::string& name) const
@@ -52,8 +52,10 @@ public:
     // Set uniform mat4
     void SetMat4(const std::string& name, glm::mat4 m) const;
 
-    // Set uniform transform
-    void SetTransform(const TransformComponent& transform) const;
+    // Set uniform model and normal matrices, "model" and "normalMatrix"
+    void SetTransform(const glm::mat4& model, const glm::mat3& normal) const;
+    void SetTransform(const WorldTransformComponent& transform) const
+        { SetTransform(transform.World, transform.Normal); }
     // Set uniform buffer
     void SetUniformBuffer(const std::shared_ptr<UniformBuffer>& uniformBuffer, const std::string& name) const;
     // Set uniform point lights
@@ -0,0 +1,380 @@
+#include "ShadowAtlas.h"
+
+#include <glm\gtc\matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "Bounds.h"
+#include "FrameSnapshot.h"
+#include "Renderer.h"
+
+namespace
+{
+	// Cube face order the lighting shader selects faces in: +X, -X, +Y, -Y, +Z, -Z
+	const std::array<glm::vec3, 6> s_FaceDirections = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+	const std::array<glm::vec3, 6> s_FaceUps = {
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+
+	Bounds GetRangeBounds(const glm::vec3& position, const float range)
+	{
+		return { position - glm::vec3(range), position + glm::vec3(range) };
+	}
+}
+
+ShadowAtlas::ShadowAtlas(const GLsizei resolution, const uint32_t viewBudget)
+	: m_Resolution(resolution), m_ViewBudget(viewBudget),
+	m_SpotShader("shadowDepth.vert", "shadowDepth.frag"),
+	m_CubeShader("shadowWorld.vert", "shadowCube.geom", "shadowDepth.frag"),
+	m_FreeTiles(s_MaxLevel + 1)
+{
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_Texture);
+	glTextureStorage2D(m_Texture, 1, GL_DEPTH_COMPONENT32F, resolution, resolution);
+	glTextureParameteri(m_Texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_Texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_Texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_Texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_Texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTextureParameteri(m_Texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glCreateFramebuffers(1, &m_Framebuffer);
+	glNamedFramebufferTexture(m_Framebuffer, GL_DEPTH_ATTACHMENT, m_Texture, 0);
+	glNamedFramebufferDrawBuffer(m_Framebuffer, GL_NONE);
+	glNamedFramebufferReadBuffer(m_Framebuffer, GL_NONE);
+
+	m_FreeTiles[0].emplace_back(0, 0);
+}
+
+void ShadowAtlas::Update(const FrameSnapshot& snapshot)
+{
+	m_RenderedViews = 0;
+	for (auto& light : m_Lights)
+		light.Seen = false;
+
+	for (const PointLight& point : snapshot.PointLights)
+	{
+		Track(true, point.m_Index, glm::vec3(point.m_Pos), glm::vec3(0.0f),
+			point.m_Distance > 0.0f ? point.m_Distance : s_DefaultRange, 0.0f);
+	}
+	if (snapshot.Flashlight)
+	{
+		const SpotLight& spot = *snapshot.Flashlight;
+		Track(false, spot.m_Index, glm::vec3(spot.m_Pos), spot.m_Direction,
+			spot.m_Distance > 0.0f ? spot.m_Distance : s_DefaultRange, spot.m_OuterCutOff);
+	}
+
+	// Lights that went away give their tiles back
+	for (auto& light : m_Lights)
+	{
+		if (!light.Seen)
+			FreeTiles(light);
+	}
+	m_Lights.erase(std::remove_if(m_Lights.begin(), m_Lights.end(), [](const LightShadow& light) { return !light.Seen; }), m_Lights.end());
+
+	// Static geometry changing within a light's range dirties it, and a skipped revision may have touched any of them
+	const uint64_t expectedRevision = m_StaticShadowRevision + (snapshot.StaticShadowChanges.empty() ? 0 : 1);
+	const bool missedChanges = snapshot.StaticShadowRevision != expectedRevision;
+	m_StaticShadowRevision = snapshot.StaticShadowRevision;
+
+	// Pixels a unit at unit distance covers on screen
+	const float pixelsPerUnit = snapshot.Projection[1][1] * 0.5f * static_cast<float>(snapshot.ViewportHeight);
+	for (auto& light : m_Lights)
+	{
+		light.Distance = glm::length(light.Position - snapshot.CameraPosition);
+		light.Importance = light.Range * pixelsPerUnit / std::max(light.Distance, s_NearPlane);
+
+		const Bounds range = GetRangeBounds(light.Position, light.Range);
+		light.Dirty |= missedChanges || std::any_of(snapshot.StaticShadowChanges.begin(), snapshot.StaticShadowChanges.end(),
+			[&range](const Bounds& change) { return change.Overlaps(range); });
+		light.MovingCasters = std::any_of(snapshot.Draws.begin(), snapshot.Draws.end(),
+			[&range](const DrawPacket& draw) { return !draw.StaticCaster && draw.WorldBounds.Overlaps(range); });
+	}
+
+	// The most important lights pick their tiles first
+	std::sort(m_Lights.begin(), m_Lights.end(), [](const LightShadow& a, const LightShadow& b) { return a.Importance > b.Importance; });
+	for (auto& light : m_Lights)
+		AssignTiles(light);
+
+	// Changed lights first, nearest first. Then lights around moving casters, by how long they have waited over distance
+	std::vector<LightShadow*> queue;
+	for (auto& light : m_Lights)
+	{
+		if (light.Tiles[0].Level >= 0 && (light.Dirty || light.MovingCasters))
+			queue.push_back(&light);
+	}
+
+	const uint64_t frame = snapshot.Frame;
+	std::sort(queue.begin(), queue.end(), [frame](const LightShadow* a, const LightShadow* b)
+	{
+		if (a->Dirty != b->Dirty)
+			return a->Dirty;
+		if (a->Dirty)
+			return a->Distance < b->Distance;
+		return static_cast<float>(frame - a->RenderedFrame) / (1.0f + a->Distance)
+			> static_cast<float>(frame - b->RenderedFrame) / (1.0f + b->Distance);
+	});
+
+	if (queue.empty())
+		return;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+	glEnable(GL_SCISSOR_TEST);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glDepthMask(GL_TRUE);
+
+	for (LightShadow* light : queue)
+	{
+		const uint32_t views = light->Point ? 6 : 1;
+		if (m_RenderedViews > 0 && m_RenderedViews + views > m_ViewBudget)
+			continue;
+
+		Render(*light, snapshot);
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowAtlas::Bind(const Shader& shader, const FrameSnapshot& snapshot) const
+{
+	glBindTextureUnit(s_TextureUnit, m_Texture);
+	shader.SetInt("shadowAtlas", static_cast<int>(s_TextureUnit));
+
+	// A zero sized tile tells the shader the light is unshadowed
+	for (const PointLight& point : snapshot.PointLights)
+	{
+		if (point.m_Index >= s_PointLightCapacity)
+			continue;
+
+		const LightShadow* light = Find(true, point.m_Index);
+		for (int face = 0; face < 6; face++)
+		{
+			const std::string element = "[" + std::to_string(point.m_Index * 6 + face) + "]";
+			const bool shadowed = light && light->Rendered;
+			shader.SetVec4("pointShadowTiles" + element, shadowed ? GetTileRect(light->Tiles[face]) : glm::vec4(0.0f));
+			if (shadowed)
+				shader.SetMat4("pointShadowMatrices" + element, light->ViewProjections[face]);
+		}
+	}
+
+	const LightShadow* spot = snapshot.Flashlight ? Find(false, snapshot.Flashlight->m_Index) : nullptr;
+	const bool shadowed = spot && spot->Rendered;
+	shader.SetVec4("spotShadowTile", shadowed ? GetTileRect(spot->Tiles[0]) : glm::vec4(0.0f));
+	if (shadowed)
+		shader.SetMat4("spotShadowMatrix", spot->ViewProjections[0]);
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+	glDeleteFramebuffers(1, &m_Framebuffer);
+	glDeleteTextures(1, &m_Texture);
+}
+
+ShadowAtlas::LightShadow& ShadowAtlas::Track(const bool point, const int index, const glm::vec3& position, const glm::vec3& direction,
+	const float range, const float cutOff)
+{
+	auto it = std::find_if(m_Lights.begin(), m_Lights.end(),
+		[point, index](const LightShadow& light) { return light.Point == point && light.Index == index; });
+	if (it == m_Lights.end())
+	{
+		m_Lights.emplace_back();
+		it = std::prev(m_Lights.end());
+		it->Point = point;
+		it->Index = index;
+	}
+
+	LightShadow& light = *it;
+	if (light.Position != position || light.Direction != direction || light.Range != range || light.CutOff != cutOff)
+	{
+		light.Position = position;
+		light.Direction = direction;
+		light.Range = range;
+		light.CutOff = cutOff;
+		light.Dirty = true;
+	}
+
+	light.Seen = true;
+	return light;
+}
+
+void ShadowAtlas::AssignTiles(LightShadow& light)
+{
+	// Smallest power of two tile covering the light's on screen radius, within the levels the atlas hands out
+	const float texels = std::max(light.Importance, 1.0f);
+	const int wanted = static_cast<int>(std::floor(std::log2(static_cast<float>(m_Resolution) / texels)));
+	const int level = std::clamp(wanted, s_MinLevel, s_MaxLevel);
+
+	// Grow as soon as the light needs more texels, but only shrink once it needs a quarter of them, so lights
+	// hovering around a size don't keep trading tiles
+	if (light.RequestedLevel >= 0 && level >= light.RequestedLevel && level <= light.RequestedLevel + 1)
+		return;
+
+	FreeTiles(light);
+	light.RequestedLevel = level;
+	light.Dirty = true;
+
+	// Take the largest size there is room for
+	const int views = light.Point ? 6 : 1;
+	for (int size = level; size <= s_MaxLevel; size++)
+	{
+		int allocated = 0;
+		for (; allocated < views; allocated++)
+		{
+			if (!AllocateTile(size, light.Tiles[allocated].Position))
+				break;
+			light.Tiles[allocated].Level = size;
+		}
+
+		if (allocated == views)
+			return;
+
+		for (int i = 0; i < allocated; i++)
+		{
+			FreeTile(size, light.Tiles[i].Position);
+			light.Tiles[i].Level = -1;
+		}
+	}
+}
+
+void ShadowAtlas::FreeTiles(LightShadow& light)
+{
+	for (auto& tile : light.Tiles)
+	{
+		if (tile.Level >= 0)
+			FreeTile(tile.Level, tile.Position);
+		tile.Level = -1;
+	}
+	light.Rendered = false;
+}
+
+void ShadowAtlas::Render(LightShadow& light, const FrameSnapshot& snapshot)
+{
+	const int views = light.Point ? 6 : 1;
+	const float fov = light.Point ? glm::half_pi<float>() : std::min(2.0f * std::acos(light.CutOff) + 0.1f, glm::radians(170.0f));
+	const glm::mat4 projection = glm::perspective(fov, 1.0f, s_NearPlane, light.Range);
+
+	const glm::vec3 spotUp = std::abs(light.Direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	constexpr float clearDepth = 1.0f;
+	for (int view = 0; view < views; view++)
+	{
+		const glm::mat4 lightView = light.Point
+			? glm::lookAt(light.Position, light.Position + s_FaceDirections[view], s_FaceUps[view])
+			: glm::lookAt(light.Position, light.Position + light.Direction, spotUp);
+		light.ViewProjections[view] = projection * lightView;
+
+		// Each view's viewport and scissor cover its tile, the geometry shader picks the viewport per face
+		const Tile& tile = light.Tiles[view];
+		const GLsizei size = GetTileSize(tile.Level);
+		glClearTexSubImage(m_Texture, 0, tile.Position.x, tile.Position.y, 0, size, size, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &clearDepth);
+		glViewportIndexedf(view, static_cast<float>(tile.Position.x), static_cast<float>(tile.Position.y), static_cast<float>(size), static_cast<float>(size));
+		glScissorIndexed(view, tile.Position.x, tile.Position.y, size, size);
+	}
+
+	const Shader& shader = light.Point ? m_CubeShader : m_SpotShader;
+	shader.Use();
+	if (light.Point)
+	{
+		for (int view = 0; view < views; view++)
+			shader.SetMat4("faceViewProjections[" + std::to_string(view) + "]", light.ViewProjections[view]);
+	}
+	else
+		shader.SetMat4("lightSpace", light.ViewProjections[0]);
+
+	const Bounds range = GetRangeBounds(light.Position, light.Range);
+	for (const DrawPacket& draw : snapshot.Draws)
+	{
+		if (!draw.WorldBounds.Overlaps(range))
+			continue;
+
+		shader.SetMat4("model", draw.World);
+		ForEachVisibleRange(snapshot, draw,
+			[&snapshot, &range](const uint32_t subMesh) { return snapshot.SubMeshes[subMesh].WorldBounds.Overlaps(range); },
+			[&draw](const uint32_t indexCount, const GLintptr indexOffset) { Renderer::RenderIndexed(draw.VAO, indexCount, indexOffset); });
+	}
+
+	light.Dirty = false;
+	light.Rendered = true;
+	light.RenderedFrame = snapshot.Frame;
+	m_RenderedViews += static_cast<uint32_t>(views);
+}
+
+bool ShadowAtlas::AllocateTile(const int level, glm::ivec2& position)
+{
+	if (level < 0)
+		return false;
+
+	auto& free = m_FreeTiles[level];
+	if (!free.empty())
+	{
+		position = free.back();
+		free.pop_back();
+		return true;
+	}
+
+	// Split a tile from the level above into four, keeping one
+	glm::ivec2 parent;
+	if (!AllocateTile(level - 1, parent))
+		return false;
+
+	const GLsizei size = GetTileSize(level);
+	free.emplace_back(parent.x + size, parent.y);
+	free.emplace_back(parent.x, parent.y + size);
+	free.emplace_back(parent.x + size, parent.y + size);
+	position = parent;
+	return true;
+}
+
+void ShadowAtlas::FreeTile(const int level, const glm::ivec2 position)
+{
+	auto& free = m_FreeTiles[level];
+	if (level == 0)
+	{
+		free.push_back(position);
+		return;
+	}
+
+	// Merge back into the parent once all four quarters are free
+	const GLsizei size = GetTileSize(level);
+	const glm::ivec2 parent = position / (2 * size) * (2 * size);
+	int siblings = 0;
+	for (const glm::ivec2& tile : free)
+	{
+		if (tile / (2 * size) * (2 * size) == parent)
+			siblings++;
+	}
+
+	if (siblings < 3)
+	{
+		free.push_back(position);
+		return;
+	}
+
+	free.erase(std::remove_if(free.begin(), free.end(),
+		[size, parent](const glm::ivec2& tile) { return tile / (2 * size) * (2 * size) == parent; }), free.end());
+	FreeTile(level - 1, parent);
+}
+
+glm::vec4 ShadowAtlas::GetTileRect(const Tile& tile) const
+{
+	const float resolution = static_cast<float>(m_Resolution);
+	const float size = static_cast<float>(GetTileSize(tile.Level));
+	return { glm::vec2(tile.Position) / resolution, size / resolution, size / resolution };
+}
+
+const ShadowAtlas::LightShadow* ShadowAtlas::Find(const bool point, const int index) const
+{
+	const auto it = std::find_if(m_Lights.begin(), m_Lights.end(),
+		[point, index](const LightShadow& light) { return light.Point == point && light.Index == index; });
+	return it != m_Lights.end() ? &*it : nullptr;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Shader.h"
+
+struct FrameSnapshot;
+
+/* Shadows for point and spot lights, packed into tiles of one shared depth atlas.
+* Tiles are square and carved out of the atlas by a quadtree, so freeing them coalesces back into larger ones.
+* Each light's tile size follows its importance, the radius its range covers on screen, and only changes once that
+* has grown past the tile or shrunk well below it. A point light takes six tiles of one size, one per cube face, and
+* fills all of them in a single pass: a geometry shader replicates each triangle into six viewports.
+* Only a budget of light views is redrawn per frame. Lights whose tiles, pose or nearby static geometry changed go
+* first, nearest first; after them come lights lit around moving casters, the longest waiting and nearest first.
+* Lights that get no tile, or have not been drawn yet, are left unshadowed.
+*/
+class ShadowAtlas
+{
+public:
+	static constexpr GLuint s_TextureUnit = 9; // After the cascaded shadow map
+
+	explicit ShadowAtlas(GLsizei resolution = 4096, uint32_t viewBudget = 12);
+	ShadowAtlas(const ShadowAtlas&) = delete;
+	ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+	// Reassigns tiles to the snapshot's lights and redraws the most urgent views within the budget.
+	// Leaves the default framebuffer bound and the viewport unset
+	void Update(const FrameSnapshot& snapshot);
+	// Binds the atlas and sets the shadow uniforms for the snapshot's point lights and flashlight
+	void Bind(const Shader& shader, const FrameSnapshot& snapshot) const;
+
+	void SetViewBudget(const uint32_t viewBudget) { m_ViewBudget = viewBudget; }
+	// Light views drawn during the last Update
+	uint32_t GetRenderedViews() const { return m_RenderedViews; }
+
+	~ShadowAtlas();
+
+private:
+	struct Tile
+	{
+		glm::ivec2 Position = glm::ivec2(0);
+		int Level = -1; // Quadtree depth, the tile is resolution >> Level texels wide. -1 when unallocated
+	};
+
+	struct LightShadow
+	{
+		bool Point = false;
+		int Index = 0; // The light's m_Index, which its copies share
+		std::array<Tile, 6> Tiles; // Only the first is used by spot lights
+		std::array<glm::mat4, 6> ViewProjections;
+
+		glm::vec3 Position = glm::vec3(0.0f);
+		glm::vec3 Direction = glm::vec3(0.0f);
+		float Range = 0.0f, CutOff = 0.0f;
+		float Distance = 0.0f; // From the camera
+		float Importance = 0.0f; // Radius in pixels the light's range covers on screen
+
+		int RequestedLevel = -1; // Tile level last asked for, which may be larger than what there was room for
+		bool Dirty = true; // Needs drawing before its shadows are right
+		bool MovingCasters = false; // Non-static geometry is inside its range
+		bool Rendered = false; // Its tiles hold a complete shadow
+		uint64_t RenderedFrame = 0;
+		bool Seen = false;
+	};
+
+	// Finds or adds the state for a light, updating its pose and marking it dirty if it moved
+	LightShadow& Track(bool point, int index, const glm::vec3& position, const glm::vec3& direction, float range, float cutOff);
+	// Gives a light tiles of the size its importance calls for, if it needs new ones and there is room
+	void AssignTiles(LightShadow& light);
+	void FreeTiles(LightShadow& light);
+	// Draws every view of a light into its tiles
+	void Render(LightShadow& light, const FrameSnapshot& snapshot);
+
+	bool AllocateTile(int level, glm::ivec2& position);
+	void FreeTile(int level, glm::ivec2 position);
+	GLsizei GetTileSize(const int level) const { return m_Resolution >> level; }
+	glm::vec4 GetTileRect(const Tile& tile) const; // Offset and scale in atlas texture coordinates
+	const LightShadow* Find(bool point, int index) const;
+
+private:
+	GLsizei m_Resolution = 0;
+	uint32_t m_ViewBudget = 0;
+	GLuint m_Texture = 0;
+	GLuint m_Framebuffer = 0;
+	Shader m_SpotShader;
+	Shader m_CubeShader;
+
+	std::vector<std::vector<glm::ivec2>> m_FreeTiles; // Per quadtree level
+	std::vector<LightShadow> m_Lights;
+	uint64_t m_StaticShadowRevision = 0;
+	uint32_t m_RenderedViews = 0;
+
+	static constexpr int s_MinLevel = 2; // Largest tile, a quarter of the atlas wide
+	static constexpr int s_MaxLevel = 5; // Smallest tile
+	static constexpr float s_DefaultRange = 50.0f; // For lights without a distance, which never fully fall off
+	static constexpr float s_NearPlane = 0.05f;
+	static constexpr int s_PointLightCapacity = 1; // POINT_LIGHT_CAPACITY in objectLitByVariousLights.frag
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/* Hands values from one producer thread to one consumer thread without locks.
+* Three slots rotate between the writer, the reader and a shared middle slot. Publishing swaps the written slot
+* into the middle and flags it fresh; acquiring swaps a fresh middle slot out for the one just read. Neither side
+* ever waits on the other, and the reader always sees the newest published value, skipping any it was too slow for.
+* Slots are reused rather than reconstructed, so containers inside them keep their capacity from frame to frame.
+*/
+template<typename T>
+class TripleBuffer
+{
+public:
+	// Producer side. The slot stays private to the writer until Publish
+	T& GetWriteSlot() { return m_Slots[m_Write]; }
+	void Publish()
+	{
+		const uint8_t previous = m_Shared.exchange(static_cast<uint8_t>(m_Write | s_Fresh), std::memory_order_acq_rel);
+		m_Write = previous & s_IndexMask;
+	}
+
+	// Consumer side. Returns true and moves the read slot to the newest value if one was published since the last call
+	bool Acquire()
+	{
+		if (!(m_Shared.load(std::memory_order_relaxed) & s_Fresh))
+			return false;
+
+		const uint8_t previous = m_Shared.exchange(m_Read, std::memory_order_acq_rel);
+		m_Read = previous & s_IndexMask;
+		return true;
+	}
+	const T& GetReadSlot() const { return m_Slots[m_Read]; }
+
+private:
+	static constexpr uint8_t s_IndexMask = 0b011;
+	static constexpr uint8_t s_Fresh = 0b100;
+
+private:
+	std::array<T, 3> m_Slots;
+	uint8_t m_Write = 0, m_Read = 1;
+	std::atomic<uint8_t> m_Shared = 2; // Middle slot index, plus s_Fresh while it holds an unread value
+};
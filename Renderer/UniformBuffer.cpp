@@ -1,17 +1,17 @@
 ﻿#include "UniformBuffer.h"
 
-void UniformBuffer::SetData(const GLsizeiptr size, const void* data, const GLenum usage) const
+#include <cassert>
+
+void UniformBuffer::SetData(const GLsizeiptr size, const void* data, const GLbitfield flags)
 {
-	glBindBuffer(GL_UNIFORM_BUFFER, m_ID);
-	glBufferData(GL_UNIFORM_BUFFER, size, data, usage);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	assert(m_Size == 0 && "UniformBuffer storage is immutable");
+	glNamedBufferStorage(m_ID, size, data, flags);
+	m_Size = size;
 }
 
 void UniformBuffer::SetSubData(const GLintptr offset, const GLsizeiptr size, const GLvoid* data) const
 {
-	glBindBuffer(GL_UNIFORM_BUFFER, m_ID);
-	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glNamedBufferSubData(m_ID, offset, size, data);
 }
 
 void UniformBuffer::BindDataRange(const GLuint index, const GLintptr offset, const GLsizeiptr size)
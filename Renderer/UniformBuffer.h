@@ -6,10 +6,10 @@ class UniformBuffer
 {
 public:
 	explicit UniformBuffer()
-		{ glGenBuffers(1, &m_ID); }
+		{ glCreateBuffers(1, &m_ID); }
 
-	// Sets the buffer data to the data provided. Can be used to allocate space
-	void SetData(GLsizeiptr size, const void* data, GLenum usage = GL_STATIC_DRAW) const;
+	// Allocates immutable storage initialised with data (may be null). Storage can only be allocated once
+	void SetData(GLsizeiptr size, const void* data, GLbitfield flags = GL_DYNAMIC_STORAGE_BIT);
 	// Sets a range of buffer data to the given data
 	void SetSubData(GLintptr offset, GLsizeiptr size, const GLvoid* data) const;
 	// Binds a range of the buffer to a specific index (binding point)
@@ -25,4 +25,5 @@ public:
 public:
 	unsigned int m_ID = 0; // Buffer ID
 	unsigned int m_Index = 0; // Binding Point
+	GLsizeiptr m_Size = 0; // Bytes of storage, 0 until SetData is called
 };
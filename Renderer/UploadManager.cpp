@@ -0,0 +1,274 @@
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "..\utils.h"
+
+namespace
+{
+	constexpr GLsizeiptr s_Alignment = 16;
+
+	GLsizeiptr AlignUp(const GLsizeiptr value)
+	{
+		return (value + s_Alignment - 1) & ~(s_Alignment - 1);
+	}
+
+	GLsizeiptr BytesPerPixel(const GLenum format, const GLenum type)
+	{
+		const GLsizeiptr components = format == GL_RED ? 1 : format == GL_RG ? 2 : (format == GL_RGB || format == GL_BGR) ? 3 : 4;
+		const GLsizeiptr componentSize = type == GL_FLOAT ? 4 : (type == GL_HALF_FLOAT || type == GL_UNSIGNED_SHORT) ? 2 : 1;
+		return components * componentSize;
+	}
+}
+
+UploadManager::UploadManager(const GLsizeiptr ringSize, const GLsizeiptr frameBudget)
+	: m_RingSize(ringSize), m_FrameBudget(frameBudget)
+{
+	constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &m_Ring);
+	glNamedBufferStorage(m_Ring, m_RingSize, nullptr, flags);
+	m_Mapped = static_cast<char*>(glMapNamedBufferRange(m_Ring, 0, m_RingSize, flags));
+
+	if (!m_Mapped)
+		LogError("UPLOAD_MANAGER: Failed to map the staging ring, uploads will go direct");
+}
+
+void UploadManager::UploadBuffer(const GLuint buffer, const GLintptr offset, const GLsizeiptr size, const void* data, std::function<void()> onComplete)
+{
+	Request request;
+	request.Type = RequestType::Buffer;
+	request.Target = buffer;
+	request.Offset = offset;
+	request.Data.assign(static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	request.OnComplete = std::move(onComplete);
+
+	m_PendingBytes += size;
+	m_Pending.emplace_back(std::move(request));
+}
+
+void UploadManager::UploadTexture2D(const GLuint texture, const GLint level, const GLint x, const GLint y, const GLsizei width, const GLsizei height,
+	const GLenum format, const GLenum type, const void* data, const bool generateMipmaps, std::function<void()> onComplete)
+{
+	const GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * BytesPerPixel(format, type);
+
+	Request request;
+	request.Type = RequestType::Texture2D;
+	request.Target = texture;
+	request.Level = level;
+	request.X = x;
+	request.Y = y;
+	request.Width = width;
+	request.Height = height;
+	request.Format = format;
+	request.DataType = type;
+	request.GenerateMipmaps = generateMipmaps;
+	request.Data.assign(static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	request.OnComplete = std::move(onComplete);
+
+	m_PendingBytes += size;
+	m_Pending.emplace_back(std::move(request));
+}
+
+void UploadManager::Flush()
+{
+	Retire();
+
+	InFlightBatch batch;
+	GLsizeiptr issued = 0;
+
+	while (!m_Pending.empty())
+	{
+		Request& request = m_Pending.front();
+		const auto size = static_cast<GLsizeiptr>(request.Data.size());
+
+		if (!m_Mapped || (request.Type == RequestType::Texture2D && size > m_RingSize / 2))
+		{
+			// Can never be staged, so upload it synchronously
+			UploadDirect(request);
+			m_PendingBytes -= size - request.Consumed;
+			issued += size - request.Consumed;
+		}
+		else
+		{
+			// Buffers go out in pieces so one huge upload can't monopolize the ring
+			const GLsizeiptr chunk = request.Type == RequestType::Buffer
+				? std::min(size - request.Consumed, m_RingSize / 4)
+				: size;
+
+			// Always let at least one upload through so anything larger than the budget still progresses
+			if (issued > 0 && issued + chunk > m_FrameBudget)
+				break;
+
+			GLsizeiptr ringOffset = 0;
+			if (chunk > 0 && !Allocate(chunk, ringOffset))
+				break;
+
+			if (chunk > 0)
+				std::memcpy(m_Mapped + ringOffset, request.Data.data() + request.Consumed, static_cast<size_t>(chunk));
+
+			if (request.Type == RequestType::Buffer && chunk > 0)
+			{
+				glCopyNamedBufferSubData(m_Ring, request.Target, ringOffset, request.Offset + request.Consumed, chunk);
+			}
+			else if (request.Type == RequestType::Texture2D && chunk > 0)
+			{
+				// Pixel transfers have no named buffer entry point, so the ring is bound as the unpack source for the copy
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Ring);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+				glTextureSubImage2D(request.Target, request.Level, request.X, request.Y, request.Width, request.Height,
+					request.Format, request.DataType, reinterpret_cast<const void*>(ringOffset)); // NOLINT(performance-no-int-to-ptr)
+				if (request.GenerateMipmaps)
+					glGenerateTextureMipmap(request.Target);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			}
+
+			request.Consumed += chunk;
+			m_PendingBytes -= chunk;
+			issued += chunk;
+
+			if (request.Consumed < size)
+				continue;
+		}
+
+		if (request.OnComplete)
+			batch.Callbacks.emplace_back(std::move(request.OnComplete));
+		m_Pending.pop_front();
+	}
+
+	if (issued > 0 || !batch.Callbacks.empty())
+	{
+		batch.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		batch.RingEnd = m_Head;
+		m_InFlight.emplace_back(std::move(batch));
+	}
+}
+
+void UploadManager::Finish()
+{
+	constexpr GLuint64 timeout = 1000000000; // 1 second
+
+	const GLsizeiptr frameBudget = m_FrameBudget;
+	m_FrameBudget = std::numeric_limits<GLsizeiptr>::max();
+
+	while (!m_Pending.empty() || !m_InFlight.empty())
+	{
+		Flush();
+
+		// Wait for the oldest batch so the next Flush can reuse its ring space
+		if (!m_InFlight.empty())
+			glClientWaitSync(m_InFlight.front().Fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	}
+
+	m_FrameBudget = frameBudget;
+}
+
+UploadManager::~UploadManager()
+{
+	for (const auto& batch : m_InFlight)
+		glDeleteSync(batch.Fence);
+
+	if (m_Mapped)
+		glUnmapNamedBuffer(m_Ring);
+	glDeleteBuffers(1, &m_Ring);
+}
+
+bool UploadManager::Allocate(const GLsizeiptr size, GLsizeiptr& offset)
+{
+	// m_Head == m_Tail means the ring is empty, so the head may never catch up to the tail from behind
+	const GLsizeiptr start = AlignUp(m_Head);
+
+	if (m_Head >= m_Tail)
+	{
+		// Free space is [head, end) followed by [0, tail)
+		if (start + size <= m_RingSize)
+			offset = start;
+		else if (size < m_Tail)
+			offset = 0;
+		else
+			return false;
+	}
+	else
+	{
+		// Free space is [head, tail)
+		if (start + size < m_Tail)
+			offset = start;
+		else
+			return false;
+	}
+
+	m_Head = offset + size;
+	return true;
+}
+
+void UploadManager::Retire()
+{
+	// Batches complete in submission order
+	while (!m_InFlight.empty())
+	{
+		InFlightBatch& batch = m_InFlight.front();
+		const GLenum status = glClientWaitSync(batch.Fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+
+		glDeleteSync(batch.Fence);
+		m_Tail = batch.RingEnd;
+		for (const auto& callback : batch.Callbacks)
+			callback();
+		m_InFlight.pop_front();
+	}
+
+	if (m_InFlight.empty())
+		m_Head = m_Tail = 0;
+}
+
+void UploadManager::UploadDirect(const Request& request)
+{
+	if (request.Type == RequestType::Buffer)
+	{
+		glNamedBufferSubData(request.Target, request.Offset + request.Consumed,
+			static_cast<GLsizeiptr>(request.Data.size()) - request.Consumed, request.Data.data() + request.Consumed);
+		return;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(request.Target, request.Level, request.X, request.Y, request.Width, request.Height,
+		request.Format, request.DataType, request.Data.data());
+	if (request.GenerateMipmaps)
+		glGenerateTextureMipmap(request.Target);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void StageBufferUpload(const GLuint buffer, const GLintptr offset, const GLsizeiptr size, const void* data, std::function<void()> onComplete)
+{
+	if (g_UploadManager)
+	{
+		g_UploadManager->UploadBuffer(buffer, offset, size, data, std::move(onComplete));
+		return;
+	}
+
+	glNamedBufferSubData(buffer, offset, size, data);
+	if (onComplete)
+		onComplete();
+}
+
+void StageTextureUpload(const GLuint texture, const GLint level, const GLint x, const GLint y, const GLsizei width, const GLsizei height,
+	const GLenum format, const GLenum type, const void* data, const bool generateMipmaps, std::function<void()> onComplete)
+{
+	if (g_UploadManager)
+	{
+		g_UploadManager->UploadTexture2D(texture, level, x, y, width, height, format, type, data, generateMipmaps, std::move(onComplete));
+		return;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(texture, level, x, y, width, height, format, type, data);
+	if (generateMipmaps)
+		glGenerateTextureMipmap(texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (onComplete)
+		onComplete();
+}
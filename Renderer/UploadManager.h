@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/* Routes buffer and texture uploads through one persistently mapped staging ring.
+* Uploads are queued on the CPU, then Flush() copies as many as the per-frame byte budget allows into the ring
+* and records the matching GPU copy commands. Every frame's copies are fenced, ring space is reclaimed once the
+* fence signals, and each upload's completion callback runs at that point.
+*/
+class UploadManager
+{
+public:
+	explicit UploadManager(GLsizeiptr ringSize = 16 << 20, GLsizeiptr frameBudget = 4 << 20);
+	UploadManager(const UploadManager&) = delete;
+	UploadManager& operator=(const UploadManager&) = delete;
+
+	// Queues a copy of data into [offset, offset + size) of buffer
+	void UploadBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data, std::function<void()> onComplete = {});
+	// Queues a copy of tightly packed pixels into a region of a 2D texture's level, optionally regenerating its mipmaps afterwards
+	void UploadTexture2D(GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type,
+		const void* data, bool generateMipmaps = false, std::function<void()> onComplete = {});
+
+	// Retires finished copies and issues queued ones up to the frame budget. Call once per frame before rendering
+	void Flush();
+	// Issues every queued upload regardless of budget and blocks until the GPU has consumed them all
+	void Finish();
+
+	GLsizeiptr GetPendingBytes() const { return m_PendingBytes; }
+	GLsizeiptr GetFrameBudget() const { return m_FrameBudget; }
+	void SetFrameBudget(const GLsizeiptr frameBudget) { m_FrameBudget = frameBudget; }
+
+	~UploadManager();
+
+private:
+	enum class RequestType { Buffer, Texture2D };
+
+	struct Request
+	{
+		RequestType Type = RequestType::Buffer;
+		GLuint Target = 0; // Buffer or texture name
+		GLintptr Offset = 0; // Destination offset, buffers only
+		GLint Level = 0, X = 0, Y = 0; // Textures only
+		GLsizei Width = 0, Height = 0;
+		GLenum Format = GL_RGBA, DataType = GL_UNSIGNED_BYTE;
+		bool GenerateMipmaps = false;
+		std::vector<char> Data;
+		GLsizeiptr Consumed = 0; // Bytes already issued, large buffer uploads go out in ring sized pieces
+		std::function<void()> OnComplete;
+	};
+
+	struct InFlightBatch
+	{
+		GLsync Fence = nullptr;
+		GLsizeiptr RingEnd = 0;
+		std::vector<std::function<void()>> Callbacks;
+	};
+
+	// Reserves size bytes of the ring, returning false if that would overwrite data the GPU may still be reading
+	bool Allocate(GLsizeiptr size, GLsizeiptr& offset);
+	// Retires batches whose fence has signalled
+	void Retire();
+	// Uploads a request synchronously when it can never fit in the ring
+	static void UploadDirect(const Request& request);
+
+private:
+	GLuint m_Ring = 0;
+	char* m_Mapped = nullptr;
+	GLsizeiptr m_RingSize = 0;
+	GLsizeiptr m_Head = 0; // Next free byte
+	GLsizeiptr m_Tail = 0; // Oldest byte the GPU may still read
+	GLsizeiptr m_FrameBudget = 0;
+	GLsizeiptr m_PendingBytes = 0;
+	std::deque<Request> m_Pending;
+	std::deque<InFlightBatch> m_InFlight;
+};
+
+inline std::shared_ptr<UploadManager> g_UploadManager;
+
+// Queues a buffer upload on g_UploadManager, or uploads it immediately and runs onComplete if there is none
+void StageBufferUpload(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data, std::function<void()> onComplete = {});
+// Queues a texture upload on g_UploadManager, or uploads it immediately and runs onComplete if there is none
+void StageTextureUpload(GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type,
+	const void* data, bool generateMipmaps = false, std::function<void()> onComplete = {});
@@ -0,0 +1,57 @@
+#include "ColorPalette.h"
+
+#include <algorithm>
+
+#include "..\..\utils.h"
+#include "..\..\Renderer\UploadManager.h"
+
+ColorPalette::ColorPalette()
+	: m_Texture(std::make_shared<Tex2D>(s_Size, s_Size, "BaseColor"))
+{
+	// Every lookup lands on a texel center, so filtering must never blend neighbouring colors
+	m_Texture->SetWrap(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_Texture->m_ID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_Texture->m_ID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+uint32_t ColorPalette::GetSlot(const glm::vec4 color)
+{
+	const uint32_t key = Quantize(color);
+
+	if (const auto iterator = m_Slots.find(key); iterator != m_Slots.end())
+		return iterator->second;
+
+	if (m_Slots.size() >= s_Capacity)
+	{
+		LogError("COLOR_PALETTE: Palette is full, falling back to slot 0");
+		return 0;
+	}
+
+	const auto slot = static_cast<uint32_t>(m_Slots.size());
+	m_Slots.emplace(key, slot);
+
+	// key is already laid out as R, G, B, A bytes
+	const auto x = static_cast<GLint>(slot % s_Size);
+	const auto y = static_cast<GLint>(slot / s_Size);
+	StageTextureUpload(m_Texture->m_ID, 0, x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &key);
+
+	return slot;
+}
+
+glm::vec4 ColorPalette::GetUVTransform(const uint32_t slot) const
+{
+	constexpr float texelSize = 1.0f / static_cast<float>(s_Size);
+	const auto x = static_cast<float>(slot % s_Size);
+	const auto y = static_cast<float>(slot / s_Size);
+
+	// Zero scale collapses every UV onto the center of the slot's texel
+	return { 0.0f, 0.0f, (x + 0.5f) * texelSize, (y + 0.5f) * texelSize };
+}
+
+uint32_t ColorPalette::Quantize(const glm::vec4 color)
+{
+	const auto toByte = [](const float channel)
+		{ return static_cast<uint32_t>(std::clamp(channel, 0.0f, 1.0f) * 255.0f + 0.5f); };
+
+	return toByte(color.r) | toByte(color.g) << 8 | toByte(color.b) << 16 | toByte(color.a) << 24;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include "Texture.h"
+
+// A single shared texture holding every solid color used by the scene.
+// Colors are quantized to RGBA8 and deduplicated, so any number of tinted materials
+// sample the same texture object through a UV transform instead of owning a 1x1 texture each.
+class ColorPalette
+{
+public:
+	ColorPalette();
+
+	// Returns the palette slot of a color, adding it to the palette if it is not present yet
+	uint32_t GetSlot(glm::vec4 color);
+	// Returns the UV transform (xy = scale, zw = offset) that maps any UV onto the slot's texel
+	glm::vec4 GetUVTransform(uint32_t slot) const;
+	// Returns the UV transform for a color, adding it to the palette if needed
+	glm::vec4 GetUVTransform(const glm::vec4 color)
+		{ return GetUVTransform(GetSlot(color)); }
+
+	std::shared_ptr<Tex2D> GetTexture() const { return m_Texture; }
+	size_t GetColorCount() const { return m_Slots.size(); }
+
+	// Packs a color into RGBA8, the key used to deduplicate palette entries
+	static uint32_t Quantize(glm::vec4 color);
+
+public:
+	static constexpr GLsizei s_Size = 256; // Width and height of the palette texture in texels
+	static constexpr uint32_t s_Capacity = s_Size * s_Size;
+
+private:
+	std::shared_ptr<Tex2D> m_Texture;
+	std::unordered_map<uint32_t, uint32_t> m_Slots = std::unordered_map<uint32_t, uint32_t>(); // Quantized color -> slot
+};
+
+inline std::shared_ptr<ColorPalette> g_ColorPalette;
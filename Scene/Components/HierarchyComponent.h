@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+#include "entt\include\entt.hpp"
+
+// Intrusive parent/child links. Children form a doubly linked list of siblings hanging off their parent
+struct HierarchyComponent
+{
+	entt::entity Parent = entt::null;
+	entt::entity FirstChild = entt::null;
+	entt::entity PrevSibling = entt::null;
+	entt::entity NextSibling = entt::null;
+	uint32_t Depth = 0; // Number of ancestors, roots are 0
+};
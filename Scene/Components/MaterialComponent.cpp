@@ -1,39 +1,32 @@
 #include "MaterialComponent.h"
 
-#include <iostream>
+#include "ColorPalette.h"
+#include "..\..\Renderer\AssetManager.h"
 
-MaterialComponent::MaterialComponent(const std::vector<std::shared_ptr<Tex2D>>& textures, const float shininess)
-    : m_Shininess(shininess)
+void Material::SetBaseColor(ColorPalette& palette, const glm::vec4 color)
 {
-    for (const auto& texture : textures)
-    {
-        if (texture->m_Tag == "BaseColor")        m_BaseColorMap = texture;
-        if (texture->m_Tag == "Albedo")           m_AlbedoMap = texture;
-        if (texture->m_Tag == "Metallic")         m_MetallicMap = texture;
-        if (texture->m_Tag == "Roughness")        m_RoughnessMap = texture;
-        if (texture->m_Tag == "AmbientOcclusion") m_AmbientOcclusionMap = texture;
-        if (texture->m_Tag == "Normal")           m_NormalMap = texture;
-        if (texture->m_Tag == "Height")           m_HeightMap = texture;
-        if (texture->m_Tag == "Opacity")          m_OpacityMap = texture;
-        if (texture->m_Tag == "Emission")         m_EmissionMap = texture;
-    }
+    SetMap(MaterialMap::BaseColor, g_Resources->Textures.Add(palette.GetTexture()));
+    BaseColorUVTransform = palette.GetUVTransform(color);
+    BaseColor = color;
 }
 
-MaterialComponent::MaterialComponent(std::weak_ptr<Shader> shader, const std::vector<std::shared_ptr<Tex2D>>& textures, const float shininess)
-    : m_Shininess(shininess)
+void Material::SetMap(const MaterialMap map, TextureReference texture)
 {
-    m_Shader = std::move(shader);
+    Maps[static_cast<size_t>(map)] = texture ? texture->Texture : TextureHandle();
+    Assets[static_cast<size_t>(map)] = std::move(texture);
+}
 
-    for (const auto& texture : textures)
-    {
-        if (texture->m_Tag == "BaseColor")        m_BaseColorMap = texture;
-        if (texture->m_Tag == "Albedo")           m_AlbedoMap = texture;
-        if (texture->m_Tag == "Metallic")         m_MetallicMap = texture;
-        if (texture->m_Tag == "Roughness")        m_RoughnessMap = texture;
-        if (texture->m_Tag == "AmbientOcclusion") m_AmbientOcclusionMap = texture;
-        if (texture->m_Tag == "Normal")           m_NormalMap = texture;
-        if (texture->m_Tag == "Height")           m_HeightMap = texture;
-        if (texture->m_Tag == "Opacity")          m_OpacityMap = texture;
-        if (texture->m_Tag == "Emission")         m_EmissionMap = texture;
-    }
+MaterialMap Material::MapFromTag(const std::string& tag)
+{
+    if (tag == "BaseColor")        return MaterialMap::BaseColor;
+    if (tag == "Albedo")           return MaterialMap::Albedo;
+    if (tag == "Metallic")         return MaterialMap::Metallic;
+    if (tag == "Roughness")        return MaterialMap::Roughness;
+    if (tag == "AmbientOcclusion") return MaterialMap::AmbientOcclusion;
+    if (tag == "Normal")           return MaterialMap::Normal;
+    if (tag == "normal")           return MaterialMap::Normal; // What models name the maps they import as normal maps
+    if (tag == "Height")           return MaterialMap::Height;
+    if (tag == "Opacity")          return MaterialMap::Opacity;
+    if (tag == "Emission")         return MaterialMap::Emission;
+    return MaterialMap::Count;
 }
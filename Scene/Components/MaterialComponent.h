@@ -1,51 +1,74 @@
 #pragma once
 
-#include <memory>
-#include <utility>
-#include <vector>
+#include <array>
+#include <cstdint>
+#include <string>
 
-#include "Texture.h"
+#include <glm\glm.hpp>
 
-class Shader;
+#include "..\..\Renderer\Resources.h"
 
-class AbstractMaterial
+class ColorPalette;
+
+// Texture maps a material can hold. Each one binds to the texture unit of the same number, matching the
+// shaders' textures[] array and the bits of material.activeMaps. Opacity has no slot in the shaders yet
+enum class MaterialMap : uint8_t
 {
-public:
-    std::weak_ptr<Shader> m_Shader;
+    BaseColor,
+    Albedo,
+    Metallic,
+    Roughness,
+    AmbientOcclusion,
+    Normal,
+    Height,
+    Emission,
+    Opacity,
+    Count
 };
 
-class MaterialComponent final : public AbstractMaterial
+// Shading inputs shared by every entity drawn with them, stored in g_Resources->Materials
+struct Material
 {
-public:
-    MaterialComponent() = default;
+    ShaderHandle Shader;
+    std::array<TextureHandle, static_cast<size_t>(MaterialMap::Count)> Maps = {};
+    std::array<TextureReference, static_cast<size_t>(MaterialMap::Count)> Assets = {}; // Held for maps from the asset manager
+    glm::vec4 BaseColorUVTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f); // xy = scale, zw = offset
+    glm::vec4 BaseColor = glm::vec4(1.0f); // The palette color last set by SetBaseColor
+    float Shininess = 1.0f;
+    bool SetShininess = true;
+
+    Material() = default;
+    Material(const ShaderHandle shader, const float shininess)
+        : Shader(shader), Shininess(shininess) {}
 
-    MaterialComponent(const std::vector<std::shared_ptr<Tex2D>>& textures, float shininess);
-    MaterialComponent(std::weak_ptr<Shader> shader, const std::vector<std::shared_ptr<Tex2D>>& textures, float shininess);
-
-public:
-    std::shared_ptr<Tex2D> m_BaseColorMap;
-    std::shared_ptr<Tex2D> m_AlbedoMap;
-    std::shared_ptr<Tex2D> m_MetallicMap;
-    std::shared_ptr<Tex2D> m_RoughnessMap;
-    std::shared_ptr<Tex2D> m_AmbientOcclusionMap;
-    std::shared_ptr<Tex2D> m_NormalMap;
-    std::shared_ptr<Tex2D> m_HeightMap;
-    std::shared_ptr<Tex2D> m_OpacityMap;
-    std::shared_ptr<Tex2D> m_EmissionMap;
-    float m_Shininess = 1.0f;
-    bool m_SetShininess = true;
+    void SetMap(const MaterialMap map, const TextureHandle texture)
+        { Maps[static_cast<size_t>(map)] = texture; Assets[static_cast<size_t>(map)].reset(); }
+    // Uses a texture of the asset manager, which stays resident as long as the material holds it
+    void SetMap(MaterialMap map, TextureReference texture);
+    TextureHandle GetMap(const MaterialMap map) const { return Maps[static_cast<size_t>(map)]; }
+
+    // Uses a solid color from the shared palette as the base color map instead of a dedicated texture
+    void SetBaseColor(ColorPalette& palette, glm::vec4 color);
+
+    // The map a texture tag such as "BaseColor" or "Normal" refers to, or MaterialMap::Count for unknown tags
+    static MaterialMap MapFromTag(const std::string& tag);
 };
 
-class CubeMapMaterialComponent final : public AbstractMaterial
+struct MaterialComponent
 {
-public:
-    CubeMapMaterialComponent() = default;
-    CubeMapMaterialComponent(std::shared_ptr<TexCube> texture)
-        : m_Texture(std::move(texture)) {}
+    MaterialHandle Material;
 
-    CubeMapMaterialComponent(std::weak_ptr<Shader> shader, std::shared_ptr<TexCube> texture)
-        : m_Texture(std::move(texture)) { m_Shader = std::move(shader); }
+    MaterialComponent() = default;
+    explicit MaterialComponent(const MaterialHandle material)
+        : Material(material) {}
+};
 
-public:
-    std::shared_ptr<TexCube> m_Texture;
+struct CubeMapMaterialComponent
+{
+    ShaderHandle Shader;
+    TextureHandle Texture;
+
+    CubeMapMaterialComponent() = default;
+    CubeMapMaterialComponent(const ShaderHandle shader, const TextureHandle texture)
+        : Shader(shader), Texture(texture) {}
 };
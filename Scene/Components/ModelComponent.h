@@ -1,16 +1,24 @@
 ﻿#pragma once
 
+#include <cstdint>
+#include <memory>
+#include <string>
+
 class Model;
 
 struct ModelComponent
 {
 	std::weak_ptr<Model> ParentModel;
+	std::shared_ptr<const std::string> SourcePath; // The model's asset, shared by all of its meshes
+	uint32_t MeshIndex = 0; // Into the model's cooked meshes
 
 	ModelComponent() = default;
 	explicit ModelComponent(const std::shared_ptr<Model>& model)
 		: ParentModel(std::weak_ptr<Model>(model)) {}
-	explicit ModelComponent(Model* model)
-		: ParentModel(std::weak_ptr<Model>(std::shared_ptr<Model>(model))) {}
-	ModelComponent(ModelComponent&) = default;
+	explicit ModelComponent(std::weak_ptr<Model> model)
+		: ParentModel(std::move(model)) {}
+	ModelComponent(std::weak_ptr<Model> model, std::shared_ptr<const std::string> sourcePath, const uint32_t meshIndex)
+		: ParentModel(std::move(model)), SourcePath(std::move(sourcePath)), MeshIndex(meshIndex) {}
+	ModelComponent(const ModelComponent&) = default;
 	~ModelComponent() = default;
 };
\ No newline at end of file
@@ -1,10 +1,13 @@
 #include "CubeComponent.h"
 
+#include "..\..\TangentGenerator.h"
+
 CubeComponent::CubeComponent()
 {
 	constexpr unsigned int vertexCount = 24, indexCount = 36;
 	VAO.IndexCount = indexCount;
-	auto connectivityData = std::vector<Vertex>(vertexCount);
+	auto connectivityData = std::vector<Vertex>();
+	connectivityData.reserve(vertexCount);
 	auto indices = std::vector<unsigned int>(indexCount);
 
 	indices = {
@@ -63,6 +66,7 @@ CubeComponent::CubeComponent()
 	connectivityData.emplace_back(glm::vec4(0.5f, -0.5f, 0.5f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(1.0f, 1.0f));
 	connectivityData.emplace_back(glm::vec4(0.5f, -0.5f, -0.5f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(1.0f, 0.0f));
 
+	TangentGenerator::Generate(connectivityData, indices);
 	SetVAO(connectivityData, indices);
 	SetNVAO(connectivityData);
 }
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include <atomic>
+#include <memory>
+
+#include "Renderable.h"
+#include "StaticBatchComponent.h"
+
+/* Everything a draw needs from an entity's mesh, copied out of its Cube, Plane, TriangleMesh, SharedMesh or StaticBatch.
+* The scene adds one when an entity gains its RenderableTag and removes it with the tag or the mesh. Draws walk
+* an owning group of this, the material and the world transform, so all three are packed in the same order and
+* the render loop is a linear scan with no per-entity lookups.
+*/
+struct MeshRendererComponent
+{
+	GLuint VAO = 0;
+	uint32_t IndexCount = 0;
+	glm::vec3 BoundsMin = glm::vec3(0.0f), BoundsMax = glm::vec3(0.0f); // Local space
+	// Shared with the mesh, so residency and the index offset stay current across uploads and defragmentation
+	std::shared_ptr<std::atomic<int>> PendingUploads;
+	std::shared_ptr<BufferAllocation> Indices;
+	std::shared_ptr<const std::vector<StaticBatchRange>> Ranges; // The merged meshes of a static batch, null for any other mesh
+
+	MeshRendererComponent() = default;
+	explicit MeshRendererComponent(const Renderable& mesh)
+		: VAO(mesh.VAO), IndexCount(mesh.VAO.IndexCount), BoundsMin(mesh.BoundsMin), BoundsMax(mesh.BoundsMax),
+		PendingUploads(mesh.VAO.PendingUploads), Indices(mesh.VAO.Indices) {}
+
+	GLintptr GetIndexOffset() const { return Indices ? Indices->GetOffset() : 0; }
+	bool IsResident() const { return *PendingUploads == 0; }
+};
@@ -1,39 +1,77 @@
 #include "Renderable.h"
 
+#include <algorithm>
+#include <cassert>
+
 #include <glad\glad.h>
 
-void Renderable::SetVAO(const std::vector<Vertex>& connectivityData, const std::vector<uint32_t>& indices)
+#include "..\..\..\utils.h"
+#include "..\..\..\Renderer\UploadManager.h"
+
+void Renderable::SetVAO(const Vertex* vertices, const size_t vertexCount, const uint32_t* indices, const size_t indexCount)
 {
-	VAO.IndexCount = static_cast<uint32_t>(indices.size());
-	// Bind VAO first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-	glBindVertexArray(VAO);
+	VAO.IndexCount = static_cast<uint32_t>(indexCount);
+	const auto vertexBytes = static_cast<GLsizeiptr>(vertexCount * sizeof(Vertex));
+	const auto indexBytes = static_cast<GLsizeiptr>(indexCount * sizeof(unsigned int));
+
+	BoundsMin = BoundsMax = vertexCount ? glm::vec3(vertices[0].Position) : glm::vec3(0.0f);
+	for (size_t i = 1; i < vertexCount; i++)
+	{
+		BoundsMin = glm::min(BoundsMin, glm::vec3(vertices[i].Position));
+		BoundsMax = glm::max(BoundsMax, glm::vec3(vertices[i].Position));
+	}
+
+	// Carve the buffers out of the shared pools, releasing whatever this renderable held before
+	assert(g_VertexPool && g_IndexPool);
+	auto vertexAllocation = g_VertexPool->Allocate(vertexBytes);
+	auto indexAllocation = g_IndexPool->Allocate(indexBytes);
+	if (!vertexAllocation || !indexAllocation)
+	{
+		// Left without triangles, so it is never drawn
+		LogError("RENDERABLE: No room for a mesh of " + std::to_string(vertexCount) + " vertices");
+		IndexedVAO::Release(VAO.Vertices);
+		IndexedVAO::Release(VAO.Indices);
+		VAO.IndexCount = 0;
+		return;
+	}
+	VAO.SetVertexBuffer(std::move(vertexAllocation), sizeof(Vertex));
+	VAO.SetIndexBuffer(std::move(indexAllocation));
+
+	// Describe the vertex layout without touching the current bindings
 
-	unsigned int VBO = 0;
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, static_cast<long long>(connectivityData.size() * sizeof(Vertex)), connectivityData.data(), GL_STATIC_DRAW);
+	glVertexArrayAttribFormat(VAO, 0, 4, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
+	glVertexArrayAttribBinding(VAO, 0, 0);
+	glEnableVertexArrayAttrib(VAO, 0);
 
-	unsigned int EBO = 0;
-	glGenBuffers(1, &EBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<long long>(indices.size() * sizeof(unsigned int)), indices.data(), GL_STATIC_DRAW);
+	glVertexArrayAttribFormat(VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
+	glVertexArrayAttribBinding(VAO, 1, 0);
+	glEnableVertexArrayAttrib(VAO, 1);
 
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, Position))); // NOLINT(performance-no-int-to-ptr)
-	glEnableVertexAttribArray(0);
+	glVertexArrayAttribFormat(VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoord));
+	glVertexArrayAttribBinding(VAO, 2, 0);
+	glEnableVertexArrayAttrib(VAO, 2);
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, Normal))); // NOLINT(performance-no-int-to-ptr)
-	glEnableVertexAttribArray(1);
+	glVertexArrayAttribFormat(VAO, 3, 4, GL_SHORT, GL_TRUE, offsetof(Vertex, TangentFrame));
+	glVertexArrayAttribBinding(VAO, 3, 0);
+	glEnableVertexArrayAttrib(VAO, 3);
 
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, TexCoord))); // NOLINT(performance-no-int-to-ptr)
-	glEnableVertexAttribArray(2);
+	// The contents arrive through the staging ring, draws are skipped until both copies have landed
+	const auto pendingUploads = VAO.PendingUploads;
+	*pendingUploads += 2;
+	const auto onComplete = [pendingUploads] { --*pendingUploads; };
+	StageBufferUpload(VAO.Vertices->GetBuffer(), VAO.Vertices->GetOffset(), vertexBytes, vertices, onComplete);
+	StageBufferUpload(VAO.Indices->GetBuffer(), VAO.Indices->GetOffset(), indexBytes, indices, onComplete);
 }
 
-void Object3D::SetNVAO(const std::vector<Vertex>& connectivityData)
+void Object3D::SetNVAO(const Vertex* vertices, const size_t vertexCount)
 {
 	std::vector<float> normalData;
+	normalData.reserve(vertexCount * 6);
 
-	for (const auto& vertex : connectivityData)
+	for (size_t i = 0; i < vertexCount; i++)
 	{
+		const Vertex& vertex = vertices[i];
+
 		normalData.emplace_back(vertex.Position.x);
 		normalData.emplace_back(vertex.Position.y);
 		normalData.emplace_back(vertex.Position.z);
@@ -43,17 +81,22 @@ void Object3D::SetNVAO(const std::vector<Vertex>& connectivityData)
 		normalData.emplace_back(vertex.Position.z + vertex.Normal.z * 0.5f);
 	}
 
-	glBindVertexArray(NormalVAO);
-
-	unsigned int NVBO = 0;
-	glGenBuffers(1, &NVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, NVBO);
-	glBufferData(GL_ARRAY_BUFFER, static_cast<long long>(normalData.size() * sizeof(float)), normalData.data(), GL_STATIC_DRAW);
+	const auto normalBytes = static_cast<GLsizeiptr>(normalData.size() * sizeof(float));
+	assert(g_VertexPool);
+	auto allocation = g_VertexPool->Allocate(normalBytes);
+	if (!allocation)
+	{
+		LogError("RENDERABLE: No room for the normals of " + std::to_string(vertexCount) + " vertices");
+		IndexedVAO::Release(NormalVAO.Vertices);
+		return;
+	}
+	NormalVAO.SetVertexBuffer(std::move(allocation), 3 * sizeof(float));
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), static_cast<void*>(nullptr));
-	glEnableVertexAttribArray(0);
+	glVertexArrayAttribFormat(NormalVAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(NormalVAO, 0, 0);
+	glEnableVertexArrayAttrib(NormalVAO, 0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	const auto pendingUploads = NormalVAO.PendingUploads;
+	++*pendingUploads;
+	StageBufferUpload(NormalVAO.Vertices->GetBuffer(), NormalVAO.Vertices->GetOffset(), normalBytes, normalData.data(), [pendingUploads] { --*pendingUploads; });
 }
-
@@ -10,8 +10,12 @@ struct RenderableTag {};
 struct Renderable
 {
 	IndexedVAO VAO = IndexedVAO();
+	glm::vec3 BoundsMin = glm::vec3(0.0f), BoundsMax = glm::vec3(0.0f); // Local space box around the vertices
 
-	void SetVAO(const std::vector<Vertex>& connectivityData, const std::vector<uint32_t>& indices);
+	void SetVAO(const std::vector<Vertex>& connectivityData, const std::vector<uint32_t>& indices)
+		{ SetVAO(connectivityData.data(), connectivityData.size(), indices.data(), indices.size()); }
+	// Uploads vertex and index data straight from the given memory, e.g. a mapped file
+	void SetVAO(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
 
 	operator uint32_t& () { return VAO; }
 	operator const uint32_t& () const { return VAO; }
@@ -21,5 +25,7 @@ struct Object3D : Renderable
 {
 	IndexedVAO NormalVAO = IndexedVAO();
 
-	void SetNVAO(const std::vector<Vertex>& connectivityData);
+	void SetNVAO(const std::vector<Vertex>& connectivityData)
+		{ SetNVAO(connectivityData.data(), connectivityData.size()); }
+	void SetNVAO(const Vertex* vertices, size_t vertexCount);
 };
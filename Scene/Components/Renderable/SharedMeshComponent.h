@@ -0,0 +1,16 @@
+#pragma once
+
+#include <memory>
+
+#include "TriangleMeshComponent.h"
+
+// A triangle mesh many entities draw, such as every instance of a prefab. The mesh and its GL objects stay alive
+// as long as any entity or prefab still refers to them
+struct SharedMeshComponent
+{
+	std::shared_ptr<const TriangleMeshComponent> Mesh;
+
+	SharedMeshComponent() = default;
+	explicit SharedMeshComponent(std::shared_ptr<const TriangleMeshComponent> mesh)
+		: Mesh(std::move(mesh)) {}
+};
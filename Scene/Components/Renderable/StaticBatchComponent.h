@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "entt\include\entt.hpp"
+#include "..\..\..\Renderer\Bounds.h"
+#include "Renderable.h"
+
+// The triangles one merged mesh contributes to a static batch
+struct StaticBatchRange
+{
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	Bounds LocalBounds; // Around the range's vertices, in the batch's space
+};
+
+// Static meshes sharing a material, merged into one vertex and index range that draws in a single call.
+// Each merged mesh keeps its range and bounds, so passes that cull can still skip the parts they don't need
+struct StaticBatchComponent : Renderable
+{
+	std::shared_ptr<const std::vector<StaticBatchRange>> Ranges; // Shared with the render proxy
+};
+
+// An entity whose mesh now draws as part of a static batch. It keeps its model and material, so saving the scene
+// writes it as the mesh it was
+struct StaticBatchMemberComponent
+{
+	entt::entity Batch = entt::null;
+	uint32_t Range = 0; // Into the batch's ranges
+
+	StaticBatchMemberComponent() = default;
+	StaticBatchMemberComponent(const entt::entity batch, const uint32_t range)
+		: Batch(batch), Range(range) {}
+};
@@ -5,3 +5,9 @@ TriangleMeshComponent::TriangleMeshComponent(const std::vector<Vertex>& connecti
 	SetVAO(connectivityData, indices);
 	SetNVAO(connectivityData);
 }
+
+TriangleMeshComponent::TriangleMeshComponent(const Vertex* vertices, const size_t vertexCount, const uint32_t* indices, const size_t indexCount)
+{
+	SetVAO(vertices, vertexCount, indices, indexCount);
+	SetNVAO(vertices, vertexCount);
+}
@@ -9,4 +9,5 @@
 struct TriangleMeshComponent : Object3D
 {
 	TriangleMeshComponent(const std::vector<Vertex>& connectivityData, const std::vector<unsigned int>& indices);
+	TriangleMeshComponent(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
 };
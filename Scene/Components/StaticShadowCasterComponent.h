@@ -0,0 +1,11 @@
+#pragma once
+
+#include "..\..\Renderer\Bounds.h"
+
+// Marks an entity's mesh as static geometry, which the distant shadow cascades cache instead of redrawing every frame.
+// Remembers the world bounds last handed to the renderer, so moving or removing the mesh can invalidate what it covered
+struct StaticShadowCasterComponent
+{
+	Bounds Published;
+	bool IsPublished = false;
+};
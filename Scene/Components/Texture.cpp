@@ -1,114 +1,134 @@
 #include "Texture.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include <stb_image\stb_image.h>
 
-Tex2D::Tex2D(const glm::vec4 color, std::string tag)
-	: m_Tag(std::move(tag))
+#include "..\..\Renderer\UploadManager.h"
+
+namespace
 {
-	// load and create a texture 
-	// -------------------------
-	glBindTexture(GL_TEXTURE_2D, m_ID);
+	// Number of levels in a full mip chain down to 1x1
+	GLsizei MipLevels(const GLsizei width, const GLsizei height)
+	{
+		GLsizei levels = 1;
+		for (GLsizei size = std::max(width, height); size > 1; size /= 2)
+			levels++;
+		return levels;
+	}
 
-	// set the texture wrapping parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	GLenum FormatFromChannels(const int channels)
+	{
+		return channels == 1 ? GL_RED : (channels == 4 ? GL_RGBA : GL_RGB);
+	}
+}
 
-	// set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+ImageData ImageData::Load(const std::string& filepath, const bool flipVertically)
+{
+	ImageData image;
 
-	const auto data = new unsigned char[4 * sizeof(unsigned char)];
-	data[0] = static_cast<unsigned char>(color.r * 255.0f);
-	data[1] = static_cast<unsigned char>(color.g * 255.0f);
-	data[2] = static_cast<unsigned char>(color.b * 255.0f);
-	data[3] = static_cast<unsigned char>(color.a * 255.0f);
+	// the flip flag is thread local, so concurrent loads don't race on it
+	stbi_set_flip_vertically_on_load_thread(flipVertically);
+	unsigned char* data = stbi_load(filepath.c_str(), &image.Width, &image.Height, &image.Channels, 0);
+	if (data)
+		image.Pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	delete[] data;
+	return image;
+}
+
+Tex2D::Tex2D(const glm::vec4 color, std::string tag)
+	: Texture(GL_TEXTURE_2D), m_Tag(std::move(tag))
+{
+	// create a 1x1 texture of the given color
+	// ---------------------------------------
+	// set the texture wrapping parameters
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	// set texture filtering parameters
+	glTextureParameteri(m_ID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_ID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	const unsigned char data[4] = {
+		static_cast<unsigned char>(color.r * 255.0f),
+		static_cast<unsigned char>(color.g * 255.0f),
+		static_cast<unsigned char>(color.b * 255.0f),
+		static_cast<unsigned char>(color.a * 255.0f)
+	};
+
+	glTextureStorage2D(m_ID, 1, GL_RGBA8, 1, 1);
+	StageTextureUpload(m_ID, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
 }
 
 Tex2D::Tex2D(const std::string& filepath, std::string tag)
-	: m_Tag(std::move(tag)), m_Path(filepath)
-{
-	// load and create a texture 
-	// -------------------------
-	glBindTexture(GL_TEXTURE_2D, m_ID);
+	: Tex2D(ImageData::Load(filepath), filepath, std::move(tag)) {}
 
+Tex2D::Tex2D(const ImageData& image, std::string filepath, std::string tag)
+	: Texture(GL_TEXTURE_2D), m_Tag(std::move(tag)), m_Path(std::move(filepath))
+{
+	// create a texture from the decoded image
+	// ---------------------------------------
 	// set the texture wrapping parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
 	// set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// load image, create texture and generate mipmaps
-	int width, height, channelsN;
+	glTextureParameteri(m_ID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_ID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char* data = stbi_load(filepath.c_str(), &width, &height, &channelsN, 0);
-	if (data)
+	if (image)
 	{
-		const GLint format = channelsN == 1 ? GL_RED : (channelsN == 4 ? GL_RGBA : GL_RGB);
-
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		// allocate the whole mip chain now, the pixels and mipmaps follow through the staging ring
+		glTextureStorage2D(m_ID, MipLevels(image.Width, image.Height), GL_RGBA8, image.Width, image.Height);
+		StageTextureUpload(m_ID, 0, 0, 0, image.Width, image.Height, FormatFromChannels(image.Channels), GL_UNSIGNED_BYTE, image.Pixels.get(), true);
 	}
 	else
 	{
 		std::cout << "Failed to load texture" << std::endl;
 	}
-
-	stbi_image_free(data);
-	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Tex2D::SetWrap(const GLint sWrap, const GLint tWrap) {
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sWrap);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, tWrap);
+Tex2D::Tex2D(const GLsizei width, const GLsizei height, std::string tag)
+	: Texture(GL_TEXTURE_2D), m_Tag(std::move(tag))
+{
+	// allocate an empty RGBA texture to be filled in later
+	// ----------------------------------------------------
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	glTextureParameteri(m_ID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_ID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glTextureStorage2D(m_ID, 1, GL_RGBA8, width, height);
 }
 
-void Tex2D::Use(const int index) const
-{
-	glActiveTexture(GL_TEXTURE0 + index);
-	glBindTexture(GL_TEXTURE_2D, m_ID);
+void Tex2D::SetWrap(const GLint sWrap, const GLint tWrap) const {
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_S, sWrap);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_T, tWrap);
 }
 
 TexCube::TexCube(const std::string& filepath)
+	: Texture(GL_TEXTURE_CUBE_MAP)
 {
 	m_Paths.emplace_back(filepath);
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_ID);
-
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_ID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(m_ID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	int width, height, channelsN;
 	unsigned char* data = stbi_load(filepath.c_str(), &width, &height, &channelsN, 0);
 	if (data)
 	{
-		const GLint format = channelsN == 1 ? GL_RED : (channelsN == 4 ? GL_RGBA : GL_RGB);
-
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGBA, width, height, 0,
-			format, GL_UNSIGNED_BYTE, data);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGBA, width, height, 0,
-			format, GL_UNSIGNED_BYTE, data);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGBA, width, height, 0,
-			format, GL_UNSIGNED_BYTE, data);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGBA, width, height, 0,
-			format, GL_UNSIGNED_BYTE, data);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGBA, width, height, 0,
-			format, GL_UNSIGNED_BYTE, data);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGBA, width, height, 0,
-			format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+		glTextureStorage2D(m_ID, MipLevels(width, height), GL_RGBA8, width, height);
+
+		// cube map faces are layers 0-5 of the texture: +X, -X, +Y, -Y, +Z, -Z
+		for (GLint face = 0; face < 6; face++)
+			glTextureSubImage3D(m_ID, 0, 0, 0, face, width, height, 1, FormatFromChannels(channelsN), GL_UNSIGNED_BYTE, data);
+		glGenerateTextureMipmap(m_ID);
 	}
 	else
 	{
@@ -116,106 +136,74 @@ TexCube::TexCube(const std::string& filepath)
 	}
 
 	stbi_image_free(data);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 }
 
 TexCube::TexCube(const std::vector<std::string>& filepaths)
-	: m_Paths(filepaths)
+	: Texture(GL_TEXTURE_CUBE_MAP), m_Paths(filepaths)
 {
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_ID);
-
+	bool allocated = false;
 	int width, height, channelsN;
 	for (unsigned int i = 0; i < 6; i++)
 	{
 		unsigned char* data = stbi_load(filepaths[i].c_str(), &width, &height, &channelsN, 0);
 		if (data)
-			glTexImage2D(
-				GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-				0,
-				GL_RGBA,
-				width,
-				height,
-				0,
-				channelsN == 1 ? GL_RED : (channelsN == 4 ? GL_RGBA : GL_RGB),
-				GL_UNSIGNED_BYTE,
-				data
-			);
+		{
+			// immutable storage is sized from the first face that loads
+			if (!allocated)
+				glTextureStorage2D(m_ID, MipLevels(width, height), GL_RGBA8, width, height);
+			allocated = true;
+
+			glTextureSubImage3D(m_ID, 0, 0, 0, static_cast<GLint>(i), width, height, 1,
+				FormatFromChannels(channelsN), GL_UNSIGNED_BYTE, data);
+		}
 		else
 			std::cout << "Failed to load cube map texture" << std::endl;
 
 		stbi_image_free(data);
 	}
 
-	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (allocated)
+		glGenerateTextureMipmap(m_ID);
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_ID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(m_ID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
 TexCube::TexCube(const glm::vec4 color)
+	: Texture(GL_TEXTURE_CUBE_MAP)
 {
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_ID);
-
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	const auto data = new unsigned char[4 * sizeof(unsigned char)];
-	data[0] = static_cast<unsigned char>(color.r * 255.0f);
-	data[1] = static_cast<unsigned char>(color.g * 255.0f);
-	data[2] = static_cast<unsigned char>(color.b * 255.0f);
-	data[3] = static_cast<unsigned char>(color.a * 255.0f);
-
-	constexpr GLint format = GL_RGBA;
-
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGBA, 1, 1, 0,
-		format, GL_UNSIGNED_BYTE, data);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGBA, 1, 1, 0,
-		format, GL_UNSIGNED_BYTE, data);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGBA, 1, 1, 0,
-		format, GL_UNSIGNED_BYTE, data);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGBA, 1, 1, 0,
-		format, GL_UNSIGNED_BYTE, data);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGBA, 1, 1, 0,
-		format, GL_UNSIGNED_BYTE, data);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGBA, 1, 1, 0,
-		format, GL_UNSIGNED_BYTE, data);
-
-	delete[] data;
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-}
-
-void TexCube::SetWrap(const GLint sWrap, const GLint tWrap, const GLint rWrap) {
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, sWrap);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, tWrap);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, rWrap);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_ID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_ID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	const unsigned char data[4] = {
+		static_cast<unsigned char>(color.r * 255.0f),
+		static_cast<unsigned char>(color.g * 255.0f),
+		static_cast<unsigned char>(color.b * 255.0f),
+		static_cast<unsigned char>(color.a * 255.0f)
+	};
+
+	glTextureStorage2D(m_ID, 1, GL_RGBA8, 1, 1);
+	for (GLint face = 0; face < 6; face++)
+		glTextureSubImage3D(m_ID, 0, 0, 0, face, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
 }
 
-void TexCube::Use(const int index) const
-{
-	glActiveTexture(GL_TEXTURE0 + index);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_ID);
+void TexCube::SetWrap(const GLint sWrap, const GLint tWrap, const GLint rWrap) const {
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_S, sWrap);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_T, tWrap);
+	glTextureParameteri(m_ID, GL_TEXTURE_WRAP_R, rWrap);
 }
 
 TexColorBuffer::TexColorBuffer(const unsigned int width, const unsigned int height)
+	: Texture(GL_TEXTURE_2D)
 {
-	glBindTexture(GL_TEXTURE_2D, m_ID);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_ID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_ID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-}
-
-void TexColorBuffer::Use(const int index) const
-{
-	glActiveTexture(GL_TEXTURE0 + index);
-	glBindTexture(GL_TEXTURE_2D, m_ID);
+	glTextureStorage2D(m_ID, 1, GL_RGB8, static_cast<GLsizei>(width), static_cast<GLsizei>(height));
 }
@@ -11,14 +11,26 @@
 
 class Shader;
 
+// Decoded pixels of an image file. Decoding touches no GL state, so it can run on any thread
+struct ImageData
+{
+	int Width = 0, Height = 0, Channels = 0;
+	std::shared_ptr<unsigned char> Pixels;
+
+	static ImageData Load(const std::string& filepath, bool flipVertically = true);
+	explicit operator bool() const { return Pixels != nullptr; }
+};
+
 class Texture
 {
 public:
-	Texture()
-		{ glGenTextures(1, &m_ID); }
+	explicit Texture(const GLenum target)
+		{ glCreateTextures(target, 1, &m_ID); }
 	explicit Texture(const int ID)
 		{ m_ID = ID; }
-	virtual void Use(int index) const = 0;
+	// Binds the texture to a texture unit. Every kind of texture binds the same way, so this needs no virtual dispatch
+	void Use(const int index = 0) const
+		{ glBindTextureUnit(index, m_ID); }
 	bool operator==(const Texture& other) const
 		{ return m_ID == other.m_ID; }
 	operator GLuint& () { return m_ID; }
@@ -35,10 +47,12 @@ class Tex2D final : public Texture
 public:
 	explicit Tex2D(glm::vec4 color, std::string tag = std::string());
 	explicit Tex2D(const std::string& filepath, std::string tag = std::string());
-	static void SetWrap(GLint sWrap, const GLint tWrap);
+	explicit Tex2D(GLsizei width, GLsizei height, std::string tag = std::string());
+	// Uploads an already decoded image
+	explicit Tex2D(const ImageData& image, std::string filepath, std::string tag = std::string());
+	void SetWrap(GLint sWrap, GLint tWrap) const;
 	void SetTag(std::string tag)
 		{ m_Tag = std::move(tag); }
-	void Use(int index = 0) const override;
 
 public:
 	std::string m_Tag = std::string();
@@ -51,8 +65,7 @@ public:
 	explicit TexCube(const std::string& filepath);
 	explicit TexCube(const std::vector<std::string>& filepaths);
 	explicit TexCube(glm::vec4 color);
-	static void SetWrap(GLint sWrap, GLint tWrap, GLint rWrap);
-	void Use(int index = 0) const override;
+	void SetWrap(GLint sWrap, GLint tWrap, GLint rWrap) const;
 
 public:
 	std::vector<std::string> m_Paths = std::vector<std::string>();
@@ -61,7 +74,7 @@ public:
 class TexColorBuffer final : public Texture
 {
 public:
-	explicit TexColorBuffer() = default;
+	explicit TexColorBuffer()
+		: Texture(GL_TEXTURE_2D) {}
 	explicit TexColorBuffer(unsigned int width, unsigned int height);
-	void Use(int index = 0) const override;
 };
@@ -1,13 +1,34 @@
 #include "TransformComponent.h"
 
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtx\quaternion.hpp>
+#include <glm\gtc\quaternion.hpp>
+
+TransformComponent::TransformComponent(const glm::mat4& matrix)
+	: Translation(matrix[3])
+{
+	glm::mat3 rotation(matrix);
+	Scale = glm::vec3(glm::length(rotation[0]), glm::length(rotation[1]), glm::length(rotation[2]));
+
+	// A mirroring matrix keeps a proper rotation by flipping one axis of the scale
+	if (glm::determinant(rotation) < 0.0f)
+		Scale.x = -Scale.x;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (Scale[i] != 0.0f)
+			rotation[i] /= Scale[i];
+	}
+	Rotation = glm::eulerAngles(glm::quat_cast(rotation));
+}
 
 glm::mat4 TransformComponent::GetTransform() const
 {
-	const glm::mat4 rotation = glm::toMat4(glm::quat(Rotation));
+	// Compose T * R * S directly, scaling the rotation's columns rather than multiplying full matrices
+	const glm::mat3 rotation = glm::mat3_cast(glm::quat(Rotation));
 
-	return glm::translate(glm::mat4(1.0f), Translation)
-		* rotation
-		* glm::scale(glm::mat4(1.0f), Scale);
+	return {
+		glm::vec4(rotation[0] * Scale.x, 0.0f),
+		glm::vec4(rotation[1] * Scale.y, 0.0f),
+		glm::vec4(rotation[2] * Scale.z, 0.0f),
+		glm::vec4(Translation, 1.0f)
+	};
 }
@@ -2,6 +2,8 @@
 
 #include <glm\glm.hpp>
 
+// Local translation, Euler rotation and scale relative to the entity's parent.
+// Edit it through Scene::SetTransform, or call Scene::MarkTransformDirty afterwards, so the cached matrices follow
 struct TransformComponent
 {
 	glm::vec3 Translation = { 0.0f, 0.0f, 0.0f };
@@ -10,8 +12,23 @@ struct TransformComponent
 
 	TransformComponent() = default;
 	TransformComponent(const TransformComponent&) = default;
+	TransformComponent& operator=(const TransformComponent&) = default;
 	explicit TransformComponent(const glm::vec3& translation)
 		: Translation(translation) {}
+	// Splits an affine matrix into translation, rotation and scale. Shear has no place to go and is lost
+	explicit TransformComponent(const glm::mat4& matrix);
 
 	glm::mat4 GetTransform() const;
 };
+
+// Matrices derived from the hierarchy, rebuilt by the scene's transform system only when something above them changed
+struct WorldTransformComponent
+{
+	glm::mat4 Local = glm::mat4(1.0f);
+	glm::mat4 World = glm::mat4(1.0f);
+	glm::mat3 LocalNormal = glm::mat3(1.0f); // Inverse transpose of the local matrix's upper 3x3
+	glm::mat3 Normal = glm::mat3(1.0f); // Inverse transpose of the world matrix's upper 3x3
+
+	bool LocalDirty = true; // Local has to be rebuilt from the TransformComponent
+	bool Queued = false; // Already waiting to be updated this frame
+};
@@ -0,0 +1,324 @@
+#include "CookedModel.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+#include "..\utils.h"
+
+namespace
+{
+	constexpr char s_Magic[4] = { 'L', 'O', 'G', 'M' };
+
+	uint64_t AlignUp(const uint64_t value)
+	{
+		return (value + 15) & ~static_cast<uint64_t>(15);
+	}
+
+	// Checks that count elements of T starting at offset lie entirely inside a blob of the given size
+	template<typename T>
+	bool InBounds(const uint64_t offset, const uint64_t count, const size_t size)
+	{
+		return offset <= size && count <= (size - offset) / sizeof(T);
+	}
+}
+
+bool CookedModel::Open(const std::string& path, const uint64_t sourceHash)
+{
+	m_Blob.clear();
+	if (!m_File.Open(path))
+		return false;
+
+	if (!Validate(m_File.GetData(), m_File.GetSize(), sourceHash))
+	{
+		m_File.Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool CookedModel::Load(std::vector<char> blob, const uint64_t sourceHash)
+{
+	m_File.Close();
+	m_Blob = std::move(blob);
+	return Validate(m_Blob.data(), m_Blob.size(), sourceHash);
+}
+
+void CookedModel::Close()
+{
+	m_File.Close();
+	m_Blob = std::vector<char>();
+	m_Data = nullptr;
+	m_Header = nullptr;
+}
+
+std::string CookedModel::GetString(const uint32_t offset, const uint32_t length) const
+{
+	return { m_Data + m_Header->StringOffset + offset, length };
+}
+
+bool CookedModel::Validate(const char* data, const size_t size, const uint64_t sourceHash)
+{
+	m_Data = nullptr;
+	m_Header = nullptr;
+
+	if (size < sizeof(CookedHeader))
+		return false;
+
+	const auto header = reinterpret_cast<const CookedHeader*>(data);
+	if (std::memcmp(header->Magic, s_Magic, sizeof(s_Magic)) != 0
+		|| header->Version != s_Version
+		|| header->SourceHash != sourceHash
+		|| header->VertexStride != sizeof(Vertex))
+		return false;
+
+	if (!InBounds<CookedMesh>(header->MeshOffset, header->MeshCount, size)
+		|| !InBounds<CookedMaterial>(header->MaterialOffset, header->MaterialCount, size)
+		|| !InBounds<CookedTexture>(header->TextureOffset, header->TextureCount, size)
+		|| !InBounds<CookedNode>(header->NodeOffset, header->NodeCount, size)
+		|| !InBounds<uint32_t>(header->NodeMeshOffset, header->NodeMeshCount, size)
+		|| !InBounds<Vertex>(header->VertexOffset, header->VertexCount, size)
+		|| !InBounds<uint32_t>(header->IndexOffset, header->IndexCount, size)
+		|| !InBounds<char>(header->StringOffset, header->StringSize, size))
+	{
+		LogError("COOKED_MODEL: Section out of bounds");
+		return false;
+	}
+
+	const auto meshes = reinterpret_cast<const CookedMesh*>(data + header->MeshOffset);
+	for (uint32_t i = 0; i < header->MeshCount; i++)
+	{
+		// Compared against what is left after the first element, so huge offsets can't wrap the sum around
+		if (meshes[i].FirstVertex > header->VertexCount || meshes[i].VertexCount > header->VertexCount - meshes[i].FirstVertex
+			|| meshes[i].FirstIndex > header->IndexCount || meshes[i].IndexCount > header->IndexCount - meshes[i].FirstIndex)
+		{
+			LogError("COOKED_MODEL: Mesh range out of bounds");
+			return false;
+		}
+	}
+
+	const auto materials = reinterpret_cast<const CookedMaterial*>(data + header->MaterialOffset);
+	for (uint32_t i = 0; i < header->MaterialCount; i++)
+	{
+		if (static_cast<uint64_t>(materials[i].FirstTexture) + materials[i].TextureCount > header->TextureCount)
+		{
+			LogError("COOKED_MODEL: Material range out of bounds");
+			return false;
+		}
+	}
+
+	const auto stringInBounds = [header](const uint32_t offset, const uint32_t length)
+		{ return static_cast<uint64_t>(offset) + length <= header->StringSize; };
+	const auto textures = reinterpret_cast<const CookedTexture*>(data + header->TextureOffset);
+	for (uint32_t i = 0; i < header->TextureCount; i++)
+	{
+		if (!stringInBounds(textures[i].TypeOffset, textures[i].TypeLength) || !stringInBounds(textures[i].FileOffset, textures[i].FileLength))
+		{
+			LogError("COOKED_MODEL: Texture string out of bounds");
+			return false;
+		}
+	}
+
+	const auto nodes = reinterpret_cast<const CookedNode*>(data + header->NodeOffset);
+	for (uint32_t i = 0; i < header->NodeCount; i++)
+	{
+		if (static_cast<uint64_t>(nodes[i].FirstMesh) + nodes[i].MeshCount > header->NodeMeshCount)
+		{
+			LogError("COOKED_MODEL: Node range out of bounds");
+			return false;
+		}
+	}
+
+	m_Data = data;
+	m_Header = header;
+	return true;
+}
+
+std::vector<char> CookedModel::Serialize(const ModelData& model, const uint64_t sourceHash)
+{
+	CookedHeader header{};
+	std::memcpy(header.Magic, s_Magic, sizeof(s_Magic));
+	header.Version = s_Version;
+	header.SourceHash = sourceHash;
+	header.VertexStride = sizeof(Vertex);
+	header.MeshCount = static_cast<uint32_t>(model.Meshes.size());
+	header.MaterialCount = static_cast<uint32_t>(model.Materials.size());
+	header.NodeCount = static_cast<uint32_t>(model.Nodes.size());
+
+	// Flatten the variable length lists
+	std::vector<CookedMesh> meshes;
+	meshes.reserve(model.Meshes.size());
+	for (const auto& mesh : model.Meshes)
+	{
+		CookedMesh cooked{};
+		cooked.FirstVertex = header.VertexCount;
+		cooked.FirstIndex = header.IndexCount;
+		cooked.VertexCount = static_cast<uint32_t>(mesh.Vertices.size());
+		cooked.IndexCount = static_cast<uint32_t>(mesh.Indices.size());
+		cooked.BoundsMin = mesh.BoundsMin;
+		cooked.BoundsMax = mesh.BoundsMax;
+		cooked.MaterialIndex = mesh.MaterialIndex;
+		meshes.emplace_back(cooked);
+
+		header.VertexCount += mesh.Vertices.size();
+		header.IndexCount += mesh.Indices.size();
+	}
+
+	std::string strings;
+	const auto addString = [&strings](const std::string& string, uint32_t& offset, uint32_t& length)
+	{
+		offset = static_cast<uint32_t>(strings.size());
+		length = static_cast<uint32_t>(string.size());
+		strings += string;
+	};
+
+	std::vector<CookedMaterial> materials;
+	std::vector<CookedTexture> textures;
+	materials.reserve(model.Materials.size());
+	for (const auto& material : model.Materials)
+	{
+		materials.push_back({ static_cast<uint32_t>(textures.size()), static_cast<uint32_t>(material.Textures.size()) });
+		for (const auto& [type, file] : material.Textures)
+		{
+			CookedTexture texture{};
+			addString(type, texture.TypeOffset, texture.TypeLength);
+			addString(file, texture.FileOffset, texture.FileLength);
+			textures.emplace_back(texture);
+		}
+	}
+	header.TextureCount = static_cast<uint32_t>(textures.size());
+	header.StringSize = strings.size();
+
+	std::vector<CookedNode> nodes;
+	std::vector<uint32_t> nodeMeshes;
+	nodes.reserve(model.Nodes.size());
+	for (const auto& node : model.Nodes)
+	{
+		nodes.push_back({ node.Transform, node.Parent, static_cast<uint32_t>(nodeMeshes.size()), static_cast<uint32_t>(node.Meshes.size()) });
+		nodeMeshes.insert(nodeMeshes.end(), node.Meshes.begin(), node.Meshes.end());
+	}
+	header.NodeMeshCount = static_cast<uint32_t>(nodeMeshes.size());
+
+	// Lay out the sections
+	uint64_t size = AlignUp(sizeof(CookedHeader));
+	const auto reserveSection = [&size](uint64_t& offset, const uint64_t bytes)
+	{
+		offset = size;
+		size = AlignUp(size + bytes);
+	};
+	reserveSection(header.MeshOffset, meshes.size() * sizeof(CookedMesh));
+	reserveSection(header.MaterialOffset, materials.size() * sizeof(CookedMaterial));
+	reserveSection(header.TextureOffset, textures.size() * sizeof(CookedTexture));
+	reserveSection(header.NodeOffset, nodes.size() * sizeof(CookedNode));
+	reserveSection(header.NodeMeshOffset, nodeMeshes.size() * sizeof(uint32_t));
+	reserveSection(header.VertexOffset, header.VertexCount * sizeof(Vertex));
+	reserveSection(header.IndexOffset, header.IndexCount * sizeof(uint32_t));
+	reserveSection(header.StringOffset, strings.size());
+
+	auto blob = std::vector<char>(size);
+	const auto copy = [&blob](const uint64_t offset, const void* data, const size_t bytes)
+	{
+		if (bytes)
+			std::memcpy(blob.data() + offset, data, bytes);
+	};
+
+	copy(0, &header, sizeof(header));
+	copy(header.MeshOffset, meshes.data(), meshes.size() * sizeof(CookedMesh));
+	copy(header.MaterialOffset, materials.data(), materials.size() * sizeof(CookedMaterial));
+	copy(header.TextureOffset, textures.data(), textures.size() * sizeof(CookedTexture));
+	copy(header.NodeOffset, nodes.data(), nodes.size() * sizeof(CookedNode));
+	copy(header.NodeMeshOffset, nodeMeshes.data(), nodeMeshes.size() * sizeof(uint32_t));
+	copy(header.StringOffset, strings.data(), strings.size());
+
+	for (size_t i = 0; i < model.Meshes.size(); i++)
+	{
+		const auto& mesh = model.Meshes[i];
+		copy(header.VertexOffset + meshes[i].FirstVertex * sizeof(Vertex), mesh.Vertices.data(), mesh.Vertices.size() * sizeof(Vertex));
+		copy(header.IndexOffset + meshes[i].FirstIndex * sizeof(uint32_t), mesh.Indices.data(), mesh.Indices.size() * sizeof(uint32_t));
+	}
+
+	return blob;
+}
+
+bool CookedModel::Write(const std::string& path, const ModelData& model, const uint64_t sourceHash)
+{
+	const auto blob = Serialize(model, sourceHash);
+
+	std::ofstream fileStream(path, std::ios::binary | std::ios::trunc);
+	if (!fileStream)
+	{
+		LogError("COOKED_MODEL: Could not open " + path + " for writing");
+		return false;
+	}
+
+	fileStream.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+	return static_cast<bool>(fileStream);
+}
+
+uint64_t CookedModel::HashFile(const std::string& path)
+{
+	MappedFile file;
+	if (!file.Open(path))
+		return 0;
+
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < file.GetSize(); i++)
+	{
+		hash ^= static_cast<unsigned char>(file.GetData()[i]);
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+uint64_t CookedModel::HashSource(const std::string& path)
+{
+	uint64_t hash = HashFile(path);
+	if (hash == 0)
+		return 0;
+
+	std::string extension = path.substr(std::min(path.find_last_of('.'), path.size()));
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	if (extension != ".obj")
+		return hash;
+
+	// Material and texture bindings come from the material libraries, which sit next to the model
+	MappedFile file;
+	if (!file.Open(path))
+		return 0;
+
+	const std::string directory = path.substr(0, path.find_last_of("\\/") + 1);
+	const char* data = file.GetData();
+	const size_t size = file.GetSize();
+	for (size_t line = 0; line < size;)
+	{
+		const size_t end = std::find(data + line, data + size, '\n') - data;
+		constexpr char keyword[] = "mtllib";
+		constexpr size_t keywordLength = sizeof(keyword) - 1;
+		if (end - line > keywordLength && std::memcmp(data + line, keyword, keywordLength) == 0 && std::isspace(static_cast<unsigned char>(data[line + keywordLength])))
+		{
+			// A library may list several files, separated by spaces
+			size_t name = line + keywordLength;
+			while (name < end)
+			{
+				while (name < end && std::isspace(static_cast<unsigned char>(data[name])))
+					name++;
+				size_t nameEnd = name;
+				while (nameEnd < end && !std::isspace(static_cast<unsigned char>(data[nameEnd])))
+					nameEnd++;
+				if (nameEnd > name)
+				{
+					// A missing library hashes as 0, so adding it later still changes the hash
+					hash ^= HashFile(directory + std::string(data + name, nameEnd - name));
+					hash *= 1099511628211ull;
+				}
+				name = nameEnd;
+			}
+		}
+		line = end + 1;
+	}
+
+	return hash;
+}
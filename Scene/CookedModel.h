@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include "MappedFile.h"
+#include "ModelData.h"
+#include "Vertex.h"
+
+/* Cooked model format
+* A single little-endian file holding GPU-ready vertex and index blobs, mesh bounds,
+* material texture bindings and the node hierarchy of an imported model.
+* Every section starts on a 16 byte boundary so it can be used in place once the file is mapped.
+*/
+
+struct CookedHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	uint64_t SourceHash;
+	uint32_t VertexStride;
+	uint32_t MeshCount, MaterialCount, TextureCount, NodeCount, NodeMeshCount;
+	uint64_t MeshOffset, MaterialOffset, TextureOffset, NodeOffset, NodeMeshOffset;
+	uint64_t VertexOffset, VertexCount;
+	uint64_t IndexOffset, IndexCount;
+	uint64_t StringOffset, StringSize;
+};
+
+struct CookedMesh
+{
+	uint64_t FirstVertex;
+	uint64_t FirstIndex;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	glm::vec3 BoundsMin;
+	glm::vec3 BoundsMax;
+	uint32_t MaterialIndex;
+};
+
+struct CookedMaterial
+{
+	uint32_t FirstTexture;
+	uint32_t TextureCount;
+};
+
+struct CookedTexture
+{
+	uint32_t TypeOffset, TypeLength; // Into the string blob
+	uint32_t FileOffset, FileLength; // Into the string blob
+};
+
+struct CookedNode
+{
+	glm::mat4 Transform;
+	int32_t Parent;
+	uint32_t FirstMesh; // Into the node mesh list
+	uint32_t MeshCount;
+};
+
+class CookedModel
+{
+public:
+	CookedModel() = default;
+	CookedModel(const CookedModel&) = delete;
+	CookedModel& operator=(const CookedModel&) = delete;
+
+	// Maps a cooked file. Fails if it is missing, malformed, or was cooked from a different source
+	bool Open(const std::string& path, uint64_t sourceHash);
+	// Takes ownership of an in-memory cooked blob
+	bool Load(std::vector<char> blob, uint64_t sourceHash);
+	// Releases the mapping or blob
+	void Close();
+
+	bool IsOpen() const { return m_Header != nullptr; }
+
+	const CookedHeader& GetHeader() const { return *m_Header; }
+	const CookedMesh* GetMeshes() const { return Section<CookedMesh>(m_Header->MeshOffset); }
+	const CookedMaterial* GetMaterials() const { return Section<CookedMaterial>(m_Header->MaterialOffset); }
+	const CookedTexture* GetTextures() const { return Section<CookedTexture>(m_Header->TextureOffset); }
+	const CookedNode* GetNodes() const { return Section<CookedNode>(m_Header->NodeOffset); }
+	const uint32_t* GetNodeMeshes() const { return Section<uint32_t>(m_Header->NodeMeshOffset); }
+	const Vertex* GetVertices() const { return Section<Vertex>(m_Header->VertexOffset); }
+	const uint32_t* GetIndices() const { return Section<uint32_t>(m_Header->IndexOffset); }
+	std::string GetString(uint32_t offset, uint32_t length) const;
+
+	// Serializes imported model data into the cooked format
+	static std::vector<char> Serialize(const ModelData& model, uint64_t sourceHash);
+	// Serializes imported model data and writes it to path
+	static bool Write(const std::string& path, const ModelData& model, uint64_t sourceHash);
+	// 64-bit FNV-1a hash of a file's contents, 0 if it cannot be read
+	static uint64_t HashFile(const std::string& path);
+	// Hash of a model file and the files its cooked data depends on, i.e. the material libraries an .obj names.
+	// 0 if the model cannot be read
+	static uint64_t HashSource(const std::string& path);
+
+public:
+	static constexpr uint32_t s_Version = 3;
+
+private:
+	bool Validate(const char* data, size_t size, uint64_t sourceHash);
+
+	template<typename T>
+	const T* Section(const uint64_t offset) const { return reinterpret_cast<const T*>(m_Data + offset); }
+
+private:
+	MappedFile m_File;
+	std::vector<char> m_Blob;
+	const char* m_Data = nullptr;
+	const CookedHeader* m_Header = nullptr;
+};
@@ -19,6 +19,10 @@ class PointLight final : public Light
 {
 public:
 	PointLight() { SetIndex(); }
+	// Copies keep the original's index but still count as live lights, balancing the destructor
+	PointLight(const PointLight& other)
+		: Light(other) { *this = other; s_Count++; }
+	PointLight& operator=(const PointLight&) = default;
 	explicit PointLight(const glm::vec4 position)
 		: m_Pos(position) { SetIndex(); }
 	explicit PointLight(float distance);
@@ -49,6 +53,9 @@ class DirectionalLight final : public Light
 {
 public:
 	DirectionalLight() { SetIndex(); }
+	DirectionalLight(const DirectionalLight& other)
+		: Light(other) { *this = other; s_Count++; }
+	DirectionalLight& operator=(const DirectionalLight&) = default;
 	explicit DirectionalLight(const glm::vec3 direction)
 		: m_Direction(direction) { SetIndex(); }
 	explicit DirectionalLight(const glm::vec3 direction, const float kA, const float kD, const float kS)
@@ -84,6 +91,9 @@ class SpotLight final : public Light
 {
 public:
 	SpotLight() { SetIndex(); }
+	SpotLight(const SpotLight& other)
+		: Light(other) { *this = other; s_Count++; }
+	SpotLight& operator=(const SpotLight&) = default;
 	explicit SpotLight(float theta);
 	explicit SpotLight(float theta, float kA, float kD, float kS);
 	explicit SpotLight(glm::vec3 direction, float theta, float kA, float kD, float kS);
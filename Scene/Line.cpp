@@ -1,5 +1,8 @@
 #include "Line.h"
 
+#include "..\utils.h"
+#include "..\Renderer\UploadManager.h"
+
 Line::Line(glm::vec3 start, glm::vec3 end, glm::vec4 color)
 	: m_Start(start), m_End(end), m_Color(color)
 {
@@ -8,16 +11,19 @@ Line::Line(glm::vec3 start, glm::vec3 end, glm::vec4 color)
 		end.x, end.y, end.z
 	};
 
-	glBindVertexArray(VAO);
-
-	unsigned int VBO = 0;
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(m_Vertices), m_Vertices.data(), GL_STATIC_DRAW);  // NOLINT(bugprone-sizeof-container)
+	const auto vertexBytes = static_cast<GLsizeiptr>(m_Vertices.size() * sizeof(float));
+	auto vertices = g_VertexPool->Allocate(vertexBytes);
+	if (!vertices)
+	{
+		// Left without vertices, so it draws nothing
+		LogError("LINE: No room for the line's vertices");
+		return;
+	}
+	VAO.SetVertexBuffer(std::move(vertices), 3 * sizeof(float));
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), static_cast<void*>(nullptr));
-	glEnableVertexAttribArray(0);
+	glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(VAO, 0, 0);
+	glEnableVertexArrayAttrib(VAO, 0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	StageBufferUpload(VAO.Vertices->GetBuffer(), VAO.Vertices->GetOffset(), vertexBytes, m_Vertices.data());
 }
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Maps the file at path, closing any previously mapped file. Returns false if the file could not be mapped
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const { return m_Data != nullptr; }
+	const char* GetData() const { return m_Data; }
+	size_t GetSize() const { return m_Size; }
+
+	~MappedFile() { Close(); }
+
+private:
+	const char* m_Data = nullptr;
+	size_t m_Size = 0;
+	void* m_FileHandle = nullptr;
+	void* m_MappingHandle = nullptr;
+};
@@ -1,51 +1,177 @@
 #include "Model.h"
 
 #include <iostream>
+#include <limits>
 
 #include <assimp\postprocess.h>
+#include <glm\gtc\type_ptr.hpp>
 
+#include "..\utils.h"
+#include "Components\Renderable\SharedMeshComponent.h"
 #include "Components\Renderable\TriangleMeshComponent.h"
 #include "Components\MaterialComponent.h"
 #include "Components\ModelComponent.h"
+#include "Components\TransformComponent.h"
+#include "TangentGenerator.h"
+#include "VertexWelder.h"
+#include "..\ThreadPool.h"
+#include "..\Renderer\AssetManager.h"
+
+std::shared_ptr<ModelLoad> Model::LoadAsync(const std::string& path, const std::shared_ptr<Scene>& scene,
+    std::weak_ptr<Shader> shader, const bool correctGamma)
+{
+    // The resource pools belong to the GL thread, so register the shader there. Waiting from it just runs the job
+    auto& pool = ThreadPool::Get();
+    ShaderHandle shaderHandle;
+    pool.Wait(pool.SubmitToMainThread([&shaderHandle, &shader] { shaderHandle = g_Resources->Shaders.Add(shader.lock()); }));
+
+    auto load = std::make_shared<ModelLoad>();
+    load->m_Model = std::shared_ptr<Model>(new Model(scene, shaderHandle, correctGamma));
+    s_UUID++;
+
+    pool.Submit([load, path]
+    {
+        const bool prepared = load->m_Model->Prepare(path);
+        load->m_MeshCount = static_cast<uint32_t>(load->m_Model->m_MeshReferences.size());
+        load->m_State = prepared ? ModelLoadState::Streaming : ModelLoadState::Failed;
+    });
+
+    scene->TrackModelLoad(load);
+    return load;
+}
 
 void Model::LoadModel(const std::string& path)
 {
     const auto activeScene = m_Scene.lock();
+    if (!activeScene || !Prepare(path))
+        return;
+
+    UploadTextures();
+    InstantiateMeshes(*activeScene, std::numeric_limits<size_t>::max());
+}
+
+bool Model::Prepare(const std::string& path)
+{
+    // retrieve the directory path of the filepath
+    m_Directory = path.substr(0, path.find_last_of('\\'));
+    m_Path = std::make_shared<const std::string>(path);
+
+    if (!OpenCooked(path, m_Cooked))
+        return false;
+
+    // list the mesh references in the order meshes will be instantiated in. Parents are stored before their children,
+    // so a node's transform relative to the root is complete by the time its children need it
+    const CookedHeader& header = m_Cooked.GetHeader();
+    const CookedNode* nodes = m_Cooked.GetNodes();
+    const uint32_t* nodeMeshes = m_Cooked.GetNodeMeshes();
+    std::vector<glm::mat4> nodeTransforms(header.NodeCount);
+    m_MeshReferences.clear();
+    m_MeshReferences.reserve(header.NodeMeshCount);
+    for (uint32_t node = 0; node < header.NodeCount; node++)
+    {
+        const int32_t parent = nodes[node].Parent;
+        nodeTransforms[node] = parent >= 0 && static_cast<uint32_t>(parent) < node
+            ? nodeTransforms[parent] * nodes[node].Transform : nodes[node].Transform;
+
+        for (uint32_t i = 0; i < nodes[node].MeshCount; i++)
+        {
+            const uint32_t meshIndex = nodeMeshes[nodes[node].FirstMesh + i];
+            if (meshIndex < header.MeshCount)
+                m_MeshReferences.push_back({ meshIndex, node, nodeTransforms[node] });
+        }
+    }
+    m_Meshes = std::vector<std::shared_ptr<const TriangleMeshComponent>>(header.MeshCount);
+    m_NodeEntities = std::vector<entt::entity>(header.NodeCount, entt::entity(entt::null));
+    m_NextReference = 0;
+
+    DecodeTextures();
+    return true;
+}
+
+bool Model::OpenCooked(const std::string& path, CookedModel& cooked)
+{
+    // only run ASSIMP when the source asset, or a material library it uses, no longer matches its cooked file
+    const uint64_t sourceHash = CookedModel::HashSource(path);
+    const std::string cookedPath = path + ".cooked";
+
+    if (cooked.Open(cookedPath, sourceHash))
+        return true;
+
+    ModelData model;
+    if (!ImportModel(path, model))
+        return false;
+
+    // fall back to the in-memory blob if the cooked file can't be written
+    if (!CookedModel::Write(cookedPath, model, sourceHash) || !cooked.Open(cookedPath, sourceHash))
+        return cooked.Load(CookedModel::Serialize(model, sourceHash), sourceHash);
+    return true;
+}
 
+bool Model::ImportModel(const std::string& path, ModelData& model)
+{
     // read file via ASSIMP
     auto importer = Assimp::Importer();
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs); // | aiProcess_CalcTangentSpace);
+    // tangents are generated after welding by TangentGenerator, which matches MikkTSpace where Assimp's don't
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
     // check for errors
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
         std::cout << "ERROR::ASSIMP: " << importer.GetErrorString() << std::endl;
-        return;
+        return false;
     }
-    // retrieve the directory path of the filepath
-    m_Directory = path.substr(0, path.find_last_of('\\'));
+
+    // meshes are independent of each other, so convert, weld and build tangent frames for them all at once
+    model.Meshes.resize(scene->mNumMeshes);
+    auto weldResults = std::vector<WeldResult>(scene->mNumMeshes);
+    const auto welder = VertexWelder(s_WeldEpsilon);
+    ThreadPool::Get().ParallelFor(scene->mNumMeshes, [scene, &model, &weldResults, &welder](const size_t i)
+    {
+        ProcessMesh(scene->mMeshes[i], model.Meshes[i]);
+        if (welder.m_Epsilon >= 0.0f)
+            weldResults[i] = welder.Weld(model.Meshes[i].Vertices, model.Meshes[i].Indices);
+        TangentGenerator::Generate(model.Meshes[i].Vertices, model.Meshes[i].Indices);
+    });
+
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+    {
+        if (weldResults[i].VerticesAfter < weldResults[i].VerticesBefore)
+            Log("ASSIMP::WELD: " + std::string(scene->mMeshes[i]->mName.C_Str()) + " " + std::to_string(weldResults[i].VerticesBefore)
+                + " -> " + std::to_string(weldResults[i].VerticesAfter) + " vertices, " + std::to_string(weldResults[i].GetBytesSaved()) + " bytes saved");
+    }
+
+    model.Materials.resize(scene->mNumMaterials);
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+        ProcessMaterial(scene->mMaterials[i], model.Materials[i]);
 
     // process ASSIMP's root node recursively
-    ProcessNode(scene->mRootNode, scene, activeScene);
+    ProcessNode(scene->mRootNode, -1, model);
+
+    return true;
 }
 
-// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-void Model::ProcessNode(const aiNode* node, const aiScene* scene, const std::shared_ptr<Scene>& activeScene)
+// processes a node in a recursive fashion, appending it and then its children (if any) to the node list.
+void Model::ProcessNode(const aiNode* node, const int32_t parent, ModelData& model)
 {
-    for (unsigned int i = 0; i < node->mNumMeshes; i++)
-        ProcessMesh(scene->mMeshes[node->mMeshes[i]], scene, activeScene);
+    const auto index = static_cast<int32_t>(model.Nodes.size());
+    auto& nodeData = model.Nodes.emplace_back();
+
+    // ASSIMP matrices are row major
+    nodeData.Transform = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+    nodeData.Parent = parent;
+    nodeData.Meshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
 
     for (unsigned int i = 0; i < node->mNumChildren; i++)
-        ProcessNode(node->mChildren[i], scene, activeScene);
+        ProcessNode(node->mChildren[i], index, model);
 }
 
-void Model::ProcessMesh(aiMesh* mesh, const aiScene* scene, const std::shared_ptr<Scene>& activeScene)
+void Model::ProcessMesh(const aiMesh* mesh, MeshData& meshData)
 {
-    auto entity = activeScene->CreateEntity();
-    activeScene->AddComponent<ModelComponent>(entity, this);
-    
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<std::shared_ptr<Tex2D>> textures;
+    meshData.MaterialIndex = mesh->mMaterialIndex;
+    meshData.Vertices.reserve(mesh->mNumVertices);
+    meshData.Indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
+
+    glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
 
     // walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -60,73 +186,258 @@ void Model::ProcessMesh(aiMesh* mesh, const aiScene* scene, const std::shared_pt
         if (mesh->mTextureCoords[0])
             vertex.TexCoord = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
 
-        vertices.emplace_back(vertex);
+        boundsMin = glm::min(boundsMin, glm::vec3(vertex.Position));
+        boundsMax = glm::max(boundsMax, glm::vec3(vertex.Position));
+
+        meshData.Vertices.emplace_back(vertex);
     }
 
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
         for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.emplace_back(face.mIndices[j]);
+            meshData.Indices.emplace_back(face.mIndices[j]);
     }
 
-    activeScene->AddComponent<TriangleMeshComponent>(entity, vertices, indices);
+    if (mesh->mNumVertices)
+    {
+        meshData.BoundsMin = boundsMin;
+        meshData.BoundsMax = boundsMax;
+    }
+}
 
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+void Model::ProcessMaterial(const aiMaterial* material, MaterialData& materialData)
+{
+    // Collect all the different types of textures in the order they are bound
+    const std::pair<aiTextureType, const char*> textureTypes[] = {
+        { aiTextureType_DIFFUSE,  "diffuse"  },
+        { aiTextureType_SPECULAR, "specular" },
+        { aiTextureType_HEIGHT,   "normal"   },
+        { aiTextureType_AMBIENT,  "height"   },
+        { aiTextureType_EMISSIVE, "emissive" }
+    };
 
-    // Batch load all the different types of textures
-    auto diffuseMaps  = LoadMaterialTextures(material, aiTextureType_DIFFUSE,  "diffuse");
-    auto specularMaps = LoadMaterialTextures(material, aiTextureType_SPECULAR, "specular");
-    auto normalMaps   = LoadMaterialTextures(material, aiTextureType_HEIGHT,   "normal");
-    auto heightMaps   = LoadMaterialTextures(material, aiTextureType_AMBIENT,  "height");
-    auto emissiveMaps = LoadMaterialTextures(material, aiTextureType_EMISSIVE, "emissive");
+    for (const auto& [type, typeName] : textureTypes)
+    {
+        for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
+        {
+            aiString str;
+            material->GetTexture(type, i, &str);
+            materialData.Textures.emplace_back(typeName, std::string(str.C_Str()));
+        }
+    }
+}
 
-    // Reserve space for textures
-    textures.reserve(diffuseMaps.size() + specularMaps.size() + normalMaps.size() + heightMaps.size() + emissiveMaps.size());
+size_t Model::InstantiateMeshes(Scene& activeScene, const size_t byteBudget, std::vector<entt::entity>* created)
+{
+    const CookedMesh* meshes = m_Cooked.GetMeshes();
 
-    // Move the loaded textures into the textures vector
-    for (auto& texture : diffuseMaps)
-        textures.emplace_back(std::move(texture));
+    size_t bytesUploaded = 0;
+    while (m_NextReference < m_MeshReferences.size() && (bytesUploaded == 0 || bytesUploaded < byteBudget))
+    {
+        const MeshReference& reference = m_MeshReferences[m_NextReference++];
+        const CookedMesh& mesh = meshes[reference.Mesh];
 
-    for (auto& texture : specularMaps)
-        textures.emplace_back(std::move(texture));
+        // upload straight from the cooked blob, once however many nodes place the mesh
+        auto& shared = m_Meshes[reference.Mesh];
+        if (!shared)
+        {
+            shared = std::make_shared<const TriangleMeshComponent>(
+                m_Cooked.GetVertices() + mesh.FirstVertex, mesh.VertexCount,
+                m_Cooked.GetIndices() + mesh.FirstIndex, mesh.IndexCount);
+            bytesUploaded += mesh.VertexCount * sizeof(Vertex) + mesh.IndexCount * sizeof(uint32_t);
+        }
 
-    for (auto& texture : normalMaps)
-        textures.emplace_back(std::move(texture));
+        // nodes keep their local transforms under their parents, so shear built up by a scaled parent and a rotated
+        // child survives. A node's first mesh sits on the node's entity, any others on children of it
+        entt::entity& nodeEntity = m_NodeEntities[reference.Node];
+        entt::entity entity;
+        if (!activeScene.GetRegistry().valid(nodeEntity))
+            entity = nodeEntity = InstantiateNode(activeScene, reference.Node);
+        else
+        {
+            entity = activeScene.CreateEntity();
+            activeScene.SetParent(entity, nodeEntity);
+        }
+        activeScene.AddComponent<ModelComponent>(entity, weak_from_this(), m_Path, reference.Mesh);
+        activeScene.AddComponent<SharedMeshComponent>(entity, shared);
+        activeScene.AddComponent<MaterialComponent>(entity, GetMaterial(mesh.MaterialIndex));
 
-    for (auto& texture : heightMaps)
-        textures.emplace_back(std::move(texture));
+        if (created)
+            created->emplace_back(entity);
+    }
 
-    for (auto& texture : emissiveMaps)
-        textures.emplace_back(std::move(texture));
+    // everything is on the GPU now, so the cooked data is no longer needed. The entities keep the meshes alive
+    const size_t remaining = m_MeshReferences.size() - m_NextReference;
+    if (remaining == 0)
+    {
+        m_Cooked.Close();
+        m_Meshes.clear();
+        m_NodeEntities.clear();
+    }
 
-    activeScene->AddComponent<MaterialComponent>(entity, std::move(textures), 0.5f);
+    return remaining;
 }
 
-// checks all material textures of a given type and loads the textures if they're not loaded yet.
-// the required info is returned as a texture struct.
-std::vector<std::shared_ptr<Tex2D>> Model::LoadMaterialTextures(const aiMaterial* mat, const aiTextureType type, const std::string& typeName)
+entt::entity Model::InstantiateNode(Scene& activeScene, const uint32_t node)
 {
-    auto materialTextures = std::vector<std::shared_ptr<Tex2D>>();
+    const CookedNode& cooked = m_Cooked.GetNodes()[node];
+    const auto entity = activeScene.CreateEntity();
+    activeScene.SetTransform(entity, TransformComponent(cooked.Transform));
 
-    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+    // only nodes with meshes at or below them get entities
+    const int32_t parent = cooked.Parent;
+    if (parent >= 0 && static_cast<uint32_t>(parent) < node)
     {
-        aiString str;
-        mat->GetTexture(type, i, &str);
-        auto filename = std::string(str.C_Str());
+        entt::entity& parentEntity = m_NodeEntities[parent];
+        if (!activeScene.GetRegistry().valid(parentEntity))
+            parentEntity = InstantiateNode(activeScene, static_cast<uint32_t>(parent));
+        activeScene.SetParent(entity, parentEntity);
+    }
+    return entity;
+}
+
+void Model::DecodeTextures()
+{
+    const CookedHeader& header = m_Cooked.GetHeader();
+    const CookedMaterial* materials = m_Cooked.GetMaterials();
+    const CookedTexture* textures = m_Cooked.GetTextures();
 
-        // Check if texture has been loaded
-        if (auto iterator = m_TexturesLoaded.find(filename); iterator != m_TexturesLoaded.end())
+    // gather every texture that isn't loaded yet, the first material to reference a file decides its type
+    std::unordered_map<std::string, size_t> pendingIndices;
+    for (uint32_t material = 0; material < header.MaterialCount; material++)
+    {
+        for (uint32_t t = 0; t < materials[material].TextureCount; t++)
         {
-            materialTextures.emplace_back(iterator->second);
+            const CookedTexture& texture = textures[materials[material].FirstTexture + t];
+            auto filename = m_Cooked.GetString(texture.FileOffset, texture.FileLength);
+            if (m_TexturesLoaded.count(filename) || pendingIndices.count(filename))
+                continue;
+
+            pendingIndices.emplace(filename, m_PendingTextures.size());
+            m_PendingTextures.push_back({ std::move(filename), m_Cooked.GetString(texture.TypeOffset, texture.TypeLength) });
         }
-        else
+    }
+
+    // images other models already brought in are found by content and not decoded again
+    ThreadPool::Get().ParallelFor(m_PendingTextures.size(), [this](const size_t i)
+        { g_AssetManager->PrefetchTexture(m_Directory + std::string("\\") + m_PendingTextures[i].Filename); });
+}
+
+void Model::UploadTextures()
+{
+    for (auto& pending : m_PendingTextures)
+    {
+        m_TexturesLoaded.insert(std::make_pair(pending.Filename,
+            g_AssetManager->AcquireTexture(m_Directory + std::string("\\") + pending.Filename, pending.TypeName)));
+    }
+
+    m_PendingTextures.clear();
+}
+
+float ModelLoad::GetProgress() const
+{
+    if (m_State == ModelLoadState::Finished)
+        return 1.0f;
+
+    const uint32_t meshCount = m_MeshCount;
+    return meshCount ? static_cast<float>(m_ResidentMeshCount) / static_cast<float>(meshCount) : 0.0f;
+}
+
+void ModelLoad::Update()
+{
+    if (m_State != ModelLoadState::Streaming)
+        return;
+
+    const auto activeScene = m_Model->m_Scene.lock();
+    if (!activeScene)
+    {
+        m_State = ModelLoadState::Failed;
+        return;
+    }
+
+    if (!m_TexturesUploaded)
+    {
+        m_Model->UploadTextures();
+        m_TexturesUploaded = true;
+    }
+
+    // upload the next batch and fence it, so it's only drawn once the GPU has the data
+    if (m_Model->m_NextReference < m_Model->m_MeshReferences.size())
+    {
+        UploadBatch batch;
+        m_Model->InstantiateMeshes(*activeScene, Model::s_StreamingBudget, &batch.Entities);
+        batch.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_Batches.emplace_back(std::move(batch));
+    }
+
+    // batches complete in submission order
+    while (!m_Batches.empty())
+    {
+        UploadBatch& batch = m_Batches.front();
+        const GLenum status = glClientWaitSync(batch.Fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+
+        glDeleteSync(batch.Fence);
+        for (const auto entity : batch.Entities)
         {
-            auto texture = std::make_shared<Tex2D>(m_Directory + std::string("\\") + filename, typeName);
-            materialTextures.emplace_back(texture);
-            m_TexturesLoaded.insert(std::make_pair(filename, texture));
+            if (activeScene->GetRegistry().valid(entity))
+                activeScene->AddEmptyComponent<RenderableTag>(entity);
         }
+        m_ResidentMeshCount += static_cast<uint32_t>(batch.Entities.size());
+        m_Batches.pop_front();
     }
 
-    return materialTextures;
-}
\ No newline at end of file
+    if (m_Batches.empty() && m_Model->m_NextReference >= m_Model->m_MeshReferences.size())
+        m_State = ModelLoadState::Finished;
+}
+
+ModelLoad::~ModelLoad()
+{
+    for (const auto& batch : m_Batches)
+        glDeleteSync(batch.Fence);
+}
+
+// checks whether a texture has been loaded already and loads it if not.
+TextureReference Model::LoadTexture(const std::string& filename, const std::string& typeName)
+{
+    // Check if texture has been loaded
+    if (auto iterator = m_TexturesLoaded.find(filename); iterator != m_TexturesLoaded.end())
+        return iterator->second;
+
+    auto texture = g_AssetManager->AcquireTexture(m_Directory + std::string("\\") + filename, typeName);
+    m_TexturesLoaded.insert(std::make_pair(filename, texture));
+    return texture;
+}
+
+MaterialHandle Model::GetMaterial(const uint32_t materialIndex)
+{
+    const CookedHeader& header = m_Cooked.GetHeader();
+    if (materialIndex >= header.MaterialCount)
+    {
+        if (!m_DefaultMaterial)
+            m_DefaultMaterial = g_Resources->Materials.Emplace(m_Shader, 0.5f);
+        return m_DefaultMaterial;
+    }
+
+    if (m_Materials.size() < header.MaterialCount)
+        m_Materials.resize(header.MaterialCount);
+    if (m_Materials[materialIndex])
+        return m_Materials[materialIndex];
+
+    auto material = std::make_shared<Material>(m_Shader, 0.5f);
+    const CookedMaterial& cooked = m_Cooked.GetMaterials()[materialIndex];
+    for (uint32_t t = 0; t < cooked.TextureCount; t++)
+    {
+        const CookedTexture& texture = m_Cooked.GetTextures()[cooked.FirstTexture + t];
+        const auto typeName = m_Cooked.GetString(texture.TypeOffset, texture.TypeLength);
+        const MaterialMap map = Material::MapFromTag(typeName);
+        auto reference = LoadTexture(m_Cooked.GetString(texture.FileOffset, texture.FileLength), typeName);
+        if (map != MaterialMap::Count)
+            material->SetMap(map, std::move(reference));
+    }
+
+    m_Materials[materialIndex] = g_Resources->Materials.Add(std::move(material));
+    return m_Materials[materialIndex];
+}
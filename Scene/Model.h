@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <deque>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -10,9 +12,57 @@
 
 #include "Components\Texture.h"
 
+#include "CookedModel.h"
+#include "ModelData.h"
+
 #include "Scene.h"
 
-class Model
+class Model;
+struct TriangleMeshComponent;
+
+enum class ModelLoadState
+{
+    Importing, // Hashing, cooking and decoding on the worker pool
+    Streaming, // Meshes are being uploaded and added to the scene a few per frame
+    Finished,
+    Failed
+};
+
+// Handle to a model that is loading in the background and streaming its meshes into a scene
+class ModelLoad
+{
+public:
+    ModelLoadState GetState() const { return m_State; }
+    bool IsDone() const { return m_State == ModelLoadState::Finished || m_State == ModelLoadState::Failed; }
+    // Fraction of the model's meshes that are resident on the GPU and being rendered
+    float GetProgress() const;
+    uint32_t GetMeshCount() const { return m_MeshCount; }
+    uint32_t GetResidentMeshCount() const { return m_ResidentMeshCount; }
+    std::shared_ptr<Model> GetModel() const { return m_Model; }
+
+    // Uploads the next batch of meshes and makes finished ones renderable. Called once per frame by the owning scene
+    void Update();
+
+    ~ModelLoad();
+
+private:
+    friend class Model;
+
+    struct UploadBatch
+    {
+        GLsync Fence = nullptr;
+        std::vector<entt::entity> Entities;
+    };
+
+    std::shared_ptr<Model> m_Model;
+    std::atomic<ModelLoadState> m_State = ModelLoadState::Importing;
+    std::atomic<uint32_t> m_MeshCount = 0;
+    std::atomic<uint32_t> m_ResidentMeshCount = 0;
+    std::deque<UploadBatch> m_Batches;
+    bool m_TexturesUploaded = false;
+};
+
+class Model : public std::enable_shared_from_this<Model>
 {
 public:
     // constructor, expects a filepath to a 3D model.
@@ -23,22 +73,78 @@ public:
         s_UUID++;
     }
 
+    // Starts loading a model on the worker pool and returns immediately. Its meshes are added to the scene as they
+    // finish uploading, and only become renderable with the given shader once their GPU data is resident
+    static std::shared_ptr<ModelLoad> LoadAsync(const std::string& path, const std::shared_ptr<Scene>& scene,
+        std::weak_ptr<Shader> shader = g_LitObjectShader, bool correctGamma = false);
+    // Opens a model's cooked file, importing and cooking the source first if it changed. Makes no GL calls
+    static bool OpenCooked(const std::string& path, CookedModel& cooked);
+
 public:
     inline static unsigned int s_UUID = 0;
+    inline static float s_WeldEpsilon = 1e-5f; // Imported vertices matching within this epsilon are merged, negative disables welding
+    inline static size_t s_StreamingBudget = 4 << 20; // Bytes of mesh data an asynchronous load may upload per frame
     std::string m_Directory = std::string(); // The location of the directory containing all model assets
+    std::shared_ptr<const std::string> m_Path; // The model's asset, handed to every mesh's ModelComponent
     bool m_GammaCorrection = false; // Flag for whether gamma should be corrected
     std::weak_ptr<Scene> m_Scene;
+    ShaderHandle m_Shader; // Assigned to every material the model creates
 
 private:
-    // Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    friend class ModelLoad;
+    friend class Prefab;
+
+    Model(std::weak_ptr<Scene> scene, const ShaderHandle shader, const bool correctGamma)
+        : m_GammaCorrection(correctGamma), m_Scene(std::move(scene)), m_Shader(shader) {}
+
+    // Loads a model from its cooked file, importing and cooking it first if the source asset changed
     void LoadModel(const std::string& path);
-    // Processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void ProcessNode(const aiNode* node, const aiScene* scene, const std::shared_ptr<Scene>& activeScene);
-    // Processes a mesh, then returns an entity with triangle mesh and material components.
-    void ProcessMesh(aiMesh* mesh, const aiScene* scene, const std::shared_ptr<Scene>& activeScene);
-    // Checks all material textures of a given type and loads the textures if they're not loaded yet
-    std::vector<std::shared_ptr<Tex2D>> LoadMaterialTextures(const aiMaterial* mat, aiTextureType type, const std::string& typeName);
+    // Opens or cooks the model and decodes its textures. Makes no GL calls, so it can run on a worker thread
+    bool Prepare(const std::string& path);
+    // Runs the Assimp importer on a model with supported ASSIMP extensions and converts the result into model data
+    static bool ImportModel(const std::string& path, ModelData& model);
+    // Processes a node in a recursive fashion, appending it and then its children (if any) to the node list.
+    static void ProcessNode(const aiNode* node, int32_t parent, ModelData& model);
+    // Converts a mesh's vertices, indices and bounds.
+    static void ProcessMesh(const aiMesh* mesh, MeshData& meshData);
+    // Collects the texture bindings of a material
+    static void ProcessMaterial(const aiMaterial* material, MaterialData& materialData);
+    // Decodes every texture the cooked model references that isn't loaded yet into the asset manager, in parallel
+    void DecodeTextures();
+    // Acquires the decoded textures from the asset manager
+    void UploadTextures();
+    // Creates an entity for each of the next mesh references, on its node's entity and sharing the mesh with every other
+    // reference to it, until the byte budget is spent. Only the first reference to a mesh uploads it.
+    // At least one mesh is always created. Returns the number of meshes remaining
+    size_t InstantiateMeshes(Scene& activeScene, size_t byteBudget, std::vector<entt::entity>* created = nullptr);
+    // Creates the entity of a node with its local transform, under its parent's entity, creating that first if needed
+    entt::entity InstantiateNode(Scene& activeScene, uint32_t node);
+    // Acquires a texture if this model doesn't hold it yet
+    TextureReference LoadTexture(const std::string& filename, const std::string& typeName);
+    // Returns the pooled material for a cooked material index, creating it on first use. Out of range indices share a plain material
+    MaterialHandle GetMaterial(uint32_t materialIndex);
 
 private:
-    std::unordered_map<std::string, std::shared_ptr<Tex2D>> m_TexturesLoaded = std::unordered_map<std::string, std::shared_ptr<Tex2D>>(); // Stores all loaded textures with their file names as keys
+    struct PendingTexture
+    {
+        std::string Filename;
+        std::string TypeName;
+    };
+
+    struct MeshReference
+    {
+        uint32_t Mesh = 0; // Into the cooked meshes
+        uint32_t Node = 0; // Into the cooked nodes
+        glm::mat4 Transform = glm::mat4(1.0f); // Of the referencing node, relative to the model's root
+    };
+
+    std::unordered_map<std::string, TextureReference> m_TexturesLoaded = std::unordered_map<std::string, TextureReference>(); // Stores all loaded textures with their file names as keys
+    std::vector<MaterialHandle> m_Materials; // One per cooked material, shared by every mesh that uses it
+    MaterialHandle m_DefaultMaterial;
+    CookedModel m_Cooked;
+    std::vector<MeshReference> m_MeshReferences; // Every node mesh reference, in node order
+    std::vector<std::shared_ptr<const TriangleMeshComponent>> m_Meshes; // Per cooked mesh, uploaded by its first reference
+    std::vector<entt::entity> m_NodeEntities; // Per cooked node, created along with the first mesh at or below it
+    size_t m_NextReference = 0;
+    std::vector<PendingTexture> m_PendingTextures;
 };
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include "Vertex.h"
+
+// CPU-side representation of an imported model, independent of both Assimp and OpenGL.
+
+struct MeshData
+{
+	std::vector<Vertex> Vertices;
+	std::vector<uint32_t> Indices;
+	glm::vec3 BoundsMin = glm::vec3(0.0f);
+	glm::vec3 BoundsMax = glm::vec3(0.0f);
+	uint32_t MaterialIndex = 0;
+};
+
+struct MaterialData
+{
+	std::vector<std::pair<std::string, std::string>> Textures; // (type name, file name relative to the model's directory)
+};
+
+struct NodeData
+{
+	glm::mat4 Transform = glm::mat4(1.0f); // Relative to the parent node
+	int32_t Parent = -1;
+	std::vector<uint32_t> Meshes; // Indices into ModelData::Meshes
+};
+
+struct ModelData
+{
+	std::vector<MeshData> Meshes;
+	std::vector<MaterialData> Materials;
+	std::vector<NodeData> Nodes; // Stored in depth-first order, so parents always precede their children
+};
@@ -0,0 +1,139 @@
+#include "Prefab.h"
+
+#include <cassert>
+
+#include "..\utils.h"
+#include "Model.h"
+#include "Scene.h"
+#include "Components\HierarchyComponent.h"
+#include "Components\MaterialComponent.h"
+#include "Components\ModelComponent.h"
+#include "Components\StaticShadowCasterComponent.h"
+#include "Components\TagComponent.h"
+#include "Components\Renderable\SharedMeshComponent.h"
+
+std::shared_ptr<Prefab> Prefab::Load(const std::string& path, const std::shared_ptr<Shader>& shader, const bool correctGamma)
+{
+	const auto key = std::make_tuple(path, shader.get(), correctGamma);
+	if (const auto iterator = s_Loaded.find(key); iterator != s_Loaded.end())
+	{
+		if (auto loaded = iterator->second.lock())
+			return loaded;
+	}
+
+	auto prefab = std::shared_ptr<Prefab>(new Prefab());
+	prefab->m_Model = std::shared_ptr<Model>(new Model(std::weak_ptr<Scene>(), g_Resources->Shaders.Add(shader), correctGamma));
+	Model& model = *prefab->m_Model;
+	if (!model.Prepare(path))
+	{
+		LogError("PREFAB: Could not load " + path);
+		return nullptr;
+	}
+	model.UploadTextures();
+
+	// Every reference to a mesh shares one upload of it
+	const CookedMesh* meshes = model.m_Cooked.GetMeshes();
+	prefab->m_Parts.reserve(model.m_MeshReferences.size());
+	for (const auto& reference : model.m_MeshReferences)
+	{
+		const CookedMesh& mesh = meshes[reference.Mesh];
+		auto& shared = model.m_Meshes[reference.Mesh];
+		if (!shared)
+		{
+			shared = std::make_shared<const TriangleMeshComponent>(
+				model.m_Cooked.GetVertices() + mesh.FirstVertex, mesh.VertexCount,
+				model.m_Cooked.GetIndices() + mesh.FirstIndex, mesh.IndexCount);
+		}
+		prefab->m_Parts.push_back({ reference.Mesh, TransformComponent(reference.Transform), shared, model.GetMaterial(mesh.MaterialIndex) });
+	}
+	prefab->m_PartOnRoot = model.m_MeshReferences.size() == 1 && model.m_MeshReferences.front().Transform == glm::mat4(1.0f);
+	model.m_NextReference = model.m_MeshReferences.size();
+	model.m_Meshes.clear();
+	model.m_Cooked.Close();
+
+	const size_t nameStart = path.find_last_of('\\') + 1;
+	prefab->m_Name = path.substr(nameStart, path.find_last_of('.') - nameStart);
+
+	s_Loaded[key] = prefab;
+	return prefab;
+}
+
+entt::entity Prefab::Instantiate(Scene& scene, const TransformComponent& transform, const bool isStatic) const
+{
+	return Instantiate(scene, std::vector<TransformComponent>{ transform }, isStatic).front();
+}
+
+std::vector<entt::entity> Prefab::Instantiate(Scene& scene, const std::vector<TransformComponent>& transforms, const bool isStatic) const
+{
+	entt::registry& registry = scene.GetRegistry();
+
+	// Roots are complete nodes of the transform hierarchy before anything else is added
+	std::vector<entt::entity> roots(transforms.size());
+	registry.create(roots.begin(), roots.end());
+	registry.insert<TransformComponent>(roots.begin(), roots.end(), transforms.begin());
+	registry.insert<HierarchyComponent>(roots.begin(), roots.end());
+	registry.insert<WorldTransformComponent>(roots.begin(), roots.end());
+	registry.insert<TagComponent>(roots.begin(), roots.end(), TagComponent(m_Name));
+	for (const entt::entity root : roots)
+		scene.MarkTransformDirty(root);
+
+	if (m_PartOnRoot)
+	{
+		AddPart(registry, m_Parts.front(), roots, isStatic);
+		return roots;
+	}
+
+	// Each instance's parts are its children, in the order of the model's nodes. Marking the roots dirty moves them too
+	const size_t partCount = m_Parts.size();
+	std::vector<entt::entity> children(roots.size() * partCount);
+	registry.create(children.begin(), children.end());
+	registry.insert<WorldTransformComponent>(children.begin(), children.end());
+
+	std::vector<TransformComponent> local(children.size());
+	std::vector<HierarchyComponent> hierarchy(children.size());
+	for (size_t instance = 0; instance < roots.size(); instance++)
+	{
+		const size_t first = instance * partCount;
+		for (size_t part = 0; part < partCount; part++)
+		{
+			local[first + part] = m_Parts[part].Transform;
+			HierarchyComponent& node = hierarchy[first + part];
+			node.Parent = roots[instance];
+			node.PrevSibling = part > 0 ? children[first + part - 1] : entt::null;
+			node.NextSibling = part + 1 < partCount ? children[first + part + 1] : entt::null;
+			node.Depth = 1;
+		}
+		if (partCount > 0)
+			registry.get<HierarchyComponent>(roots[instance]).FirstChild = children[first];
+	}
+	registry.insert<TransformComponent>(children.begin(), children.end(), local.begin());
+	registry.insert<HierarchyComponent>(children.begin(), children.end(), hierarchy.begin());
+
+	std::vector<entt::entity> partEntities(roots.size());
+	for (size_t part = 0; part < partCount; part++)
+	{
+		for (size_t instance = 0; instance < roots.size(); instance++)
+			partEntities[instance] = children[instance * partCount + part];
+		AddPart(registry, m_Parts[part], partEntities, isStatic);
+	}
+
+	return roots;
+}
+
+const std::string& Prefab::GetPath() const
+{
+	assert(m_Model->m_Path);
+	return *m_Model->m_Path;
+}
+
+void Prefab::AddPart(entt::registry& registry, const Part& part, const std::vector<entt::entity>& entities, const bool isStatic) const
+{
+	registry.insert<ModelComponent>(entities.begin(), entities.end(), ModelComponent(m_Model, m_Model->m_Path, part.MeshIndex));
+	registry.insert<SharedMeshComponent>(entities.begin(), entities.end(), SharedMeshComponent(part.Mesh));
+	registry.insert<MaterialComponent>(entities.begin(), entities.end(), MaterialComponent(part.Material));
+	if (isStatic)
+		registry.insert<StaticShadowCasterComponent>(entities.begin(), entities.end());
+
+	// Last, so the render proxies are created with everything in place. Draws skip the mesh until its upload lands
+	registry.insert<RenderableTag>(entities.begin(), entities.end());
+}
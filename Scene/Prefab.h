@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "entt\include\entt.hpp"
+#include "..\Renderer\Resources.h"
+#include "..\Renderer\Shader.h"
+#include "Components\TransformComponent.h"
+
+class Model;
+class Scene;
+struct TriangleMeshComponent;
+
+/* A model imported once and placed any number of times.
+* Loading a prefab imports the model, uploads each of its meshes and creates its textures and materials a single time.
+* Loading the same file with the same shader and gamma correction again returns the prefab already in memory.
+* Instances only add entities: a root carrying the instance's transform, and a child per node mesh reference, placed at
+* its node and referring to the shared mesh and material. A model with a single mesh at its origin puts it on the root,
+* so each instance is a single entity.
+* Instantiating many at once creates their entities in bulk.
+*/
+class Prefab
+{
+public:
+	Prefab(const Prefab&) = delete;
+	Prefab& operator=(const Prefab&) = delete;
+
+	// Returns the prefab for a model file, importing it if it isn't loaded. Creates GL objects, so it has to run on
+	// the GL thread. Returns nullptr if the model can't be loaded
+	static std::shared_ptr<Prefab> Load(const std::string& path, const std::shared_ptr<Shader>& shader = g_LitObjectShader,
+		bool correctGamma = false);
+
+	// Places an instance and returns its root
+	entt::entity Instantiate(Scene& scene, const TransformComponent& transform, bool isStatic = false) const;
+	// Places an instance per transform and returns their roots, in the same order
+	std::vector<entt::entity> Instantiate(Scene& scene, const std::vector<TransformComponent>& transforms, bool isStatic = false) const;
+
+	const std::string& GetPath() const;
+	// Entities each instance adds
+	size_t GetEntitiesPerInstance() const { return m_PartOnRoot ? 1 : m_Parts.size() + 1; }
+
+	~Prefab() = default;
+
+private:
+	// A mesh reference of the model, placed once per instance
+	struct Part
+	{
+		uint32_t MeshIndex = 0;
+		TransformComponent Transform; // Of the referencing node, relative to the instance's root
+		std::shared_ptr<const TriangleMeshComponent> Mesh; // Shared by every part using the same mesh
+		MaterialHandle Material;
+	};
+
+	Prefab() = default;
+
+	// Gives the entities of one part across instances their mesh, material and model reference
+	void AddPart(entt::registry& registry, const Part& part, const std::vector<entt::entity>& entities, bool isStatic) const;
+
+private:
+	std::shared_ptr<Model> m_Model; // Owns the materials and textures, and is what saved instances refer to
+	std::string m_Name;
+	std::vector<Part> m_Parts;
+	bool m_PartOnRoot = false; // The only part sits at the model's origin, so instances need no children
+
+	// By path, shader and gamma correction, since those shape the materials. Only touched on the GL thread
+	inline static std::map<std::tuple<std::string, const Shader*, bool>, std::weak_ptr<Prefab>> s_Loaded;
+};
@@ -1,25 +1,122 @@
 #include "Scene.h"
 
+#include <algorithm>
+
 #include "..\utils.h"
+#include "..\Renderer\BufferPool.h"
+#include "..\Renderer\FrameSnapshot.h"
+#include "Components\HierarchyComponent.h"
 #include "Components\TransformComponent.h"
 #include "Components\TagComponent.h"
 #include "Components\Renderable\CubeComponent.h"
+#include "Components\Renderable\MeshRendererComponent.h"
 #include "Components\Renderable\PlaneComponent.h"
+#include "Components\Renderable\SharedMeshComponent.h"
+#include "Components\Renderable\StaticBatchComponent.h"
 #include "Components\Renderable\TriangleMeshComponent.h"
+#include "Components\StaticShadowCasterComponent.h"
+#include "Model.h"
 
 // Create an entity in the scene registry and give it a...
-// - TransformComponent
+// - TransformComponent, plus the hierarchy components as a root
 // - TagComponenent
 // return the entt::entity reference
 entt::entity Scene::CreateEntity(const std::string& name)
 {
 	const auto entity = m_Registry.create();
 	AddComponent<TransformComponent>(entity);
+	m_Transforms.Attach(m_Registry, entity);
 	auto& tag = AddComponent<TagComponent>(entity);
 	tag.Tag = name.empty() ? "Entity" : name;
 	return entity;
 }
 
+void Scene::DestroyEntity(const entt::entity entity)
+{
+	std::vector<entt::entity> subtree;
+	TransformHierarchy::GetSubtree(m_Registry, entity, subtree);
+
+	TransformHierarchy::Unlink(m_Registry, entity);
+	m_Registry.destroy(subtree.begin(), subtree.end());
+}
+
+void Scene::SetTransform(const entt::entity entity, const TransformComponent& transform)
+{
+	m_Registry.get<TransformComponent>(entity) = transform;
+	m_Transforms.MarkDirty(m_Registry, entity);
+}
+
+void Scene::SetStatic(const entt::entity entity, const bool isStatic)
+{
+	if (!isStatic)
+		m_Registry.remove<StaticShadowCasterComponent>(entity);
+	else if (!m_Registry.all_of<StaticShadowCasterComponent>(entity))
+		m_Registry.emplace<StaticShadowCasterComponent>(entity);
+}
+
+void Scene::OnStaticCasterRemoved(entt::registry& registry, const entt::entity entity)
+{
+	auto* caster = registry.try_get<StaticShadowCasterComponent>(entity);
+	if (!caster || !caster->IsPublished)
+		return;
+
+	m_StaticShadowChanges.push_back(caster->Published);
+	caster->IsPublished = false;
+}
+
+void Scene::OnBatchMemberRemoved(entt::registry& registry, const entt::entity entity)
+{
+	const auto& member = registry.get<StaticBatchMemberComponent>(entity);
+	auto* batch = registry.valid(member.Batch) ? registry.try_get<StaticBatchComponent>(member.Batch) : nullptr;
+	if (!batch || !batch->Ranges || member.Range >= batch->Ranges->size())
+		return;
+
+	// The render proxy shares the ranges, so they are changed in a copy
+	auto ranges = std::make_shared<std::vector<StaticBatchRange>>(*batch->Ranges);
+	StaticBatchRange& range = (*ranges)[member.Range];
+	if (range.IndexCount == 0)
+		return;
+	range.IndexCount = 0;
+
+	if (std::none_of(ranges->begin(), ranges->end(), [](const StaticBatchRange& remaining) { return remaining.IndexCount > 0; }))
+	{
+		registry.destroy(member.Batch);
+		return;
+	}
+
+	// Cached shadows may still hold the dropped triangles
+	const auto* caster = registry.try_get<StaticShadowCasterComponent>(member.Batch);
+	if (caster && caster->IsPublished)
+		m_StaticShadowChanges.push_back(range.LocalBounds.Transformed(registry.get<WorldTransformComponent>(member.Batch).World));
+
+	batch->Ranges = std::move(ranges);
+	if (auto* renderer = registry.try_get<MeshRendererComponent>(member.Batch))
+		renderer->Ranges = batch->Ranges;
+}
+
+namespace
+{
+	// Copies the mesh of an entity that just became renderable into its render proxy
+	void AddMeshRenderer(entt::registry& registry, const entt::entity entity)
+	{
+		if (const auto* cube = registry.try_get<CubeComponent>(entity))
+			registry.emplace_or_replace<MeshRendererComponent>(entity, *cube);
+		else if (const auto* plane = registry.try_get<PlaneComponent>(entity))
+			registry.emplace_or_replace<MeshRendererComponent>(entity, *plane);
+		else if (const auto* mesh = registry.try_get<TriangleMeshComponent>(entity))
+			registry.emplace_or_replace<MeshRendererComponent>(entity, *mesh);
+		else if (const auto* shared = registry.try_get<SharedMeshComponent>(entity); shared && shared->Mesh)
+			registry.emplace_or_replace<MeshRendererComponent>(entity, *shared->Mesh);
+		else if (const auto* batch = registry.try_get<StaticBatchComponent>(entity))
+			registry.emplace_or_replace<MeshRendererComponent>(entity, *batch).Ranges = batch->Ranges;
+	}
+
+	void RemoveMeshRenderer(entt::registry& registry, const entt::entity entity)
+	{
+		registry.remove<MeshRendererComponent>(entity);
+	}
+}
+
 // Function to be executed once upon program start
 void Scene::OnStart() const
 {
@@ -43,126 +140,149 @@ void Scene::OnStart() const
 // Function to be executed on every update iteration
 void Scene::OnUpdate()
 {
-	auto renderer = m_Renderer.lock();
-    assert(renderer);
+	m_Systems.Run(*this);
+}
 
-    assert(GetAllEntitiesWith<SkyboxTag>().size() < 2);
+// Register the systems every scene runs, in the order they would run serially
+void Scene::RegisterSystems()
+{
+	// Keep render proxies in step with the components they mirror, and pack them with their materials and transforms
+	m_Registry.on_construct<RenderableTag>().connect<&AddMeshRenderer>();
+	m_Registry.on_destroy<RenderableTag>().connect<&RemoveMeshRenderer>();
+	m_Registry.on_destroy<CubeComponent>().connect<&RemoveMeshRenderer>();
+	m_Registry.on_destroy<PlaneComponent>().connect<&RemoveMeshRenderer>();
+	m_Registry.on_destroy<TriangleMeshComponent>().connect<&RemoveMeshRenderer>();
+	m_Registry.on_destroy<SharedMeshComponent>().connect<&RemoveMeshRenderer>();
+	m_Registry.on_destroy<StaticBatchComponent>().connect<&RemoveMeshRenderer>();
+	static_cast<void>(m_Registry.group<MeshRendererComponent, MaterialComponent, WorldTransformComponent>());
 
-    for (const auto& entity : GetAllEntitiesWith<SkyboxTag>()) {
-        RenderSkybox(GetComponent<CubeComponent>(entity), GetComponent<CubeMapMaterialComponent>(entity));
-    }
+	// Static casters leaving take their cached shadows with them
+	m_Registry.on_destroy<StaticShadowCasterComponent>().connect<&Scene::OnStaticCasterRemoved>(*this);
+	m_Registry.on_destroy<MeshRendererComponent>().connect<&Scene::OnStaticCasterRemoved>(*this);
+	m_Registry.on_destroy<StaticBatchMemberComponent>().connect<&Scene::OnBatchMemberRemoved>(*this);
 
-	// Draw all Vertex Array Buffers
-	for (const auto& entity : GetAllEntitiesWith<RenderableTag, MaterialComponent>())
-	{
-		UseMaterialShader(GetComponent<MaterialComponent>(entity));
-
-        // Render based on object type
-		if (HasComponent<CubeComponent>(entity))
-			renderer->RenderIndexed(GetComponent<CubeComponent>(entity).VAO);
-		else if (HasComponent<PlaneComponent>(entity))
-			renderer->RenderIndexed(GetComponent<PlaneComponent>(entity).VAO);
-		else if (HasComponent<TriangleMeshComponent>(entity))
-			renderer->RenderIndexed(GetComponent<TriangleMeshComponent>(entity).VAO);
-	}
+	m_Systems.AddSystem("ModelStreaming", Reads<>(), Writes<>(),
+		[](Scene& scene) { scene.UpdateModelLoads(); }, SystemAffinity::Exclusive);
+
+	m_Systems.AddSystem("Transforms", Reads<TransformComponent, HierarchyComponent>(), Writes<WorldTransformComponent>(),
+		[](Scene& scene) { scene.m_Transforms.Propagate(scene.m_Registry); });
 }
 
-// Render the currently set skybox in m_SceneData
-void Scene::RenderSkybox(const CubeComponent& mesh, const CubeMapMaterialComponent& material) const
+// Stream in the next batch of any models that are still loading
+void Scene::UpdateModelLoads()
 {
-    assert(material.m_Shader.lock());
-    assert(material.m_Texture);
+    for (const auto& load : m_ModelLoads)
+        load->Update();
+    m_ModelLoads.erase(std::remove_if(m_ModelLoads.begin(), m_ModelLoads.end(),
+        [](const std::shared_ptr<ModelLoad>& load) { return load->IsDone(); }), m_ModelLoads.end());
+}
+
+// Runs after OnUpdate, once transforms are current
+void Scene::BuildSnapshot(FrameSnapshot& snapshot)
+{
+	// Defragmentation can run on the render thread while this copies the draws. Offsets are published atomically, so
+	// each one read is either the old or the new one, and reading the count first marks a snapshot that mixed them stale
+	snapshot.IndexRelocations = g_IndexPool ? g_IndexPool->GetRelocationCount() : 0;
+
+	if (m_SceneData.PointLights)
+		snapshot.PointLights = *m_SceneData.PointLights;
+	if (m_SceneData.Sun)
+		snapshot.Sun = *m_SceneData.Sun;
+	if (m_SceneData.Flashlight)
+		snapshot.Flashlight = *m_SceneData.Flashlight;
+
+	const auto skyboxes = m_Registry.view<const SkyboxTag, const CubeComponent, const CubeMapMaterialComponent>();
+	assert(skyboxes.size_hint() < 2);
+	for (const auto [entity, mesh, material] : skyboxes.each())
+	{
+		if (mesh.VAO.IsResident())
+			snapshot.Skybox = SkyboxPacket{ mesh.VAO, mesh.VAO.IndexCount, mesh.VAO.GetIndexOffset(), material.Shader, material.Texture };
+	}
 
-	// Do not set depth buffer
-	glDepthMask(GL_FALSE);
+	// Static casters that appeared, moved or changed mesh since the last snapshot dirty the cached shadow cascades
+	for (const auto [entity, caster, mesh, transform] : m_Registry.view<StaticShadowCasterComponent, const MeshRendererComponent, const WorldTransformComponent>().each())
+	{
+		if (!mesh.IsResident())
+			continue;
 
-    // Cube is seen from inside, so winding order is backwards
-	glFrontFace(GL_CW);
+		const Bounds bounds = Bounds{ mesh.BoundsMin, mesh.BoundsMax }.Transformed(transform.World);
+		if (caster.IsPublished && caster.Published == bounds)
+			continue;
 
-    // Set active shader and texture(s)
-	material.m_Shader.lock()->Use();
-    material.m_Texture->Use();
+		if (caster.IsPublished)
+			m_StaticShadowChanges.push_back(caster.Published);
+		m_StaticShadowChanges.push_back(bounds);
+		caster.Published = bounds;
+		caster.IsPublished = true;
+	}
 
-    // Pass the skybox's mesh into the renderer
-    auto renderer = m_Renderer.lock();
-    if (renderer)
-        renderer->RenderIndexed(mesh.VAO);
+	if (!m_StaticShadowChanges.empty())
+	{
+		m_StaticShadowRevision++;
+		snapshot.StaticShadowChanges.swap(m_StaticShadowChanges); // Hands the snapshot's old storage back for reuse
+	}
+	snapshot.StaticShadowRevision = m_StaticShadowRevision;
 
-    // Reset flags
-	glFrontFace(GL_CCW);
+	// Proxies, materials and transforms share one ordering, so this walks three arrays front to back
+	const auto& statics = m_Registry.storage<StaticShadowCasterComponent>();
+	const auto meshes = m_Registry.group<MeshRendererComponent, MaterialComponent, WorldTransformComponent>();
+	snapshot.Draws.reserve(meshes.size());
+	for (const auto [entity, mesh, material, transform] : meshes.each())
+	{
+		// Skip meshes whose data is still in flight through the staging ring, or that found no room in the pools
+		if (!mesh.IsResident() || mesh.IndexCount == 0)
+			continue;
+
+		const GLintptr indexOffset = mesh.GetIndexOffset();
+		DrawPacket& draw = snapshot.Draws.emplace_back(DrawPacket{ mesh.VAO, mesh.IndexCount, indexOffset, material.Material, transform.World,
+			transform.Normal, Bounds{ mesh.BoundsMin, mesh.BoundsMax }.Transformed(transform.World), statics.contains(entity) });
 
-	glDepthMask(GL_TRUE);
+		// A static batch's merged meshes let shadow passes cull it piece by piece. The main pass joins them back into one
+		// call, split only where destroyed members left gaps
+		if (mesh.Ranges)
+		{
+			draw.FirstSubMesh = static_cast<uint32_t>(snapshot.SubMeshes.size());
+			for (const StaticBatchRange& range : *mesh.Ranges)
+			{
+				if (range.IndexCount == 0)
+					continue;
+
+				snapshot.SubMeshes.push_back({ range.IndexCount, indexOffset + static_cast<GLintptr>(range.FirstIndex * sizeof(uint32_t)),
+					range.LocalBounds.Transformed(transform.World) });
+			}
+			draw.SubMeshCount = static_cast<uint32_t>(snapshot.SubMeshes.size()) - draw.FirstSubMesh;
+		}
+	}
 }
 
 // Set the active shader to be material's shader and populate shader data
-void Scene::UseMaterialShader(const MaterialComponent& materialComponent)
+void Scene::UseMaterialShader(const Material& material)
 {
-    assert(materialComponent.m_Shader.lock());
-	materialComponent.m_Shader.lock()->Use();
+	g_Resources->Shaders.Get(material.Shader).Use();
 
-    SendMaterialDataToShader(materialComponent);
+    SendMaterialDataToShader(material);
 }
 
-// Populate the material struct in the shader file as well as the texture array
-void Scene::SendMaterialDataToShader(const MaterialComponent& materialComponent)
+// Populate the material struct in the shader file and bind each map to the texture unit its textures[] entry samples
+void Scene::SendMaterialDataToShader(const Material& material)
 {
-    assert(materialComponent.m_Shader.lock());
-    auto shader = materialComponent.m_Shader.lock();
+    const Resources& resources = *g_Resources;
+    const Shader& shader = resources.Shaders.Get(material.Shader);
 
     int activeMaps = 0; // Bit Mask cooresponding to different texture types
-    int index = 0; // Refers to the offset for the active texture flag
-
-    if (materialComponent.m_BaseColorMap)
-    {
-        materialComponent.m_BaseColorMap->Use(index++);
-        shader->SetInt("textures[0]", static_cast<int>(materialComponent.m_BaseColorMap->m_ID));
-        activeMaps |= 0b1;
-    }
-    if (materialComponent.m_AlbedoMap)
-    {
-        materialComponent.m_AlbedoMap->Use(index++);
-        shader->SetInt("textures[1]", static_cast<int>(materialComponent.m_AlbedoMap->m_ID));
-        activeMaps |= 0b10;
-    }
-    if (materialComponent.m_MetallicMap)
-    {
-        materialComponent.m_MetallicMap->Use(index++);
-        shader->SetInt("textures[2]", static_cast<int>(materialComponent.m_MetallicMap->m_ID));
-        activeMaps |= 0b100;
-    }
-    if (materialComponent.m_RoughnessMap)
-    {
-        materialComponent.m_RoughnessMap->Use(index++);
-        shader->SetInt("textures[3]", static_cast<int>(materialComponent.m_RoughnessMap->m_ID));
-        activeMaps |= 0b1000;
-    }
-    if (materialComponent.m_AmbientOcclusionMap)
+    for (int map = 0; map < static_cast<int>(MaterialMap::Opacity); map++)
     {
-        materialComponent.m_AmbientOcclusionMap->Use(index++);
-        shader->SetInt("textures[4]", static_cast<int>(materialComponent.m_AmbientOcclusionMap->m_ID));
-        activeMaps |= 0b10000;
-    }
-    if (materialComponent.m_NormalMap)
-    {
-        materialComponent.m_NormalMap->Use(index++);
-        shader->SetInt("textures[5]", static_cast<int>(materialComponent.m_NormalMap->m_ID));
-        activeMaps |= 0b100000;
-    }
-    if (materialComponent.m_HeightMap)
-    {
-        materialComponent.m_HeightMap->Use(index++);
-        shader->SetInt("textures[6]", static_cast<int>(materialComponent.m_HeightMap->m_ID));
-        activeMaps |= 0b1000000;
-    }
-    if (materialComponent.m_EmissionMap)
-    {
-        materialComponent.m_EmissionMap->Use(index);
-        shader->SetInt("textures[7]", static_cast<int>(materialComponent.m_EmissionMap->m_ID));
-        activeMaps |= 0b10000000;
+        if (const TextureHandle texture = material.Maps[map])
+        {
+            resources.Textures.Get(texture).Use(map);
+            activeMaps |= 1 << map;
+        }
     }
 
-    shader->SetInt("material.activeMaps", activeMaps);
-    if (materialComponent.m_SetShininess)
-        shader->SetFloat("material.shininess", materialComponent.m_Shininess);
-}
+    if (material.GetMap(MaterialMap::BaseColor))
+        shader.SetVec4("material.baseColorTransform", material.BaseColorUVTransform);
 
+    shader.SetInt("material.activeMaps", activeMaps);
+    if (material.SetShininess)
+        shader.SetFloat("material.shininess", material.Shininess);
+}
@@ -6,20 +6,39 @@
 #include "..\Renderer\Renderer.h"
 #include "Components\MaterialComponent.h"
 #include "Components\Renderable\CubeComponent.h"
+#include "..\Renderer\Bounds.h"
+#include "SystemScheduler.h"
+#include "TransformHierarchy.h"
+
+class ModelLoad;
+struct FrameSnapshot;
 
 class Scene
 {
 public:
-	Scene() = default;
+	Scene() { RegisterSystems(); }
 	Scene(std::weak_ptr<Renderer> renderer, const int viewportWidth = 0, const int viewportHeight = 0)
-		: m_ViewportWidth(viewportWidth), m_ViewportHeight(viewportHeight), m_Renderer(std::move(renderer)) {}
+		: m_ViewportWidth(viewportWidth), m_ViewportHeight(viewportHeight), m_Renderer(std::move(renderer)) { RegisterSystems(); }
 	Scene(const int viewportWidth, const int viewportHeight)
-		: m_ViewportWidth(viewportWidth), m_ViewportHeight(viewportHeight) {}
+		: m_ViewportWidth(viewportWidth), m_ViewportHeight(viewportHeight) { RegisterSystems(); }
 
 	entt::registry& GetRegistry() { return m_Registry; }
 	entt::entity CreateEntity(const std::string& name = std::string());
+	// Destroys an entity along with all of its children
+	void DestroyEntity(entt::entity entity);
+
+	// Makes child a child of parent, or a root if parent is entt::null. The child's local transform is kept
+	void SetParent(const entt::entity child, const entt::entity parent) { m_Transforms.SetParent(m_Registry, child, parent); }
+	// Replaces an entity's local transform, its world matrices and those of its children are rebuilt on the next update
+	void SetTransform(entt::entity entity, const TransformComponent& transform);
+	// Call after editing a TransformComponent in place
+	void MarkTransformDirty(const entt::entity entity) { m_Transforms.MarkDirty(m_Registry, entity); }
+	// Static meshes are cached in the distant shadow cascades, which only redraw where static geometry changed
+	void SetStatic(entt::entity entity, bool isStatic);
 
 	std::shared_ptr<Camera> GetSceneCamera() { return m_SceneCamera; }
+	// Systems run by OnUpdate. Register more to have them scheduled alongside the built-in ones
+	SystemScheduler& GetSystems() { return m_Systems; }
 
 	template<typename... Components>
 	auto GetAllEntitiesWith() { return m_Registry.view<Components...>(); }
@@ -41,16 +60,27 @@ public:
 
 	std::weak_ptr<Scene> GetWeakPtr() { return { std::shared_ptr<Scene>(this) }; }
 
+	// Keeps an asynchronous model load streaming into this scene until it finishes
+	void TrackModelLoad(std::shared_ptr<ModelLoad> load) { m_ModelLoads.emplace_back(std::move(load)); }
+
 	void OnStart() const;
 	void OnUpdate();
+	// Copies the lights, skybox and every resident mesh's draw into snapshot, for the render thread to draw
+	void BuildSnapshot(FrameSnapshot& snapshot);
 
-	void RenderSkybox(const CubeComponent& mesh, const CubeMapMaterialComponent& material) const;
-
-	static void UseMaterialShader(const MaterialComponent& materialComponent);
-	static void SendMaterialDataToShader(const MaterialComponent& materialComponent);
+	static void UseMaterialShader(const Material& material);
+	static void SendMaterialDataToShader(const Material& material);
 
 	~Scene() = default;
 
+private:
+	void RegisterSystems();
+	void UpdateModelLoads();
+	// Invalidates the shadow a static caster left behind when it or its mesh goes away
+	void OnStaticCasterRemoved(entt::registry& registry, entt::entity entity);
+	// Drops the triangles of a merged mesh from its static batch, and the batch along with its last member
+	void OnBatchMemberRemoved(entt::registry& registry, entt::entity entity);
+
 public:
 	SceneData m_SceneData = {};
 
@@ -60,4 +90,9 @@ private:
 	int m_ViewportWidth = 0, m_ViewportHeight = 0;
 
 	std::weak_ptr<Renderer> m_Renderer;
+	std::vector<std::shared_ptr<ModelLoad>> m_ModelLoads;
+	SystemScheduler m_Systems;
+	TransformHierarchy m_Transforms;
+	std::vector<Bounds> m_StaticShadowChanges; // Collected until the next snapshot
+	uint64_t m_StaticShadowRevision = 0;
 };
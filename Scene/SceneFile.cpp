@@ -0,0 +1,818 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <unordered_map>
+
+#include "..\utils.h"
+#include "..\ThreadPool.h"
+#include "..\Renderer\AssetManager.h"
+#include "MappedFile.h"
+#include "Model.h"
+#include "Scene.h"
+#include "Components\ColorPalette.h"
+#include "Components\HierarchyComponent.h"
+#include "Components\ModelComponent.h"
+#include "Components\StaticShadowCasterComponent.h"
+#include "Components\TagComponent.h"
+#include "Components\Texture.h"
+#include "Components\TransformComponent.h"
+#include "Components\Renderable\PlaneComponent.h"
+#include "Components\Renderable\SharedMeshComponent.h"
+#include "Components\Renderable\StaticBatchComponent.h"
+#include "Components\Renderable\TriangleMeshComponent.h"
+
+// Transforms are inserted straight from the mapped file
+static_assert(std::is_trivially_copyable_v<TransformComponent>);
+
+namespace
+{
+	constexpr char s_Magic[4] = { 'L', 'O', 'G', 'S' };
+
+	// Shaders are globals, so materials refer to them by name
+	struct NamedShader
+	{
+		const char* Name;
+		const std::shared_ptr<Shader>* Global;
+	};
+
+	const NamedShader s_Shaders[] = {
+		{ "Isolated", &g_IsolatedShader },
+		{ "LitObject", &g_LitObjectShader },
+		{ "Mirror", &g_MirrorShader },
+		{ "Refractor", &g_RefractorShader },
+		{ "Line", &g_LineShader },
+		{ "Skybox", &g_SkyboxShader },
+		{ "Screen", &g_ScreenShader }
+	};
+
+	// Bytes per element of each pool's data, 0 for pools without any
+	constexpr uint32_t s_PoolStrides[] = {
+		sizeof(SceneString), sizeof(uint32_t), 0, 0, sizeof(SceneModelMesh), 0, 0
+	};
+	static_assert(std::size(s_PoolStrides) == static_cast<size_t>(ScenePool::Count));
+
+	uint64_t AlignUp(const uint64_t value)
+	{
+		return (value + 15) & ~static_cast<uint64_t>(15);
+	}
+
+	// Checks that count elements of T starting at offset lie entirely inside a blob of the given size
+	template<typename T>
+	bool InBounds(const uint64_t offset, const uint64_t count, const size_t size)
+	{
+		return offset <= size && count <= (size - offset) / sizeof(T);
+	}
+
+	// Collects the strings of a file into one blob
+	class StringTable
+	{
+	public:
+		SceneString Add(const std::string& string)
+		{
+			const SceneString added = { static_cast<uint32_t>(m_Blob.size()), static_cast<uint32_t>(string.size()) };
+			m_Blob += string;
+			return added;
+		}
+
+		const std::string& GetBlob() const { return m_Blob; }
+
+	private:
+		std::string m_Blob;
+	};
+
+	// Entity positions and data of an optional component pool, while serializing
+	struct PoolData
+	{
+		std::vector<uint32_t> Entities;
+		std::vector<char> Data;
+		uint32_t Stride = 0;
+
+		template<typename T>
+		void Add(const uint32_t entity, const T& value)
+		{
+			Stride = sizeof(T);
+			Entities.emplace_back(entity);
+			const size_t offset = Data.size();
+			Data.resize(offset + sizeof(T));
+			std::memcpy(Data.data() + offset, &value, sizeof(T));
+		}
+
+		// Orders the entries by entity position
+		void Sort()
+		{
+			std::vector<uint32_t> order(Entities.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [this](const uint32_t a, const uint32_t b) { return Entities[a] < Entities[b]; });
+
+			std::vector<uint32_t> entities(Entities.size());
+			std::vector<char> data(Data.size());
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				entities[i] = Entities[order[i]];
+				if (Stride)
+					std::memcpy(data.data() + i * Stride, Data.data() + static_cast<size_t>(order[i]) * Stride, Stride);
+			}
+			Entities.swap(entities);
+			Data.swap(data);
+		}
+	};
+
+	// Adds the positions of every numbered entity holding a component without data
+	template<typename Component>
+	void AddEntities(const entt::registry& registry, const std::unordered_map<entt::entity, uint32_t>& positions, PoolData& pool)
+	{
+		for (const auto entity : registry.view<const Component>())
+		{
+			if (const auto iterator = positions.find(entity); iterator != positions.end())
+				pool.Entities.emplace_back(iterator->second);
+		}
+	}
+}
+
+std::vector<char> SceneFile::Serialize(Scene& scene)
+{
+	// Storage order keeps the entities that were created together next to each other
+	const auto nodes = scene.GetRegistry().view<const TransformComponent, const HierarchyComponent>();
+	return Serialize(scene, std::vector<entt::entity>(nodes.begin(), nodes.end()), true);
+}
+
+std::vector<char> SceneFile::Serialize(Scene& scene, const std::vector<entt::entity>& selection, const bool includeLights)
+{
+	entt::registry& registry = scene.GetRegistry();
+	const Resources& resources = *g_Resources;
+
+	SceneHeader header{};
+	std::memcpy(header.Magic, s_Magic, sizeof(s_Magic));
+	header.Version = s_Version;
+
+	// Entities are numbered in the order given
+	std::unordered_map<entt::entity, uint32_t> positions;
+	std::vector<entt::entity> entities;
+	for (const auto entity : selection)
+	{
+		if (!registry.all_of<TransformComponent, HierarchyComponent>(entity) || positions.count(entity))
+			continue;
+
+		positions.emplace(entity, static_cast<uint32_t>(entities.size()));
+		entities.emplace_back(entity);
+	}
+	header.EntityCount = static_cast<uint32_t>(entities.size());
+
+	const auto getPosition = [&positions](const entt::entity entity)
+	{
+		const auto iterator = positions.find(entity);
+		return iterator != positions.end() ? iterator->second : SceneHierarchy::s_None;
+	};
+
+	std::vector<TransformComponent> transforms;
+	std::vector<SceneHierarchy> hierarchy;
+	transforms.reserve(entities.size());
+	hierarchy.reserve(entities.size());
+	for (const auto entity : entities)
+	{
+		transforms.emplace_back(registry.get<TransformComponent>(entity));
+		const auto& node = registry.get<HierarchyComponent>(entity);
+		hierarchy.push_back({ getPosition(node.Parent), getPosition(node.FirstChild), getPosition(node.PrevSibling),
+			getPosition(node.NextSibling), node.Depth });
+	}
+
+	StringTable strings;
+	std::array<PoolData, static_cast<size_t>(ScenePool::Count)> pools;
+	const auto pool = [&pools](const ScenePool type) -> PoolData& { return pools[static_cast<size_t>(type)]; };
+	for (const auto [entity, tag] : registry.view<const TagComponent>().each())
+	{
+		if (const auto iterator = positions.find(entity); iterator != positions.end())
+			pool(ScenePool::Tag).Add(iterator->second, strings.Add(tag.Tag));
+	}
+
+	// Materials, with the shaders and textures they use
+	std::vector<SceneMaterial> materials;
+	std::vector<SceneTexture> textures;
+	std::vector<SceneString> shaders;
+	std::unordered_map<uint32_t, uint32_t> materialIndices, textureIndices;
+	std::unordered_map<std::string, uint32_t> shaderIndices;
+	const Texture* palette = g_ColorPalette ? g_ColorPalette->GetTexture().get() : nullptr;
+
+	const auto addTexture = [&](const TextureHandle handle)
+	{
+		const Texture* texture = resources.Textures.TryGet(handle);
+		if (texture && texture == palette)
+			return SceneMaterial::s_PaletteTexture;
+
+		// Only textures loaded from a file can be found again
+		const auto* image = dynamic_cast<const Tex2D*>(texture);
+		if (!image || image->m_Path.empty())
+			return SceneMaterial::s_NoTexture;
+
+		const auto [iterator, added] = textureIndices.emplace(handle.Value, static_cast<uint32_t>(textures.size()));
+		if (added)
+			textures.push_back({ strings.Add(image->m_Path), strings.Add(image->m_Tag) });
+		return iterator->second;
+	};
+
+	const auto addShader = [&](const ShaderHandle handle)
+	{
+		std::string name;
+		const Shader* shader = resources.Shaders.TryGet(handle);
+		for (const auto& named : s_Shaders)
+		{
+			if (shader && named.Global->get() == shader)
+				name = named.Name;
+		}
+
+		const auto [iterator, added] = shaderIndices.emplace(name, static_cast<uint32_t>(shaders.size()));
+		if (added)
+			shaders.emplace_back(strings.Add(name));
+		return iterator->second;
+	};
+
+	for (const auto [entity, component] : registry.view<const MaterialComponent>().each())
+	{
+		const auto position = positions.find(entity);
+		const Material* material = resources.Materials.TryGet(component.Material);
+		if (position == positions.end() || !material)
+			continue;
+
+		const auto [iterator, added] = materialIndices.emplace(component.Material.Value, static_cast<uint32_t>(materials.size()));
+		if (added)
+		{
+			SceneMaterial saved{};
+			saved.BaseColorUVTransform = material->BaseColorUVTransform;
+			saved.BaseColor = material->BaseColor;
+			saved.Shader = addShader(material->Shader);
+			for (size_t map = 0; map < material->Maps.size(); map++)
+				saved.Maps[map] = addTexture(material->Maps[map]);
+			saved.Shininess = material->Shininess;
+			saved.SetShininess = material->SetShininess;
+			materials.emplace_back(saved);
+		}
+		pool(ScenePool::Material).Add(position->second, iterator->second);
+	}
+
+	// Meshes
+	AddEntities<CubeComponent>(registry, positions, pool(ScenePool::Cube));
+	AddEntities<PlaneComponent>(registry, positions, pool(ScenePool::Plane));
+
+	std::vector<SceneString> models;
+	std::unordered_map<std::string, uint32_t> modelIndices;
+	for (const auto [entity, model] : registry.view<const ModelComponent>().each())
+	{
+		const auto position = positions.find(entity);
+		if (position == positions.end() || !model.SourcePath || !registry.any_of<TriangleMeshComponent, SharedMeshComponent, StaticBatchMemberComponent>(entity))
+			continue;
+
+		const auto [iterator, added] = modelIndices.emplace(*model.SourcePath, static_cast<uint32_t>(models.size()));
+		if (added)
+			models.emplace_back(strings.Add(*model.SourcePath));
+		pool(ScenePool::ModelMesh).Add(position->second, SceneModelMesh{ iterator->second, model.MeshIndex });
+	}
+
+	AddEntities<StaticShadowCasterComponent>(registry, positions, pool(ScenePool::StaticShadowCaster));
+	AddEntities<RenderableTag>(registry, positions, pool(ScenePool::Renderable));
+	// Meshes merged into a static batch are written as the meshes they were, and batched again once loaded
+	AddEntities<StaticBatchMemberComponent>(registry, positions, pool(ScenePool::Renderable));
+
+	// Components are visited in storage order, files list them by entity
+	for (auto& data : pools)
+		data.Sort();
+
+	// Lights
+	std::vector<SceneLight> lights;
+	const auto addLight = [&lights](const SceneLightType type, const Light& light) -> SceneLight&
+	{
+		SceneLight& saved = lights.emplace_back();
+		saved.Type = type;
+		saved.Color = light.m_Color;
+		saved.KA = light.m_KA;
+		saved.KD = light.m_KD;
+		saved.KS = light.m_KS;
+		return saved;
+	};
+
+	// Cells of a partitioned world leave the lights to the scene they stream into
+	const SceneData& sceneData = scene.m_SceneData;
+	if (includeLights && sceneData.PointLights)
+	{
+		for (const auto& point : *sceneData.PointLights)
+		{
+			SceneLight& saved = addLight(SceneLightType::Point, point);
+			saved.Position = point.m_Pos;
+			saved.Distance = point.m_Distance;
+			saved.Constant = point.m_Constant;
+			saved.Linear = point.m_Linear;
+			saved.Quadratic = point.m_Quadratic;
+		}
+	}
+	if (includeLights && sceneData.Sun)
+		addLight(SceneLightType::Sun, *sceneData.Sun).Direction = sceneData.Sun->m_Direction;
+	if (includeLights && sceneData.Flashlight)
+	{
+		const SpotLight& flashlight = *sceneData.Flashlight;
+		SceneLight& saved = addLight(SceneLightType::Flashlight, flashlight);
+		saved.Position = flashlight.m_Pos;
+		saved.Direction = flashlight.m_Direction;
+		saved.Distance = flashlight.m_Distance;
+		saved.Constant = flashlight.m_Constant;
+		saved.Linear = flashlight.m_Linear;
+		saved.Quadratic = flashlight.m_Quadratic;
+		saved.InnerCutOff = flashlight.m_InnerCutOff;
+		saved.OuterCutOff = flashlight.m_OuterCutOff;
+	}
+
+	header.ModelCount = static_cast<uint32_t>(models.size());
+	header.ShaderCount = static_cast<uint32_t>(shaders.size());
+	header.TextureCount = static_cast<uint32_t>(textures.size());
+	header.MaterialCount = static_cast<uint32_t>(materials.size());
+	header.LightCount = static_cast<uint32_t>(lights.size());
+	header.StringSize = strings.GetBlob().size();
+
+	// Lay out the sections
+	uint64_t size = AlignUp(sizeof(SceneHeader));
+	const auto reserveSection = [&size](uint64_t& offset, const uint64_t bytes)
+	{
+		offset = size;
+		size = AlignUp(size + bytes);
+	};
+	reserveSection(header.TransformOffset, transforms.size() * sizeof(TransformComponent));
+	reserveSection(header.HierarchyOffset, hierarchy.size() * sizeof(SceneHierarchy));
+	for (size_t type = 0; type < pools.size(); type++)
+	{
+		ScenePoolSection& section = header.Pools[type];
+		section.Count = static_cast<uint32_t>(pools[type].Entities.size());
+		section.Stride = pools[type].Stride;
+		reserveSection(section.EntityOffset, pools[type].Entities.size() * sizeof(uint32_t));
+		reserveSection(section.DataOffset, pools[type].Data.size());
+	}
+	reserveSection(header.ModelOffset, models.size() * sizeof(SceneString));
+	reserveSection(header.ShaderOffset, shaders.size() * sizeof(SceneString));
+	reserveSection(header.TextureOffset, textures.size() * sizeof(SceneTexture));
+	reserveSection(header.MaterialOffset, materials.size() * sizeof(SceneMaterial));
+	reserveSection(header.LightOffset, lights.size() * sizeof(SceneLight));
+	reserveSection(header.StringOffset, strings.GetBlob().size());
+
+	auto blob = std::vector<char>(size);
+	const auto copy = [&blob](const uint64_t offset, const void* data, const size_t bytes)
+	{
+		if (bytes)
+			std::memcpy(blob.data() + offset, data, bytes);
+	};
+
+	copy(0, &header, sizeof(header));
+	copy(header.TransformOffset, transforms.data(), transforms.size() * sizeof(TransformComponent));
+	copy(header.HierarchyOffset, hierarchy.data(), hierarchy.size() * sizeof(SceneHierarchy));
+	for (size_t type = 0; type < pools.size(); type++)
+	{
+		copy(header.Pools[type].EntityOffset, pools[type].Entities.data(), pools[type].Entities.size() * sizeof(uint32_t));
+		copy(header.Pools[type].DataOffset, pools[type].Data.data(), pools[type].Data.size());
+	}
+	copy(header.ModelOffset, models.data(), models.size() * sizeof(SceneString));
+	copy(header.ShaderOffset, shaders.data(), shaders.size() * sizeof(SceneString));
+	copy(header.TextureOffset, textures.data(), textures.size() * sizeof(SceneTexture));
+	copy(header.MaterialOffset, materials.data(), materials.size() * sizeof(SceneMaterial));
+	copy(header.LightOffset, lights.data(), lights.size() * sizeof(SceneLight));
+	copy(header.StringOffset, strings.GetBlob().data(), strings.GetBlob().size());
+
+	return blob;
+}
+
+bool SceneFile::Write(const std::string& path, Scene& scene)
+{
+	return Write(path, Serialize(scene));
+}
+
+bool SceneFile::Write(const std::string& path, const std::vector<char>& blob)
+{
+	std::ofstream fileStream(path, std::ios::binary | std::ios::trunc);
+	if (!fileStream)
+	{
+		LogError("SCENE_FILE: Could not open " + path + " for writing");
+		return false;
+	}
+
+	fileStream.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+	return static_cast<bool>(fileStream);
+}
+
+bool SceneFile::Load(const std::string& path, Scene& scene)
+{
+	SceneFileLoad load;
+	if (!load.Prepare(path))
+		return false;
+
+	load.Begin(scene);
+	load.Continue(scene, load.GetEntities().size());
+	load.ApplyLights(scene);
+	return true;
+}
+
+bool SceneFile::Load(const char* data, const size_t size, Scene& scene)
+{
+	SceneFileLoad load;
+	if (!load.Prepare(data, size))
+		return false;
+
+	load.Begin(scene);
+	load.Continue(scene, load.GetEntities().size());
+	load.ApplyLights(scene);
+	return true;
+}
+
+bool SceneFileLoad::Prepare(const std::string& path)
+{
+	if (!m_File.Open(path))
+		return false;
+
+	if (!Prepare(m_File.GetData(), m_File.GetSize()))
+	{
+		m_File.Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool SceneFileLoad::Prepare(const char* data, const size_t size)
+{
+	if (!SceneFile::Validate(data, size))
+		return false;
+
+	m_Data = data;
+	m_Header = reinterpret_cast<const SceneHeader*>(data);
+	m_MemoryCost = size;
+
+	// Textures are decoded and models opened in parallel, the cooked files are only imported again if their source changed
+	const auto* textures = Section<SceneTexture>(m_Header->TextureOffset);
+	std::vector<size_t> textureBytes(m_Header->TextureCount);
+	ThreadPool::Get().ParallelFor(textureBytes.size(), [this, textures, &textureBytes](const size_t i)
+		{ textureBytes[i] = g_AssetManager->PrefetchTexture(GetString(textures[i].Path)); });
+	for (const size_t bytes : textureBytes)
+		m_MemoryCost += bytes;
+
+	const auto* models = Section<SceneString>(m_Header->ModelOffset);
+	m_Models = std::vector<CookedModel>(m_Header->ModelCount);
+	m_ModelPaths = std::vector<std::shared_ptr<const std::string>>(m_Header->ModelCount);
+	ThreadPool::Get().ParallelFor(m_Models.size(), [this, models](const size_t i)
+	{
+		m_ModelPaths[i] = std::make_shared<const std::string>(GetString(models[i]));
+		if (!Model::OpenCooked(*m_ModelPaths[i], m_Models[i]))
+			LogError("SCENE_FILE: Could not load model " + *m_ModelPaths[i]);
+	});
+
+	// Entities placing the same mesh share one upload of it
+	const ScenePoolSection& meshPool = m_Header->Pools[static_cast<size_t>(ScenePool::ModelMesh)];
+	const auto* meshes = Section<SceneModelMesh>(meshPool.DataOffset);
+	m_Meshes = std::vector<std::vector<std::shared_ptr<const TriangleMeshComponent>>>(m_Models.size());
+	std::vector<std::vector<bool>> counted(m_Models.size());
+	for (size_t i = 0; i < m_Models.size(); i++)
+	{
+		m_Meshes[i].resize(m_Models[i].IsOpen() ? m_Models[i].GetHeader().MeshCount : 0);
+		counted[i].resize(m_Meshes[i].size());
+	}
+	for (uint32_t i = 0; i < meshPool.Count; i++)
+	{
+		const CookedModel& model = m_Models[meshes[i].Model];
+		if (meshes[i].Mesh >= m_Meshes[meshes[i].Model].size() || counted[meshes[i].Model][meshes[i].Mesh])
+			continue;
+		counted[meshes[i].Model][meshes[i].Mesh] = true;
+
+		const CookedMesh& mesh = model.GetMeshes()[meshes[i].Mesh];
+		m_MemoryCost += mesh.VertexCount * sizeof(Vertex) + mesh.IndexCount * sizeof(uint32_t);
+	}
+	m_MemoryCost += (m_Header->Pools[static_cast<size_t>(ScenePool::Cube)].Count + m_Header->Pools[static_cast<size_t>(ScenePool::Plane)].Count) * s_ShapeBytes;
+
+	return true;
+}
+
+void SceneFileLoad::Begin(Scene& scene)
+{
+	assert(m_Header && m_Entities.empty());
+	entt::registry& registry = scene.GetRegistry();
+
+	m_Entities.resize(m_Header->EntityCount);
+	registry.create(m_Entities.begin(), m_Entities.end());
+	const auto toEntity = [this](const uint32_t position) { return position == SceneHierarchy::s_None ? entt::entity(entt::null) : m_Entities[position]; };
+
+	// Every entity is a node of the transform hierarchy, and is complete as one before any other component is added
+	registry.insert<TransformComponent>(m_Entities.begin(), m_Entities.end(), Section<TransformComponent>(m_Header->TransformOffset));
+
+	const auto* savedHierarchy = Section<SceneHierarchy>(m_Header->HierarchyOffset);
+	std::vector<HierarchyComponent> hierarchy(m_Entities.size());
+	for (size_t i = 0; i < m_Entities.size(); i++)
+	{
+		const SceneHierarchy& node = savedHierarchy[i];
+		hierarchy[i] = { toEntity(node.Parent), toEntity(node.FirstChild), toEntity(node.PrevSibling), toEntity(node.NextSibling), node.Depth };
+	}
+	registry.insert<HierarchyComponent>(m_Entities.begin(), m_Entities.end(), hierarchy.begin());
+	registry.insert<WorldTransformComponent>(m_Entities.begin(), m_Entities.end());
+
+	// Children are rebuilt along with their roots
+	for (size_t i = 0; i < m_Entities.size(); i++)
+	{
+		if (savedHierarchy[i].Parent == SceneHierarchy::s_None)
+			scene.MarkTransformDirty(m_Entities[i]);
+	}
+
+	const auto* textures = Section<SceneTexture>(m_Header->TextureOffset);
+	m_Textures.resize(m_Header->TextureCount);
+	for (size_t i = 0; i < m_Textures.size(); i++)
+		m_Textures[i] = g_AssetManager->AcquireTexture(GetString(textures[i].Path), GetString(textures[i].Tag));
+
+	const auto* savedShaders = Section<SceneString>(m_Header->ShaderOffset);
+	std::vector<ShaderHandle> shaders(m_Header->ShaderCount);
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		// Unknown shaders fall back to the lit one
+		std::shared_ptr<Shader> shader = g_LitObjectShader;
+		const std::string name = GetString(savedShaders[i]);
+		for (const auto& named : s_Shaders)
+		{
+			if (name == named.Name)
+				shader = *named.Global;
+		}
+		shaders[i] = g_Resources->Shaders.Add(shader);
+	}
+
+	const auto* materials = Section<SceneMaterial>(m_Header->MaterialOffset);
+	m_Materials.resize(m_Header->MaterialCount);
+	for (size_t i = 0; i < m_Materials.size(); i++)
+	{
+		auto material = std::make_shared<Material>(shaders[materials[i].Shader], materials[i].Shininess);
+		material->SetShininess = materials[i].SetShininess != 0;
+		for (size_t map = 0; map < material->Maps.size(); map++)
+		{
+			const uint32_t texture = materials[i].Maps[map];
+			if (texture < m_Textures.size())
+				material->SetMap(static_cast<MaterialMap>(map), m_Textures[texture]);
+		}
+		material->BaseColorUVTransform = materials[i].BaseColorUVTransform;
+		if (materials[i].Maps[static_cast<size_t>(MaterialMap::BaseColor)] == SceneMaterial::s_PaletteTexture && g_ColorPalette)
+			material->SetBaseColor(*g_ColorPalette, materials[i].BaseColor);
+		m_Materials[i] = g_Resources->Materials.Add(std::move(material));
+	}
+}
+
+bool SceneFileLoad::Continue(Scene& scene, const size_t count)
+{
+	assert(m_Header && m_Entities.size() == m_Header->EntityCount);
+	entt::registry& registry = scene.GetRegistry();
+	const size_t end = std::min(m_NextEntity + count, m_Entities.size());
+
+	// Pools list their entities in ascending order, so each batch is the next run of every pool
+	const auto gather = [this, end](const ScenePool type, uint32_t& first) -> const std::vector<entt::entity>&
+	{
+		const ScenePoolSection& pool = m_Header->Pools[static_cast<size_t>(type)];
+		const auto* positions = Section<uint32_t>(pool.EntityOffset);
+		uint32_t& cursor = m_PoolCursors[static_cast<size_t>(type)];
+		first = cursor;
+		m_Batch.clear();
+		for (; cursor < pool.Count && positions[cursor] < end; cursor++)
+			m_Batch.emplace_back(m_Entities[positions[cursor]]);
+		return m_Batch;
+	};
+	const auto poolData = [this](const ScenePool type) { return m_Data + m_Header->Pools[static_cast<size_t>(type)].DataOffset; };
+	uint32_t first = 0;
+
+	{
+		const auto& tagged = gather(ScenePool::Tag, first);
+		const auto* saved = reinterpret_cast<const SceneString*>(poolData(ScenePool::Tag)) + first;
+		std::vector<TagComponent> tags;
+		tags.reserve(tagged.size());
+		for (size_t i = 0; i < tagged.size(); i++)
+			tags.emplace_back(GetString(saved[i]));
+		registry.insert<TagComponent>(tagged.begin(), tagged.end(), std::make_move_iterator(tags.begin()));
+	}
+
+	{
+		const auto& textured = gather(ScenePool::Material, first);
+		const auto* saved = reinterpret_cast<const uint32_t*>(poolData(ScenePool::Material)) + first;
+		std::vector<MaterialComponent> components;
+		components.reserve(textured.size());
+		for (size_t i = 0; i < textured.size(); i++)
+			components.emplace_back(m_Materials[saved[i]]);
+		registry.insert<MaterialComponent>(textured.begin(), textured.end(), components.begin());
+	}
+
+	// Meshes own their GL objects and can't be copied, so they're built in place one by one
+	for (const auto entity : gather(ScenePool::Cube, first))
+		registry.emplace<CubeComponent>(entity);
+	for (const auto entity : gather(ScenePool::Plane, first))
+		registry.emplace<PlaneComponent>(entity);
+
+	{
+		// Model meshes upload straight from the cooked files, once per mesh however many entities place it
+		const auto& meshEntities = gather(ScenePool::ModelMesh, first);
+		const auto* saved = reinterpret_cast<const SceneModelMesh*>(poolData(ScenePool::ModelMesh)) + first;
+		for (size_t i = 0; i < meshEntities.size(); i++)
+		{
+			registry.emplace<ModelComponent>(meshEntities[i], std::weak_ptr<Model>(), m_ModelPaths[saved[i].Model], saved[i].Mesh);
+			if (saved[i].Mesh >= m_Meshes[saved[i].Model].size())
+				continue;
+
+			auto& shared = m_Meshes[saved[i].Model][saved[i].Mesh];
+			if (!shared)
+			{
+				const CookedModel& model = m_Models[saved[i].Model];
+				const CookedMesh& mesh = model.GetMeshes()[saved[i].Mesh];
+				shared = std::make_shared<const TriangleMeshComponent>(model.GetVertices() + mesh.FirstVertex, mesh.VertexCount,
+					model.GetIndices() + mesh.FirstIndex, mesh.IndexCount);
+			}
+			registry.emplace<SharedMeshComponent>(meshEntities[i], shared);
+		}
+	}
+
+	const auto& statics = gather(ScenePool::StaticShadowCaster, first);
+	registry.insert<StaticShadowCasterComponent>(statics.begin(), statics.end());
+
+	const auto& renderables = gather(ScenePool::Renderable, first);
+	registry.insert<RenderableTag>(renderables.begin(), renderables.end());
+
+	m_NextEntity = end;
+	if (!IsComplete())
+		return false;
+
+	// Everything is on its way to the GPU, so the cooked models are no longer needed
+	m_Models = std::vector<CookedModel>();
+	m_Meshes = std::vector<std::vector<std::shared_ptr<const TriangleMeshComponent>>>();
+	return true;
+}
+
+void SceneFileLoad::ApplyLights(Scene& scene) const
+{
+	assert(m_Header);
+	SceneData& sceneData = scene.m_SceneData;
+	sceneData.PointLights = std::make_shared<std::vector<PointLight>>();
+	sceneData.PointLights->reserve(m_Header->LightCount);
+	sceneData.Sun.reset();
+	sceneData.Flashlight.reset();
+
+	const auto* lights = Section<SceneLight>(m_Header->LightOffset);
+	for (uint32_t i = 0; i < m_Header->LightCount; i++)
+	{
+		const SceneLight& saved = lights[i];
+		const auto restore = [&saved](Light& light)
+		{
+			light.SetColor(saved.Color);
+			light.SetCoeffs(saved.KA, saved.KD, saved.KS);
+		};
+
+		if (saved.Type == SceneLightType::Point)
+		{
+			PointLight& point = sceneData.PointLights->emplace_back(saved.Position);
+			restore(point);
+			point.m_Distance = saved.Distance;
+			point.m_Constant = saved.Constant;
+			point.m_Linear = saved.Linear;
+			point.m_Quadratic = saved.Quadratic;
+		}
+		else if (saved.Type == SceneLightType::Sun)
+		{
+			sceneData.Sun = std::make_shared<DirectionalLight>(saved.Direction);
+			restore(*sceneData.Sun);
+		}
+		else
+		{
+			sceneData.Flashlight = std::make_shared<SpotLight>();
+			SpotLight& spot = *sceneData.Flashlight;
+			restore(spot);
+			spot.Update(saved.Position, saved.Direction);
+			spot.m_Distance = saved.Distance;
+			spot.m_Constant = saved.Constant;
+			spot.m_Linear = saved.Linear;
+			spot.m_Quadratic = saved.Quadratic;
+			spot.m_InnerCutOff = saved.InnerCutOff;
+			spot.m_OuterCutOff = saved.OuterCutOff;
+		}
+	}
+}
+
+std::string SceneFileLoad::GetString(const SceneString string) const
+{
+	return { m_Data + m_Header->StringOffset + string.Offset, string.Length };
+}
+
+bool SceneFile::Validate(const char* data, const size_t size)
+{
+	if (size < sizeof(SceneHeader))
+		return false;
+
+	const auto& header = *reinterpret_cast<const SceneHeader*>(data);
+	if (std::memcmp(header.Magic, s_Magic, sizeof(s_Magic)) != 0 || header.Version != s_Version)
+		return false;
+
+	bool inBounds = InBounds<TransformComponent>(header.TransformOffset, header.EntityCount, size)
+		&& InBounds<SceneHierarchy>(header.HierarchyOffset, header.EntityCount, size)
+		&& InBounds<SceneString>(header.ModelOffset, header.ModelCount, size)
+		&& InBounds<SceneString>(header.ShaderOffset, header.ShaderCount, size)
+		&& InBounds<SceneTexture>(header.TextureOffset, header.TextureCount, size)
+		&& InBounds<SceneMaterial>(header.MaterialOffset, header.MaterialCount, size)
+		&& InBounds<SceneLight>(header.LightOffset, header.LightCount, size)
+		&& InBounds<char>(header.StringOffset, header.StringSize, size);
+	for (size_t type = 0; type < static_cast<size_t>(ScenePool::Count); type++)
+	{
+		const ScenePoolSection& pool = header.Pools[type];
+		inBounds = inBounds && pool.Stride == (pool.Count ? s_PoolStrides[type] : pool.Stride)
+			&& InBounds<uint32_t>(pool.EntityOffset, pool.Count, size)
+			&& (s_PoolStrides[type] == 0 || InBounds<char>(pool.DataOffset, static_cast<uint64_t>(pool.Count) * s_PoolStrides[type], size));
+	}
+	if (!inBounds)
+	{
+		LogError("SCENE_FILE: Section out of bounds");
+		return false;
+	}
+
+	const auto stringInBounds = [&header](const SceneString string)
+		{ return static_cast<uint64_t>(string.Offset) + string.Length <= header.StringSize; };
+	const auto entityInBounds = [&header](const uint32_t position)
+		{ return position == SceneHierarchy::s_None || position < header.EntityCount; };
+
+	const auto* hierarchy = reinterpret_cast<const SceneHierarchy*>(data + header.HierarchyOffset);
+	for (uint32_t i = 0; i < header.EntityCount; i++)
+	{
+		if (!entityInBounds(hierarchy[i].Parent) || !entityInBounds(hierarchy[i].FirstChild)
+			|| !entityInBounds(hierarchy[i].PrevSibling) || !entityInBounds(hierarchy[i].NextSibling))
+		{
+			LogError("SCENE_FILE: Hierarchy link out of bounds");
+			return false;
+		}
+	}
+
+	// Every child is listed once by its parent, one level below it, so walking the hierarchy always ends and its depth
+	// never exceeds the entity count
+	constexpr uint32_t none = SceneHierarchy::s_None;
+	std::vector<bool> listed(header.EntityCount, false);
+	bool linked = true;
+	for (uint32_t i = 0; i < header.EntityCount && linked; i++)
+	{
+		const SceneHierarchy& node = hierarchy[i];
+		if (node.Parent == none)
+			linked = node.Depth == 0 && node.PrevSibling == none && node.NextSibling == none;
+
+		uint32_t previous = none;
+		for (uint32_t child = node.FirstChild; linked && child != none; child = hierarchy[child].NextSibling)
+		{
+			const SceneHierarchy& childNode = hierarchy[child];
+			linked = !listed[child] && childNode.Parent == i && childNode.PrevSibling == previous && childNode.Depth == node.Depth + 1;
+			listed[child] = true;
+			previous = child;
+		}
+	}
+	for (uint32_t i = 0; i < header.EntityCount && linked; i++)
+		linked = listed[i] == (hierarchy[i].Parent != none);
+	if (!linked)
+	{
+		LogError("SCENE_FILE: Hierarchy links inconsistent");
+		return false;
+	}
+
+	// Strictly ascending, which loads rely on to add entities in batches and which rules out adding a component twice
+	for (size_t type = 0; type < static_cast<size_t>(ScenePool::Count); type++)
+	{
+		const ScenePoolSection& pool = header.Pools[type];
+		const auto* positions = reinterpret_cast<const uint32_t*>(data + pool.EntityOffset);
+		for (uint32_t i = 0; i < pool.Count; i++)
+		{
+			if (positions[i] >= header.EntityCount || (i > 0 && positions[i] <= positions[i - 1]))
+			{
+				LogError("SCENE_FILE: Pool entities out of bounds or out of order");
+				return false;
+			}
+		}
+	}
+
+	const auto pool = [&header, data](const ScenePool type, const uint32_t i)
+		{ return data + header.Pools[static_cast<size_t>(type)].DataOffset + static_cast<uint64_t>(i) * s_PoolStrides[static_cast<size_t>(type)]; };
+
+	bool valid = true;
+	for (uint32_t i = 0; i < header.Pools[static_cast<size_t>(ScenePool::Tag)].Count; i++)
+		valid = valid && stringInBounds(*reinterpret_cast<const SceneString*>(pool(ScenePool::Tag, i)));
+	for (uint32_t i = 0; i < header.Pools[static_cast<size_t>(ScenePool::Material)].Count; i++)
+		valid = valid && *reinterpret_cast<const uint32_t*>(pool(ScenePool::Material, i)) < header.MaterialCount;
+	for (uint32_t i = 0; i < header.Pools[static_cast<size_t>(ScenePool::ModelMesh)].Count; i++)
+		valid = valid && reinterpret_cast<const SceneModelMesh*>(pool(ScenePool::ModelMesh, i))->Model < header.ModelCount;
+
+	const auto* models = reinterpret_cast<const SceneString*>(data + header.ModelOffset);
+	for (uint32_t i = 0; i < header.ModelCount; i++)
+		valid = valid && stringInBounds(models[i]);
+	const auto* shaders = reinterpret_cast<const SceneString*>(data + header.ShaderOffset);
+	for (uint32_t i = 0; i < header.ShaderCount; i++)
+		valid = valid && stringInBounds(shaders[i]);
+	const auto* textures = reinterpret_cast<const SceneTexture*>(data + header.TextureOffset);
+	for (uint32_t i = 0; i < header.TextureCount; i++)
+		valid = valid && stringInBounds(textures[i].Path) && stringInBounds(textures[i].Tag);
+	const auto* materials = reinterpret_cast<const SceneMaterial*>(data + header.MaterialOffset);
+	for (uint32_t i = 0; i < header.MaterialCount; i++)
+		valid = valid && materials[i].Shader < header.ShaderCount;
+	const auto* lights = reinterpret_cast<const SceneLight*>(data + header.LightOffset);
+	for (uint32_t i = 0; i < header.LightCount; i++)
+		valid = valid && lights[i].Type <= SceneLightType::Flashlight;
+
+	if (!valid)
+		LogError("SCENE_FILE: Reference out of bounds");
+	return valid;
+}
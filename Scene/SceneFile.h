@@ -0,0 +1,196 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include "entt\include\entt.hpp"
+#include "Components\MaterialComponent.h"
+#include "Components\Texture.h"
+#include "CookedModel.h"
+#include "MappedFile.h"
+
+class Scene;
+struct TriangleMeshComponent;
+
+/* Scene file format
+* A single little-endian file holding a scene's entities as one contiguous array per component pool, so loading is a
+* bulk insert per pool rather than a walk over entities. Entities refer to each other by their position in the file.
+* Every entity has a transform and a hierarchy node, stored in entity order. Optional components are stored as a list
+* of entity positions, ascending, followed by their data if they have any.
+* Resources are stored as references: cubes and planes by kind, model meshes by model path and cooked mesh index,
+* textures by file, shaders by the name of their global, and palette base colors by color.
+* Every section starts on a 16 byte boundary, like the cooked model format.
+*/
+
+// Optional components, in the order they are inserted when loading
+enum class ScenePool : uint32_t
+{
+	Tag,
+	Material,
+	Cube,
+	Plane,
+	ModelMesh,
+	StaticShadowCaster,
+	Renderable, // Last, so the meshes are in place when render proxies are created
+	Count
+};
+
+struct SceneString
+{
+	uint32_t Offset, Length; // Into the string blob
+};
+
+struct ScenePoolSection
+{
+	uint32_t Count;
+	uint32_t Stride; // Bytes per element of the data array, 0 for components without data
+	uint64_t EntityOffset; // Entity positions, uint32_t each
+	uint64_t DataOffset;
+};
+
+struct SceneHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	uint32_t EntityCount, ModelCount, ShaderCount, TextureCount, MaterialCount, LightCount;
+	uint64_t TransformOffset, HierarchyOffset;
+	uint64_t ModelOffset, ShaderOffset, TextureOffset, MaterialOffset, LightOffset;
+	uint64_t StringOffset, StringSize;
+	ScenePoolSection Pools[static_cast<size_t>(ScenePool::Count)];
+};
+
+struct SceneHierarchy
+{
+	uint32_t Parent, FirstChild, PrevSibling, NextSibling; // Entity positions, s_None for no entity
+	uint32_t Depth;
+
+	static constexpr uint32_t s_None = 0xFFFFFFFF;
+};
+
+struct SceneModelMesh
+{
+	uint32_t Model;
+	uint32_t Mesh;
+};
+
+struct SceneTexture
+{
+	SceneString Path;
+	SceneString Tag;
+};
+
+struct SceneMaterial
+{
+	glm::vec4 BaseColorUVTransform;
+	glm::vec4 BaseColor; // Only used by palette base colors
+	uint32_t Shader;
+	uint32_t Maps[static_cast<size_t>(MaterialMap::Count)]; // A texture index, s_NoTexture or s_PaletteTexture
+	float Shininess;
+	uint32_t SetShininess;
+
+	static constexpr uint32_t s_NoTexture = 0xFFFFFFFF;
+	static constexpr uint32_t s_PaletteTexture = 0xFFFFFFFE;
+};
+
+enum class SceneLightType : uint32_t
+{
+	Point,
+	Sun,
+	Flashlight
+};
+
+struct SceneLight
+{
+	glm::vec4 Color;
+	glm::vec4 Position;
+	glm::vec3 Direction;
+	SceneLightType Type;
+	float KA, KD, KS;
+	float Distance, Constant, Linear, Quadratic;
+	float InnerCutOff, OuterCutOff;
+};
+
+class SceneFile
+{
+public:
+	// Serializes every entity with a transform, along with the scene's lights. Skyboxes and triangle meshes that don't
+	// come from a model are left out, as they have nothing to refer to them by
+	static std::vector<char> Serialize(Scene& scene);
+	// Serializes only the given entities, which should be whole subtrees. Links to anything else are dropped
+	static std::vector<char> Serialize(Scene& scene, const std::vector<entt::entity>& entities, bool includeLights);
+	// Serializes the scene and writes it to path
+	static bool Write(const std::string& path, Scene& scene);
+	static bool Write(const std::string& path, const std::vector<char>& blob);
+
+	// Maps a scene file and adds its entities to scene, replacing the scene's lights. Nothing is added if the file
+	// is missing or malformed. Creates meshes and textures, so it has to run on the GL thread
+	static bool Load(const std::string& path, Scene& scene);
+	// Adds the entities of an in-memory scene file to scene
+	static bool Load(const char* data, size_t size, Scene& scene);
+
+	// Checks the header and that every section and reference lies within the file
+	static bool Validate(const char* data, size_t size);
+
+public:
+	static constexpr uint32_t s_Version = 2;
+};
+
+/* A scene file added to a scene in steps, so large files can stream in without stalling a frame.
+* Prepare maps and checks the file, decodes its textures into the asset manager and opens its models without touching the registry or GL,
+* so it can run on a worker. Begin then creates every entity as a complete node of the transform hierarchy, along with
+* the textures and materials, and Continue adds the remaining components a batch of entities at a time.
+* Both have to run on the GL thread with nothing else touching the registry.
+*/
+class SceneFileLoad
+{
+public:
+	SceneFileLoad() = default;
+	SceneFileLoad(const SceneFileLoad&) = delete;
+	SceneFileLoad& operator=(const SceneFileLoad&) = delete;
+
+	// Maps a scene file. Fails if it is missing or malformed
+	bool Prepare(const std::string& path);
+	// Reads an in-memory scene file, which has to outlive the load
+	bool Prepare(const char* data, size_t size);
+
+	void Begin(Scene& scene);
+	// Adds the components of up to count more entities. Returns true once every entity is complete
+	bool Continue(Scene& scene, size_t count);
+	// Replaces the scene's lights with the file's
+	void ApplyLights(Scene& scene) const;
+
+	bool IsComplete() const { return m_Header && m_NextEntity == m_Header->EntityCount; }
+	const std::vector<entt::entity>& GetEntities() const { return m_Entities; }
+	const std::vector<MaterialHandle>& GetMaterials() const { return m_Materials; }
+	// Rough bytes of CPU and GPU memory the file's contents add once loaded, textures already resident aside
+	size_t GetMemoryCost() const { return m_MemoryCost; }
+
+private:
+	template<typename T>
+	const T* Section(const uint64_t offset) const { return reinterpret_cast<const T*>(m_Data + offset); }
+	std::string GetString(SceneString string) const;
+
+private:
+	MappedFile m_File;
+	const char* m_Data = nullptr;
+	const SceneHeader* m_Header = nullptr;
+	size_t m_MemoryCost = 0;
+
+	std::vector<CookedModel> m_Models;
+	std::vector<std::shared_ptr<const std::string>> m_ModelPaths;
+	std::vector<std::vector<std::shared_ptr<const TriangleMeshComponent>>> m_Meshes; // Per model and cooked mesh, uploaded on first use
+
+	std::vector<entt::entity> m_Entities;
+	std::vector<TextureReference> m_Textures; // Decoded into the asset manager by Prepare, acquired by Begin
+	std::vector<MaterialHandle> m_Materials;
+	std::array<uint32_t, static_cast<size_t>(ScenePool::Count)> m_PoolCursors = {}; // Next element of each pool
+	size_t m_NextEntity = 0; // Entities before this one have all of their components
+	std::vector<entt::entity> m_Batch;
+
+	static constexpr size_t s_ShapeBytes = 24 * sizeof(Vertex) + 36 * sizeof(uint32_t); // Cube or plane mesh
+};
@@ -0,0 +1,173 @@
+#include "StaticBatcher.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "..\utils.h"
+#include "Model.h"
+#include "Scene.h"
+#include "TangentGenerator.h"
+#include "Components\ModelComponent.h"
+#include "Components\StaticShadowCasterComponent.h"
+#include "Components\TagComponent.h"
+#include "Components\TransformComponent.h"
+#include "Components\Renderable\MeshRendererComponent.h"
+#include "Components\Renderable\SharedMeshComponent.h"
+#include "Components\Renderable\StaticBatchComponent.h"
+#include "Components\Renderable\TriangleMeshComponent.h"
+
+namespace
+{
+	struct BatchMember
+	{
+		entt::entity Entity = entt::null;
+		const CookedModel* Cooked = nullptr;
+		const CookedMesh* Mesh = nullptr;
+		glm::vec3 Center = glm::vec3(0.0f); // Of its world bounds
+	};
+
+	// Merges members into one mesh in world space and swaps their own meshes for it
+	void AddBatch(entt::registry& registry, const MaterialHandle material, const std::vector<BatchMember>& members)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		auto ranges = std::make_shared<std::vector<StaticBatchRange>>();
+		ranges->reserve(members.size());
+		for (const BatchMember& member : members)
+		{
+			const auto& transform = registry.get<WorldTransformComponent>(member.Entity);
+			const Vertex* source = member.Cooked->GetVertices() + member.Mesh->FirstVertex;
+			const uint32_t* sourceIndices = member.Cooked->GetIndices() + member.Mesh->FirstIndex;
+			const uint32_t base = static_cast<uint32_t>(vertices.size());
+			// A mirroring transform turns triangles inside out and flips their bitangents, so both are flipped back
+			const bool mirrored = glm::determinant(glm::mat3(transform.World)) < 0.0f;
+
+			Bounds bounds{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+			for (uint32_t i = 0; i < member.Mesh->VertexCount; i++)
+			{
+				Vertex vertex = source[i];
+				vertex.Position = transform.World * glm::vec4(glm::vec3(vertex.Position), 1.0f);
+				vertex.Normal = glm::normalize(transform.Normal * vertex.Normal);
+				glm::vec3 normal, tangent;
+				float bitangentSign = 1.0f;
+				TangentGenerator::UnpackFrame(vertex.TangentFrame, normal, tangent, bitangentSign);
+				vertex.TangentFrame = TangentGenerator::PackFrame(vertex.Normal, glm::mat3(transform.World) * tangent,
+					mirrored ? -bitangentSign : bitangentSign);
+				bounds.Min = glm::min(bounds.Min, glm::vec3(vertex.Position));
+				bounds.Max = glm::max(bounds.Max, glm::vec3(vertex.Position));
+				vertices.push_back(vertex);
+			}
+
+			const uint32_t firstIndex = static_cast<uint32_t>(indices.size());
+			for (uint32_t i = 0; i + 2 < member.Mesh->IndexCount; i += 3)
+			{
+				indices.push_back(base + sourceIndices[i]);
+				indices.push_back(base + sourceIndices[mirrored ? i + 2 : i + 1]);
+				indices.push_back(base + sourceIndices[mirrored ? i + 1 : i + 2]);
+			}
+			ranges->push_back({ firstIndex, static_cast<uint32_t>(indices.size()) - firstIndex, bounds });
+		}
+
+		// Not a hierarchy node, its identity world transform is never touched by propagation
+		const entt::entity batch = registry.create();
+		registry.emplace<WorldTransformComponent>(batch);
+		registry.emplace<TagComponent>(batch, "Static Batch");
+		auto& mesh = registry.emplace<StaticBatchComponent>(batch);
+		mesh.SetVAO(vertices, indices);
+		mesh.Ranges = std::move(ranges);
+		registry.emplace<MaterialComponent>(batch, material);
+		registry.emplace<StaticShadowCasterComponent>(batch);
+		registry.emplace<RenderableTag>(batch);
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(members.size()); i++)
+		{
+			registry.remove<RenderableTag, TriangleMeshComponent, SharedMeshComponent>(members[i].Entity);
+			registry.emplace<StaticBatchMemberComponent>(members[i].Entity, batch, i);
+		}
+	}
+}
+
+size_t StaticBatcher::Build(Scene& scene, const float cellSize)
+{
+	assert(cellSize > 0.0f);
+	entt::registry& registry = scene.GetRegistry();
+
+	// Members are grouped by material, then by the cell holding the centre of their bounds
+	using GroupKey = std::tuple<uint32_t, int, int, int>;
+	std::map<GroupKey, std::vector<BatchMember>> groups;
+	std::unordered_map<std::string, std::unique_ptr<CookedModel>> models; // Null for models that couldn't be opened
+	const auto statics = registry.view<const StaticShadowCasterComponent, const ModelComponent, const MaterialComponent,
+		const MeshRendererComponent, const WorldTransformComponent>();
+	for (const auto entity : statics)
+	{
+		const auto& model = statics.get<const ModelComponent>(entity);
+		if (!model.SourcePath || !registry.any_of<TriangleMeshComponent, SharedMeshComponent>(entity))
+			continue;
+
+		auto [iterator, added] = models.try_emplace(*model.SourcePath);
+		if (added)
+		{
+			auto cooked = std::make_unique<CookedModel>();
+			if (Model::OpenCooked(*model.SourcePath, *cooked))
+				iterator->second = std::move(cooked);
+			else
+				LogError("STATIC_BATCHER: Could not open " + *model.SourcePath);
+		}
+		const CookedModel* cooked = iterator->second.get();
+		if (!cooked || model.MeshIndex >= cooked->GetHeader().MeshCount)
+			continue;
+
+		const auto& mesh = statics.get<const MeshRendererComponent>(entity);
+		const auto& transform = statics.get<const WorldTransformComponent>(entity);
+		const Bounds bounds = Bounds{ mesh.BoundsMin, mesh.BoundsMax }.Transformed(transform.World);
+		const glm::vec3 center = (bounds.Min + bounds.Max) * 0.5f;
+		const glm::ivec3 cell = glm::ivec3(glm::floor(center / cellSize));
+		const GroupKey key(statics.get<const MaterialComponent>(entity).Material.Value, cell.x, cell.y, cell.z);
+		groups[key].push_back({ entity, cooked, cooked->GetMeshes() + model.MeshIndex, center });
+	}
+
+	size_t batches = 0;
+	for (auto& [key, members] : groups)
+	{
+		if (members.size() < 2)
+			continue;
+
+		// Neighbours end up next to each other in the index buffer, so what a light reaches draws in fewer ranges
+		std::sort(members.begin(), members.end(), [](const BatchMember& a, const BatchMember& b)
+			{ return std::tie(a.Center.z, a.Center.x, a.Center.y) < std::tie(b.Center.z, b.Center.x, b.Center.y); });
+
+		const MaterialHandle material = registry.get<MaterialComponent>(members.front().Entity).Material;
+		std::vector<BatchMember> batch;
+		uint64_t batchVertices = 0;
+		const auto flush = [&]()
+		{
+			if (batch.size() > 1)
+			{
+				AddBatch(registry, material, batch);
+				batches++;
+			}
+			batch.clear();
+			batchVertices = 0;
+		};
+
+		for (const BatchMember& member : members)
+		{
+			if (!batch.empty() && batchVertices + member.Mesh->VertexCount > s_MaxBatchVertices)
+				flush();
+			batch.push_back(member);
+			batchVertices += member.Mesh->VertexCount;
+		}
+		flush();
+	}
+
+	Log("STATIC_BATCHER: Merged static meshes into " + std::to_string(batches) + " batches");
+	return batches;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class Scene;
+
+/* Merges static meshes that share a material and sit in the same cell of a grid into one mesh per material and cell,
+* so the main pass draws each group with a single call instead of one per mesh.
+* Merged vertices are moved into world space, and every merged mesh keeps its range of indices and its bounds, so shadow
+* passes still only draw the ones within a light's reach. Meshes are read back from their cooked models, so only model
+* meshes on entities marked static are merged. Those entities stay in the scene without a mesh of their own, and are
+* saved as the meshes they were. Batches are not part of the transform hierarchy, so saving the scene or building world
+* cells leaves them out. Destroying a merged entity drops its triangles from the batch, and the batch goes with its last
+* member, but moving one leaves its triangles where they were.
+*/
+class StaticBatcher
+{
+public:
+	// Merges the scene's static meshes and returns the number of batches made. Creates GL objects and reads world
+	// transforms, so run it on the GL thread once transforms are current, e.g. from an exclusive system
+	static size_t Build(Scene& scene, float cellSize);
+
+	inline static uint32_t s_MaxBatchVertices = 1 << 20; // Groups larger than this are split over several batches
+};
@@ -0,0 +1,61 @@
+#include "SystemScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Scene.h"
+#include "..\ThreadPool.h"
+
+void SystemScheduler::Run(Scene& scene)
+{
+	auto& pool = ThreadPool::Get();
+
+	// Everything a system might view has to exist before any worker looks at the registry
+	for (const auto& system : m_Systems)
+		system.AssureStorage(scene.GetRegistry());
+
+	std::vector<JobHandle> jobs;
+	jobs.reserve(m_Systems.size());
+	for (size_t i = 0; i < m_Systems.size(); i++)
+	{
+		std::vector<JobHandle> dependencies;
+		for (size_t earlier = 0; earlier < i; earlier++)
+		{
+			if (Conflicts(m_Systems[earlier], m_Systems[i]))
+				dependencies.emplace_back(jobs[earlier]);
+		}
+
+		auto task = [this, &scene, i]
+		{
+			const auto start = std::chrono::steady_clock::now();
+			m_Systems[i].Function(scene);
+			m_Timings[i].Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		};
+
+		jobs.emplace_back(m_Systems[i].Affinity == SystemAffinity::Worker
+			? pool.Submit(std::move(task), dependencies)
+			: pool.SubmitToMainThread(std::move(task), dependencies));
+	}
+
+	// Waiting on the main thread also runs the main thread systems as they become ready. From any other thread
+	// they run when the main thread next drains its jobs
+	for (const auto& job : jobs)
+		pool.Wait(job);
+}
+
+bool SystemScheduler::Conflicts(const System& earlier, const System& later)
+{
+	if (earlier.Affinity == SystemAffinity::Exclusive || later.Affinity == SystemAffinity::Exclusive)
+		return true;
+
+	// Both issue GL commands, whose order matters even when the components don't overlap
+	if (earlier.Affinity == SystemAffinity::MainThread && later.Affinity == SystemAffinity::MainThread)
+		return true;
+
+	const auto overlaps = [](const std::vector<entt::id_type>& a, const std::vector<entt::id_type>& b)
+		{ return std::any_of(a.begin(), a.end(), [&b](const entt::id_type id) { return std::find(b.begin(), b.end(), id) != b.end(); }); };
+
+	return overlaps(earlier.Writes, later.Reads)
+		|| overlaps(earlier.Writes, later.Writes)
+		|| overlaps(earlier.Reads, later.Writes);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "entt\include\entt.hpp"
+
+class Scene;
+
+// Component lists a system declares it reads or writes, e.g. Reads<TransformComponent>()
+template<typename... Components>
+struct Reads {};
+template<typename... Components>
+struct Writes {};
+
+// Where a system is allowed to run
+enum class SystemAffinity
+{
+	Worker, // Any worker thread, alongside other systems that don't conflict with it
+	MainThread, // The job system's main thread, which owns the GL context. Main thread systems run one after another in registration order
+	Exclusive // The main thread with no other system running, for systems that create or destroy entities and components
+};
+
+struct SystemTiming
+{
+	std::string Name;
+	double Milliseconds = 0.0;
+};
+
+/* Runs a scene's systems every frame, in parallel wherever their declared component access allows.
+* Two systems conflict when one writes a component the other reads or writes. Each frame a dependency graph is
+* built in which every system waits for the earlier registered systems it conflicts with, so results always match
+* running the systems one by one in registration order. Systems that don't conflict overlap on the job system.
+* Non-exclusive systems must not add or remove components, since entt storages are only safe to share while
+* their structure stays fixed.
+*/
+class SystemScheduler
+{
+public:
+	using SystemFunction = std::function<void(Scene&)>;
+
+	template<typename... Read, typename... Write>
+	void AddSystem(std::string name, Reads<Read...>, Writes<Write...>, SystemFunction function,
+		SystemAffinity affinity = SystemAffinity::Worker);
+
+	// Runs every system once and returns when all have finished. May be called from any thread outside the job system;
+	// from anywhere but the main thread, main thread systems wait for it to drain its jobs
+	void Run(Scene& scene);
+
+	// How long each system took during the last Run, in registration order
+	const std::vector<SystemTiming>& GetTimings() const { return m_Timings; }
+
+private:
+	struct System
+	{
+		std::string Name;
+		std::vector<entt::id_type> Reads, Writes;
+		SystemAffinity Affinity = SystemAffinity::Worker;
+		SystemFunction Function;
+		// Creates the storages the system touches up front, so views built on workers never modify the registry
+		std::function<void(entt::registry&)> AssureStorage;
+	};
+
+	static bool Conflicts(const System& earlier, const System& later);
+
+private:
+	std::vector<System> m_Systems;
+	std::vector<SystemTiming> m_Timings;
+};
+
+template<typename... Read, typename... Write>
+void SystemScheduler::AddSystem(std::string name, Reads<Read...>, Writes<Write...>, SystemFunction function,
+	const SystemAffinity affinity)
+{
+	System system;
+	system.Name = std::move(name);
+	system.Reads = { entt::type_hash<Read>::value()... };
+	system.Writes = { entt::type_hash<Write>::value()... };
+	system.Affinity = affinity;
+	system.Function = std::move(function);
+	system.AssureStorage = [](entt::registry& registry)
+	{
+		(registry.storage<Read>(), ...);
+		(registry.storage<Write>(), ...);
+	};
+
+	m_Systems.emplace_back(std::move(system));
+	m_Timings.push_back({ m_Systems.back().Name, 0.0 });
+}
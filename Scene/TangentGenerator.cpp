@@ -0,0 +1,133 @@
+#include "TangentGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm\gtc\quaternion.hpp>
+
+namespace
+{
+	constexpr float s_SnormScale = 32767.0f;
+
+	// A direction perpendicular to the normal, for vertices whose triangles give no usable tangent
+	glm::vec3 AnyPerpendicular(const glm::vec3& normal)
+	{
+		const glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		return glm::normalize(axis - normal * glm::dot(normal, axis));
+	}
+
+	glm::vec3 ProjectOntoPlane(const glm::vec3& vector, const glm::vec3& normal)
+	{
+		return vector - normal * glm::dot(normal, vector);
+	}
+
+	glm::vec3 SafeNormalize(const glm::vec3& vector, const glm::vec3& fallback)
+	{
+		const float length = glm::length(vector);
+		return length > 1e-20f ? vector / length : fallback;
+	}
+}
+
+size_t TangentGenerator::Generate(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	const size_t originalCount = vertices.size();
+
+	// Tangents are summed per vertex and orientation, a mirrored corner lands in a copy of its vertex
+	std::vector<glm::vec3> sums(originalCount * 2, glm::vec3(0.0f));
+	std::vector<uint8_t> used(originalCount * 2, 0);
+	std::vector<uint8_t> mirroredCorners(indices.size(), 0);
+
+	for (size_t triangle = 0; triangle + 2 < indices.size(); triangle += 3)
+	{
+		const uint32_t corners[3] = { indices[triangle], indices[triangle + 1], indices[triangle + 2] };
+		const glm::vec3 p0 = glm::vec3(vertices[corners[0]].Position);
+		const glm::vec2 uv0 = vertices[corners[0]].TexCoord;
+		const glm::vec3 edge1 = glm::vec3(vertices[corners[1]].Position) - p0, edge2 = glm::vec3(vertices[corners[2]].Position) - p0;
+		const glm::vec2 uvEdge1 = vertices[corners[1]].TexCoord - uv0, uvEdge2 = vertices[corners[2]].TexCoord - uv0;
+
+		// The direction u grows in. Only its direction matters, so it is flipped instead of divided by the mapping's
+		// signed area. Triangles without an area in texture space have none, and leave their vertices to the others
+		const float signedArea = uvEdge1.x * uvEdge2.y - uvEdge1.y * uvEdge2.x;
+		if (std::abs(signedArea) < 1e-20f)
+			continue;
+		const bool mirrored = signedArea < 0.0f;
+		const glm::vec3 faceTangent = SafeNormalize(uvEdge2.y * edge1 - uvEdge1.y * edge2, glm::vec3(0.0f)) * (mirrored ? -1.0f : 1.0f);
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const uint32_t vertex = corners[corner];
+			const glm::vec3 normal = SafeNormalize(vertices[vertex].Normal, glm::vec3(0.0f, 0.0f, 1.0f));
+			const glm::vec3 position = glm::vec3(vertices[vertex].Position);
+
+			// The corner's angle, measured in the plane of its normal
+			const glm::vec3 toNext = SafeNormalize(ProjectOntoPlane(glm::vec3(vertices[corners[(corner + 1) % 3]].Position) - position, normal), glm::vec3(0.0f));
+			const glm::vec3 toPrevious = SafeNormalize(ProjectOntoPlane(glm::vec3(vertices[corners[(corner + 2) % 3]].Position) - position, normal), glm::vec3(0.0f));
+			const float angle = std::acos(std::clamp(glm::dot(toNext, toPrevious), -1.0f, 1.0f));
+
+			const size_t slot = vertex * size_t(2) + (mirrored ? 1 : 0);
+			sums[slot] += angle * SafeNormalize(ProjectOntoPlane(faceTangent, normal), glm::vec3(0.0f));
+			used[slot] = 1;
+			mirroredCorners[triangle + corner] = mirrored;
+		}
+	}
+
+	// Vertices used by both orientations get a copy for their mirrored corners
+	std::vector<uint32_t> mirroredCopies(originalCount, 0);
+	for (size_t vertex = 0; vertex < originalCount; vertex++)
+	{
+		const bool unmirrored = used[vertex * 2], mirrored = used[vertex * 2 + 1];
+		const Vertex source = vertices[vertex];
+		const glm::vec3 normal = SafeNormalize(source.Normal, glm::vec3(0.0f, 0.0f, 1.0f));
+		if (mirrored)
+		{
+			Vertex& target = unmirrored ? vertices.emplace_back(source) : vertices[vertex];
+			if (unmirrored)
+				mirroredCopies[vertex] = static_cast<uint32_t>(vertices.size() - 1);
+
+			// The mirrored mapping's v runs against the normal and tangent's cross product
+			target.TangentFrame = PackFrame(normal, SafeNormalize(sums[vertex * 2 + 1], AnyPerpendicular(normal)), -1.0f);
+		}
+		if (unmirrored || !mirrored)
+			vertices[vertex].TangentFrame = PackFrame(normal, SafeNormalize(sums[vertex * 2], AnyPerpendicular(normal)), 1.0f);
+	}
+
+	for (size_t corner = 0; corner < indices.size(); corner++)
+	{
+		if (mirroredCorners[corner] && mirroredCopies[indices[corner]] != 0)
+			indices[corner] = mirroredCopies[indices[corner]];
+	}
+
+	return vertices.size() - originalCount;
+}
+
+glm::i16vec4 TangentGenerator::PackFrame(const glm::vec3& normal, const glm::vec3& tangent, const float bitangentSign)
+{
+	const glm::vec3 n = SafeNormalize(normal, glm::vec3(0.0f, 0.0f, 1.0f));
+	const glm::vec3 t = SafeNormalize(ProjectOntoPlane(tangent, n), AnyPerpendicular(n));
+	glm::quat frame = glm::normalize(glm::quat_cast(glm::mat3(t, glm::cross(n, t), n)));
+
+	// q and -q are the same rotation, so w is kept positive and its sign is free to carry the bitangent's. A 16 bit
+	// snorm has no -0, so w is kept off zero by the smallest step it can hold
+	if (frame.w < 0.0f)
+		frame = -frame;
+	constexpr float bias = 1.0f / s_SnormScale;
+	if (frame.w < bias)
+	{
+		const float scale = std::sqrt(1.0f - bias * bias);
+		frame = glm::quat(bias, frame.x * scale, frame.y * scale, frame.z * scale);
+	}
+	if (bitangentSign < 0.0f)
+		frame = -frame;
+
+	const auto pack = [](const float value) { return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * s_SnormScale)); };
+	return glm::i16vec4(pack(frame.x), pack(frame.y), pack(frame.z), pack(frame.w));
+}
+
+void TangentGenerator::UnpackFrame(const glm::i16vec4& frame, glm::vec3& normal, glm::vec3& tangent, float& bitangentSign)
+{
+	const glm::vec4 q = glm::vec4(frame) / s_SnormScale;
+	const glm::quat rotation = glm::normalize(glm::quat(q.w, q.x, q.y, q.z));
+	normal = rotation * glm::vec3(0.0f, 0.0f, 1.0f);
+	tangent = rotation * glm::vec3(1.0f, 0.0f, 0.0f);
+	bitangentSign = q.w < 0.0f ? -1.0f : 1.0f;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm\glm.hpp>
+#include <glm\ext\vector_int4_sized.hpp>
+
+#include "Vertex.h"
+
+/* Builds the tangent frames normal maps are sampled in, the way MikkTSpace does, so maps baked by other tools look right.
+* Each triangle's tangent follows the direction its texture's u coordinate grows in, projected onto the plane of each
+* corner's vertex normal. Corners add theirs to the vertex weighted by the angle they span. A triangle whose mapping is
+* mirrored gives its corners a flipped bitangent, so a vertex shared by mirrored and unmirrored triangles is split in two.
+* Vertices have to be welded first, since like MikkTSpace only corners sharing a vertex are smoothed together.
+* Frames are packed into 16 bit quaternions, with the bitangent's sign in the sign of w. Shaders rebuild the bitangent
+* from the normal and tangent per fragment, as MikkTSpace expects.
+*/
+class TangentGenerator
+{
+public:
+	// Fills in every vertex's tangent frame, adding vertices and rewriting indices where mirrored mappings meet.
+	// Touches nothing but the given mesh, so meshes can be processed in parallel. Returns the number of vertices added
+	static size_t Generate(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// The quaternion rotating +X onto the tangent and +Z onto the normal. The tangent is made perpendicular to the normal
+	static glm::i16vec4 PackFrame(const glm::vec3& normal, const glm::vec3& tangent, float bitangentSign);
+	static void UnpackFrame(const glm::i16vec4& frame, glm::vec3& normal, glm::vec3& tangent, float& bitangentSign);
+};
@@ -0,0 +1,223 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Components\HierarchyComponent.h"
+#include "Components\TransformComponent.h"
+#include "TransformKernels.h"
+#include "..\ThreadPool.h"
+
+namespace
+{
+	// Per thread staging for the batched local matrix kernel, kept between frames to avoid reallocating
+	struct LocalScratch
+	{
+		TransformSoA Transforms;
+		std::vector<size_t> Indices; // Position within the level of each staged entity
+		std::vector<glm::mat4> Locals;
+		std::vector<glm::mat3> Normals;
+	};
+
+	thread_local LocalScratch t_Scratch;
+}
+
+void TransformHierarchy::Attach(entt::registry& registry, const entt::entity entity)
+{
+	registry.emplace_or_replace<HierarchyComponent>(entity);
+	registry.emplace_or_replace<WorldTransformComponent>(entity);
+	MarkDirty(registry, entity);
+}
+
+void TransformHierarchy::Unlink(entt::registry& registry, const entt::entity entity)
+{
+	auto& node = registry.get<HierarchyComponent>(entity);
+	if (node.Parent == entt::null)
+		return;
+
+	if (node.PrevSibling != entt::null)
+		registry.get<HierarchyComponent>(node.PrevSibling).NextSibling = node.NextSibling;
+	else
+		registry.get<HierarchyComponent>(node.Parent).FirstChild = node.NextSibling;
+
+	if (node.NextSibling != entt::null)
+		registry.get<HierarchyComponent>(node.NextSibling).PrevSibling = node.PrevSibling;
+
+	node.Parent = node.PrevSibling = node.NextSibling = entt::null;
+}
+
+void TransformHierarchy::SetParent(entt::registry& registry, const entt::entity child, const entt::entity parent)
+{
+	assert(child != parent);
+
+	Unlink(registry, child);
+
+	uint32_t depth = 0;
+	if (parent != entt::null)
+	{
+		// Walking up from the new parent must never reach the child, or the hierarchy would loop
+		for (auto ancestor = parent; ancestor != entt::null; ancestor = registry.get<HierarchyComponent>(ancestor).Parent)
+			assert(ancestor != child);
+
+		auto& parentNode = registry.get<HierarchyComponent>(parent);
+		auto& node = registry.get<HierarchyComponent>(child);
+		node.Parent = parent;
+		node.NextSibling = parentNode.FirstChild;
+		if (parentNode.FirstChild != entt::null)
+			registry.get<HierarchyComponent>(parentNode.FirstChild).PrevSibling = child;
+		parentNode.FirstChild = child;
+
+		depth = parentNode.Depth + 1;
+	}
+
+	// The whole subtree moved up or down by the same amount
+	std::vector<entt::entity> subtree;
+	GetSubtree(registry, child, subtree);
+	const int64_t shift = static_cast<int64_t>(depth) - registry.get<HierarchyComponent>(child).Depth;
+	for (const auto entity : subtree)
+	{
+		auto& node = registry.get<HierarchyComponent>(entity);
+		node.Depth = static_cast<uint32_t>(node.Depth + shift);
+	}
+
+	MarkDirty(registry, child);
+}
+
+void TransformHierarchy::GetSubtree(const entt::registry& registry, const entt::entity entity, std::vector<entt::entity>& out)
+{
+	const size_t first = out.size();
+	out.emplace_back(entity);
+
+	// Breadth first, so the vector itself serves as the queue
+	for (size_t i = first; i < out.size(); i++)
+	{
+		for (auto child = registry.get<HierarchyComponent>(out[i]).FirstChild; child != entt::null;
+			child = registry.get<HierarchyComponent>(child).NextSibling)
+			out.emplace_back(child);
+	}
+}
+
+void TransformHierarchy::MarkDirty(entt::registry& registry, const entt::entity entity)
+{
+	auto& world = registry.get<WorldTransformComponent>(entity);
+	world.LocalDirty = true;
+	if (!world.Queued)
+	{
+		world.Queued = true;
+		m_Dirty.emplace_back(entity);
+	}
+}
+
+void TransformHierarchy::Propagate(entt::registry& registry)
+{
+	if (m_Dirty.empty())
+		return;
+
+	for (const auto entity : m_Dirty)
+	{
+		// Destroyed since it was queued
+		if (!registry.valid(entity))
+			continue;
+
+		const uint32_t depth = registry.get<HierarchyComponent>(entity).Depth;
+		if (m_Levels.size() <= depth)
+			m_Levels.resize(depth + 1);
+		m_Levels[depth].emplace_back(entity);
+	}
+	m_Dirty.clear();
+
+	for (size_t depth = 0; depth < m_Levels.size(); depth++)
+	{
+		if (m_Levels[depth].empty())
+			continue;
+
+		if (m_Levels.size() <= depth + 1)
+			m_Levels.resize(depth + 2);
+		auto& level = m_Levels[depth];
+		auto& next = m_Levels[depth + 1];
+
+		UpdateLevel(registry, level);
+
+		// Children of anything that moved have to follow, unless they are already queued themselves
+		for (const auto entity : level)
+		{
+			for (auto child = registry.get<HierarchyComponent>(entity).FirstChild; child != entt::null;
+				child = registry.get<HierarchyComponent>(child).NextSibling)
+			{
+				auto& world = registry.get<WorldTransformComponent>(child);
+				if (!world.Queued)
+				{
+					world.Queued = true;
+					next.emplace_back(child);
+				}
+			}
+		}
+
+		level.clear();
+	}
+}
+
+void TransformHierarchy::UpdateLevel(entt::registry& registry, const std::vector<entt::entity>& level)
+{
+	const auto update = [&registry, &level](const size_t begin, const size_t end)
+	{
+		// Stage the entities whose own transform changed and rebuild their local matrices in one vectorised pass
+		auto& scratch = t_Scratch;
+		scratch.Indices.clear();
+		for (size_t i = begin; i < end; i++)
+		{
+			if (registry.get<WorldTransformComponent>(level[i]).LocalDirty)
+				scratch.Indices.emplace_back(i);
+		}
+
+		const size_t staged = scratch.Indices.size();
+		if (scratch.Transforms.Size() < staged)
+		{
+			scratch.Transforms.Resize(staged);
+			scratch.Locals.resize(staged);
+			scratch.Normals.resize(staged);
+		}
+		for (size_t k = 0; k < staged; k++)
+			scratch.Transforms.Set(k, registry.get<TransformComponent>(level[scratch.Indices[k]]));
+
+		ComposeTransforms(scratch.Transforms, 0, staged, scratch.Locals.data(), scratch.Normals.data());
+
+		for (size_t k = 0; k < staged; k++)
+		{
+			auto& world = registry.get<WorldTransformComponent>(level[scratch.Indices[k]]);
+			world.Local = scratch.Locals[k];
+			world.LocalNormal = scratch.Normals[k];
+			world.LocalDirty = false;
+		}
+
+		// The normal matrix of a product is the product of the normal matrices, so no inverse is needed
+		for (size_t i = begin; i < end; i++)
+		{
+			const auto& node = registry.get<HierarchyComponent>(level[i]);
+			auto& world = registry.get<WorldTransformComponent>(level[i]);
+
+			if (node.Parent != entt::null)
+			{
+				const auto& parent = registry.get<WorldTransformComponent>(node.Parent);
+				world.World = parent.World * world.Local;
+				world.Normal = parent.Normal * world.LocalNormal;
+			}
+			else
+			{
+				world.World = world.Local;
+				world.Normal = world.LocalNormal;
+			}
+			world.Queued = false;
+		}
+	};
+
+	if (level.size() < s_ParallelThreshold)
+	{
+		update(0, level.size());
+		return;
+	}
+
+	const size_t batches = (level.size() + s_BatchSize - 1) / s_BatchSize;
+	ThreadPool::Get().ParallelFor(batches, [&update, &level](const size_t batch)
+		{ update(batch * s_BatchSize, std::min(level.size(), (batch + 1) * s_BatchSize)); });
+}
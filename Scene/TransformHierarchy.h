@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "entt\include\entt.hpp"
+
+/* Keeps every entity's cached local, world and normal matrices in step with its TransformComponent and parents.
+* Entities whose transform changes are queued as dirty. Propagate() sorts them into batches by depth and walks the
+* batches top down, so each parent is finished before its children read it, and only queued entities and their
+* descendants are ever touched. A frame in which nothing moved costs nothing.
+*/
+class TransformHierarchy
+{
+public:
+	// Gives an entity the hierarchy and world transform components as a root of its own
+	void Attach(entt::registry& registry, entt::entity entity);
+	// Unlinks an entity from its parent and siblings, leaving its own children attached to it
+	static void Unlink(entt::registry& registry, entt::entity entity);
+
+	// Makes child a child of parent, or a root if parent is entt::null. The child keeps its local transform
+	void SetParent(entt::registry& registry, entt::entity child, entt::entity parent);
+	// Appends the entity and all of its descendants to out, parents before children
+	static void GetSubtree(const entt::registry& registry, entt::entity entity, std::vector<entt::entity>& out);
+
+	// Queues an entity whose TransformComponent changed, its descendants follow automatically
+	void MarkDirty(entt::registry& registry, entt::entity entity);
+
+	// Rebuilds the matrices of every dirty entity and its descendants. Safe to run on a worker
+	// as long as nothing else writes the transform components or changes the hierarchy meanwhile
+	void Propagate(entt::registry& registry);
+
+private:
+	// Recomputes the matrices of one batch, every parent involved must already be up to date
+	static void UpdateLevel(entt::registry& registry, const std::vector<entt::entity>& level);
+
+private:
+	std::vector<entt::entity> m_Dirty;
+	std::vector<std::vector<entt::entity>> m_Levels; // Dirty entities bucketed by depth, kept around to reuse their storage
+
+	static constexpr size_t s_ParallelThreshold = 1024; // Smaller batches aren't worth spreading across threads
+	static constexpr size_t s_BatchSize = 256; // Entities handed to a thread at a time
+};
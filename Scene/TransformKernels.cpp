@@ -0,0 +1,199 @@
+#include "TransformKernels.h"
+
+#include <cmath>
+
+#include "Components\TransformComponent.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TRANSFORM_KERNELS_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+void TransformSoA::Resize(const size_t size)
+{
+	for (auto* field : { &TranslationX, &TranslationY, &TranslationZ, &RotationX, &RotationY, &RotationZ, &ScaleX, &ScaleY, &ScaleZ })
+		field->resize(size);
+}
+
+void TransformSoA::Set(const size_t index, const TransformComponent& transform)
+{
+	TranslationX[index] = transform.Translation.x;
+	TranslationY[index] = transform.Translation.y;
+	TranslationZ[index] = transform.Translation.z;
+	RotationX[index] = transform.Rotation.x;
+	RotationY[index] = transform.Rotation.y;
+	RotationZ[index] = transform.Rotation.z;
+	ScaleX[index] = transform.Scale.x;
+	ScaleY[index] = transform.Scale.y;
+	ScaleZ[index] = transform.Scale.z;
+}
+
+namespace
+{
+	void ComposeScalar(const TransformSoA& t, const size_t i, glm::mat4& local, glm::mat3& normal)
+	{
+		// Euler angles to quaternion, as glm::quat(vec3) does
+		const float cx = std::cos(t.RotationX[i] * 0.5f), sx = std::sin(t.RotationX[i] * 0.5f);
+		const float cy = std::cos(t.RotationY[i] * 0.5f), sy = std::sin(t.RotationY[i] * 0.5f);
+		const float cz = std::cos(t.RotationZ[i] * 0.5f), sz = std::sin(t.RotationZ[i] * 0.5f);
+
+		const float w = cx * cy * cz + sx * sy * sz;
+		const float x = sx * cy * cz - cx * sy * sz;
+		const float y = cx * sy * cz + sx * cy * sz;
+		const float z = cx * cy * sz - sx * sy * cz;
+
+		// Quaternion to rotation matrix columns, as glm::mat3_cast does
+		const glm::vec3 r0(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y));
+		const glm::vec3 r1(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x));
+		const glm::vec3 r2(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y));
+
+		local = glm::mat4(
+			glm::vec4(r0 * t.ScaleX[i], 0.0f),
+			glm::vec4(r1 * t.ScaleY[i], 0.0f),
+			glm::vec4(r2 * t.ScaleZ[i], 0.0f),
+			glm::vec4(t.TranslationX[i], t.TranslationY[i], t.TranslationZ[i], 1.0f));
+		normal = glm::mat3(r0 / t.ScaleX[i], r1 / t.ScaleY[i], r2 / t.ScaleZ[i]);
+	}
+
+#ifdef TRANSFORM_KERNELS_AVX2
+	bool HasAVX2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// The OS has to save the upper halves of the YMM registers too
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	// Sine and cosine of eight floats. The argument is reduced to [-pi/4, pi/4] around the nearest multiple of pi/2,
+	// whose quadrant then picks and negates the two minimax polynomials. Accurate to a few ulp for |x| up to several thousand
+	AVX2_FUNCTION void SinCos8(const __m256 x, __m256& sine, __m256& cosine)
+	{
+		const __m256 quadrant = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.636619772f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		const __m256i q = _mm256_cvtps_epi32(quadrant);
+
+		// pi/2 split in three so each product is exact
+		__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(quadrant, _mm256_set1_ps(1.5703125f)));
+		r = _mm256_sub_ps(r, _mm256_mul_ps(quadrant, _mm256_set1_ps(4.837512969970703125e-4f)));
+		r = _mm256_sub_ps(r, _mm256_mul_ps(quadrant, _mm256_set1_ps(7.54978995489188216e-8f)));
+		const __m256 r2 = _mm256_mul_ps(r, r);
+
+		__m256 s = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(-1.9515295891e-4f)), _mm256_set1_ps(8.3321608736e-3f));
+		s = _mm256_add_ps(_mm256_mul_ps(s, r2), _mm256_set1_ps(-1.6666654611e-1f));
+		s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, r2), r), r);
+
+		__m256 c = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(2.443315711809948e-5f)), _mm256_set1_ps(-1.388731625493765e-3f));
+		c = _mm256_add_ps(_mm256_mul_ps(c, r2), _mm256_set1_ps(4.166664568298827e-2f));
+		c = _mm256_mul_ps(_mm256_mul_ps(c, r2), r2);
+		c = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+		// Odd quadrants swap sine and cosine, quadrants 2 and 3 negate the sine, 1 and 2 the cosine
+		const __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2);
+		const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one), one));
+		const __m256 sineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, two), 30));
+		const __m256 cosineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, one), two), 30));
+
+		sine = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sineSign);
+		cosine = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosineSign);
+	}
+
+	// Composes transforms [first, first + 8), the same math as ComposeScalar one lane per entity
+	AVX2_FUNCTION void Compose8(const TransformSoA& t, const size_t first, glm::mat4* local, glm::mat3* normal)
+	{
+		const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+
+		__m256 sx, cx, sy, cy, sz, cz;
+		SinCos8(_mm256_mul_ps(_mm256_loadu_ps(&t.RotationX[first]), half), sx, cx);
+		SinCos8(_mm256_mul_ps(_mm256_loadu_ps(&t.RotationY[first]), half), sy, cy);
+		SinCos8(_mm256_mul_ps(_mm256_loadu_ps(&t.RotationZ[first]), half), sz, cz);
+
+		const __m256 cxcy = _mm256_mul_ps(cx, cy), sxsy = _mm256_mul_ps(sx, sy);
+		const __m256 sxcy = _mm256_mul_ps(sx, cy), cxsy = _mm256_mul_ps(cx, sy);
+		const __m256 w = _mm256_add_ps(_mm256_mul_ps(cxcy, cz), _mm256_mul_ps(sxsy, sz));
+		const __m256 x = _mm256_sub_ps(_mm256_mul_ps(sxcy, cz), _mm256_mul_ps(cxsy, sz));
+		const __m256 y = _mm256_add_ps(_mm256_mul_ps(cxsy, cz), _mm256_mul_ps(sxcy, sz));
+		const __m256 z = _mm256_sub_ps(_mm256_mul_ps(cxcy, sz), _mm256_mul_ps(sxsy, cz));
+
+		const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+		// Rotation matrix, column major
+		const __m256 rotation[9] = {
+			_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))),
+			_mm256_mul_ps(two, _mm256_add_ps(xy, wz)),
+			_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)),
+			_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)),
+			_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))),
+			_mm256_mul_ps(two, _mm256_add_ps(yz, wx)),
+			_mm256_mul_ps(two, _mm256_add_ps(xz, wy)),
+			_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)),
+			_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)))
+		};
+		const __m256 scale[3] = { _mm256_loadu_ps(&t.ScaleX[first]), _mm256_loadu_ps(&t.ScaleY[first]), _mm256_loadu_ps(&t.ScaleZ[first]) };
+		const __m256 inverseScale[3] = { _mm256_div_ps(one, scale[0]), _mm256_div_ps(one, scale[1]), _mm256_div_ps(one, scale[2]) };
+
+		// Rows 0 - 8 hold the scaled rotation, 9 - 11 the translation and 12 - 20 the normal matrix
+		alignas(32) float lanes[21][8];
+		for (int column = 0; column < 3; column++)
+		{
+			for (int row = 0; row < 3; row++)
+			{
+				_mm256_store_ps(lanes[column * 3 + row], _mm256_mul_ps(rotation[column * 3 + row], scale[column]));
+				_mm256_store_ps(lanes[12 + column * 3 + row], _mm256_mul_ps(rotation[column * 3 + row], inverseScale[column]));
+			}
+		}
+		_mm256_store_ps(lanes[9], _mm256_loadu_ps(&t.TranslationX[first]));
+		_mm256_store_ps(lanes[10], _mm256_loadu_ps(&t.TranslationY[first]));
+		_mm256_store_ps(lanes[11], _mm256_loadu_ps(&t.TranslationZ[first]));
+
+		for (int lane = 0; lane < 8; lane++)
+		{
+			local[lane] = glm::mat4(
+				lanes[0][lane], lanes[1][lane], lanes[2][lane], 0.0f,
+				lanes[3][lane], lanes[4][lane], lanes[5][lane], 0.0f,
+				lanes[6][lane], lanes[7][lane], lanes[8][lane], 0.0f,
+				lanes[9][lane], lanes[10][lane], lanes[11][lane], 1.0f);
+			normal[lane] = glm::mat3(
+				lanes[12][lane], lanes[13][lane], lanes[14][lane],
+				lanes[15][lane], lanes[16][lane], lanes[17][lane],
+				lanes[18][lane], lanes[19][lane], lanes[20][lane]);
+		}
+	}
+#endif
+}
+
+void ComposeTransforms(const TransformSoA& transforms, const size_t first, const size_t count, glm::mat4* local, glm::mat3* normal)
+{
+	size_t i = 0;
+
+#ifdef TRANSFORM_KERNELS_AVX2
+	static const bool s_HasAVX2 = HasAVX2();
+	if (s_HasAVX2)
+	{
+		for (; i + 8 <= count; i += 8)
+			Compose8(transforms, first + i, local + i, normal + i);
+	}
+#endif
+
+	for (; i < count; i++)
+		ComposeScalar(transforms, first + i, local[i], normal[i]);
+}
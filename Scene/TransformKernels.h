@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm\glm.hpp>
+
+struct TransformComponent;
+
+// Translations, Euler rotations and scales of many entities, one array per scalar, so a
+// single vector load fetches the same field of eight consecutive entities
+struct TransformSoA
+{
+	std::vector<float> TranslationX, TranslationY, TranslationZ;
+	std::vector<float> RotationX, RotationY, RotationZ;
+	std::vector<float> ScaleX, ScaleY, ScaleZ;
+
+	size_t Size() const { return TranslationX.size(); }
+	void Resize(size_t size);
+	void Set(size_t index, const TransformComponent& transform);
+};
+
+// Composes T * R * S for transforms [first, first + count), matching TransformComponent::GetTransform, along with its
+// normal matrix R * S^-1. Entry first + i is written to local[i] and normal[i]. Eight entities are done at a time with
+// AVX2 when the CPU supports it, the remainder and older CPUs fall back to scalar code
+void ComposeTransforms(const TransformSoA& transforms, size_t first, size_t count, glm::mat4* local, glm::mat3* normal);
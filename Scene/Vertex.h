@@ -1,12 +1,16 @@
 #pragma once
 
 #include <glm\glm.hpp>
+#include <glm\ext\vector_int4_sized.hpp>
 
 struct Vertex
 {
 	glm::vec4 Position;
 	glm::vec3 Normal;
 	glm::vec2 TexCoord;
+	// Quaternion rotating +X onto the tangent and +Z onto the normal, as 16 bit snorms. A negative w flips the bitangent.
+	// Filled in by TangentGenerator, the default has the tangent along +X
+	glm::i16vec4 TangentFrame = glm::i16vec4(0, 0, 0, 32767);
 
 	Vertex() = default;
 
@@ -16,7 +20,8 @@ struct Vertex
 	{
 		return Position == other.Position &&
 			Normal == other.Normal &&
-			TexCoord == other.TexCoord;
+			TexCoord == other.TexCoord &&
+			TangentFrame == other.TangentFrame;
 	}
 
 	~Vertex() = default;
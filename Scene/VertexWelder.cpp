@@ -0,0 +1,89 @@
+#include "VertexWelder.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+	using WeldKey = std::array<int64_t, 9>; // Position xyzw, Normal xyz, TexCoord xy
+
+	struct WeldKeyHash
+	{
+		size_t operator()(const WeldKey& key) const
+		{
+			uint64_t hash = 0x9E3779B97F4A7C15ull;
+			for (const int64_t value : key)
+			{
+				hash ^= static_cast<uint64_t>(value);
+				hash *= 0xFF51AFD7ED558CCDull;
+				hash ^= hash >> 32;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	int64_t Quantize(const float value, const float inverseEpsilon)
+	{
+		if (inverseEpsilon == 0.0f)
+		{
+			// Exact mode: use the bit pattern, folding -0 onto 0 so they weld like operator== would
+			int32_t bits = 0;
+			const float folded = value == 0.0f ? 0.0f : value;
+			std::memcpy(&bits, &folded, sizeof(bits));
+			return bits;
+		}
+
+		// 64 bits hold the grid cell of any coordinate at any sane epsilon, where a 32 bit long on MSVC would saturate.
+		// Beyond even that, the exact bits keep distant vertices apart, offset to below every grid cell
+		const double scaled = static_cast<double>(value) * inverseEpsilon;
+		if (std::abs(scaled) >= 4.0e18)
+			return std::numeric_limits<int64_t>::min() + static_cast<uint32_t>(Quantize(value, 0.0f));
+		return std::llround(scaled);
+	}
+
+	WeldKey MakeKey(const Vertex& vertex, const float inverseEpsilon)
+	{
+		return {
+			Quantize(vertex.Position.x, inverseEpsilon), Quantize(vertex.Position.y, inverseEpsilon),
+			Quantize(vertex.Position.z, inverseEpsilon), Quantize(vertex.Position.w, inverseEpsilon),
+			Quantize(vertex.Normal.x, inverseEpsilon), Quantize(vertex.Normal.y, inverseEpsilon),
+			Quantize(vertex.Normal.z, inverseEpsilon),
+			Quantize(vertex.TexCoord.x, inverseEpsilon), Quantize(vertex.TexCoord.y, inverseEpsilon)
+		};
+	}
+}
+
+WeldResult VertexWelder::Weld(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) const
+{
+	WeldResult result;
+	result.VerticesBefore = vertices.size();
+
+	const float inverseEpsilon = m_Epsilon > 0.0f ? 1.0f / m_Epsilon : 0.0f;
+
+	// Maps every original vertex onto the first vertex that shares its key
+	std::unordered_map<WeldKey, uint32_t, WeldKeyHash> firstWithKey;
+	firstWithKey.reserve(vertices.size());
+	auto remap = std::vector<uint32_t>(vertices.size());
+
+	uint32_t welded = 0;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const auto [iterator, inserted] = firstWithKey.try_emplace(MakeKey(vertices[i], inverseEpsilon), welded);
+		if (inserted)
+			vertices[welded++] = vertices[i];
+
+		remap[i] = iterator->second;
+	}
+
+	vertices.resize(welded);
+	vertices.shrink_to_fit();
+
+	for (auto& index : indices)
+		index = remap[index];
+
+	result.VerticesAfter = vertices.size();
+	return result;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+struct WeldResult
+{
+	size_t VerticesBefore = 0;
+	size_t VerticesAfter = 0;
+
+	size_t GetBytesSaved() const { return (VerticesBefore - VerticesAfter) * sizeof(Vertex); }
+};
+
+// Merges vertices whose attributes all match within an epsilon and rewrites the index buffer to match.
+// Attributes are quantized onto an epsilon sized grid and hashed, so welding is linear in the vertex count.
+class VertexWelder
+{
+public:
+	// An epsilon of 0 only merges exactly equal vertices
+	explicit VertexWelder(const float epsilon = 1e-5f)
+		: m_Epsilon(epsilon) {}
+
+	WeldResult Weld(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) const;
+
+public:
+	float m_Epsilon = 1e-5f;
+};
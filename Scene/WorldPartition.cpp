@@ -0,0 +1,360 @@
+#include "WorldPartition.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <filesystem>
+#include <map>
+
+#include "..\utils.h"
+#include "..\ThreadPool.h"
+#include "..\Renderer\Resources.h"
+#include "Scene.h"
+#include "Components\HierarchyComponent.h"
+#include "Components\TransformComponent.h"
+#include "Components\Renderable\SharedMeshComponent.h"
+
+WorldPartition::WorldPartition(std::string directory, const float cellSize, const float loadRadius, const float unloadRadius,
+	const size_t memoryBudget)
+	: m_Directory(std::move(directory)), m_CellSize(cellSize), m_LoadRadius(loadRadius),
+	m_UnloadRadius(std::max(unloadRadius, loadRadius)), m_MemoryBudget(memoryBudget)
+{
+	assert(m_CellSize > 0.0f);
+}
+
+size_t WorldPartition::Build(Scene& scene, const std::string& directory, const float cellSize)
+{
+	entt::registry& registry = scene.GetRegistry();
+
+	// Ordered, so the cells are written in the same order every time
+	std::map<std::pair<int, int>, std::vector<entt::entity>> cells;
+	for (const auto [entity, hierarchy, transform] : registry.view<HierarchyComponent, WorldTransformComponent>().each())
+	{
+		if (hierarchy.Parent != entt::null)
+			continue;
+
+		const glm::vec3 position = transform.World[3];
+		const std::pair<int, int> cell(static_cast<int>(std::floor(position.x / cellSize)), static_cast<int>(std::floor(position.z / cellSize)));
+		TransformHierarchy::GetSubtree(registry, entity, cells[cell]);
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		LogError("WORLD_PARTITION: Could not create " + directory);
+		return 0;
+	}
+
+	size_t written = 0;
+	for (const auto& [coordinates, entities] : cells)
+	{
+		const std::string path = GetPath(directory, glm::ivec2(coordinates.first, coordinates.second));
+		if (SceneFile::Write(path, SceneFile::Serialize(scene, entities, false)))
+			written++;
+		else
+			LogError("WORLD_PARTITION: Could not write " + path);
+	}
+
+	return written;
+}
+
+void WorldPartition::Update(Scene& scene, const glm::vec3& position)
+{
+	m_Frame++;
+
+	// Reads that finished since the last update
+	for (auto& [key, cell] : m_Cells)
+	{
+		cell.Distance = GetDistance(cell.Coordinates, position);
+		if (cell.State != CellState::Reading || !cell.Load->Done.load(std::memory_order_acquire))
+			continue;
+
+		if (cell.Load->Found)
+		{
+			cell.MemoryCost = cell.Load->File.GetMemoryCost();
+			cell.State = CellState::Waiting;
+		}
+		else
+		{
+			cell.Load.reset();
+			cell.State = CellState::Missing;
+		}
+	}
+
+	// Cells past the unload radius go, those that were never added are forgotten straight away
+	for (auto it = m_Cells.begin(); it != m_Cells.end();)
+	{
+		Cell& cell = it->second;
+		if (cell.Distance > m_UnloadRadius)
+			Drop(scene, cell);
+
+		// A cell still being read is forgotten too, its worker holds on to the load until it is done
+		const bool forget = cell.Distance > m_UnloadRadius
+			&& (cell.State == CellState::Reading || cell.State == CellState::Missing || cell.State == CellState::Deferred);
+		it = forget ? m_Cells.erase(it) : std::next(it);
+	}
+
+	m_Order.clear();
+	for (auto& [key, cell] : m_Cells)
+		m_Order.emplace_back(&cell);
+	std::sort(m_Order.begin(), m_Order.end(), [](const Cell* a, const Cell* b) { return a->Distance < b->Distance; });
+
+	// Prepared cells are added nearest first while they fit the budget. A nearer cell that doesn't fit pushes out the
+	// farthest cells beyond it, and one that can't fit even then gives up its prepared data until there is room
+	size_t usage = GetMemoryUsage();
+	for (Cell* cell : m_Order)
+	{
+		if (cell->State != CellState::Waiting)
+			continue;
+
+		if (usage <= m_MemoryBudget)
+		{
+			cell->Load->File.Begin(scene);
+			cell->Entities = cell->Load->File.GetEntities();
+			cell->Materials = cell->Load->File.GetMaterials();
+			cell->NextEntity = 0;
+			cell->State = CellState::Adding;
+			continue;
+		}
+
+		// Memory of cells already on their way out is as good as free
+		size_t committed = usage;
+		for (const Cell* other : m_Order)
+		{
+			if (other->State == CellState::Removing || other->State == CellState::Releasing)
+				committed -= other->MemoryCost;
+		}
+
+		for (auto it = m_Order.rbegin(); it != m_Order.rend() && committed > m_MemoryBudget && (*it)->Distance > cell->Distance; ++it)
+		{
+			if ((*it)->State != CellState::Adding && (*it)->State != CellState::Resident)
+				continue;
+
+			committed -= (*it)->MemoryCost;
+			Drop(scene, **it);
+		}
+
+		if (committed > m_MemoryBudget)
+		{
+			cell->Load.reset();
+			cell->State = CellState::Deferred;
+			usage -= cell->MemoryCost;
+		}
+	}
+
+	// New cells within the load radius are read nearest first, a few at a time and only while there is room for them.
+	// Cells given up for the budget are read again once their last known size fits
+	uint32_t reads = 0;
+	for (const Cell* cell : m_Order)
+		reads += cell->State == CellState::Reading ? 1 : 0;
+
+	std::vector<std::pair<float, glm::ivec2>> requests;
+	const glm::ivec2 first(static_cast<int>(std::floor((position.x - m_LoadRadius) / m_CellSize)), static_cast<int>(std::floor((position.z - m_LoadRadius) / m_CellSize)));
+	const glm::ivec2 last(static_cast<int>(std::floor((position.x + m_LoadRadius) / m_CellSize)), static_cast<int>(std::floor((position.z + m_LoadRadius) / m_CellSize)));
+	for (int z = first.y; z <= last.y; z++)
+	{
+		for (int x = first.x; x <= last.x; x++)
+		{
+			const glm::ivec2 coordinates(x, z);
+			const float distance = GetDistance(coordinates, position);
+			if (distance > m_LoadRadius)
+				continue;
+
+			const auto it = m_Cells.find(GetKey(coordinates));
+			if (it == m_Cells.end())
+				requests.emplace_back(distance, coordinates);
+			else if (it->second.State == CellState::Deferred && usage + it->second.MemoryCost <= m_MemoryBudget)
+				requests.emplace_back(distance, coordinates);
+		}
+	}
+	std::sort(requests.begin(), requests.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	for (const auto& [distance, coordinates] : requests)
+	{
+		if (reads >= s_MaxReads || usage >= m_MemoryBudget)
+			break;
+
+		Request(coordinates, distance);
+		reads++;
+	}
+
+	// Entities are spent on removals first, which free memory, then on additions nearest first
+	size_t budget = m_EntityBudget;
+	std::vector<uint64_t> released;
+	for (Cell* cell : m_Order)
+	{
+		if (cell->State == CellState::Removing)
+			budget -= Advance(scene, *cell, budget);
+
+		if (cell->State == CellState::Releasing && m_Frame >= cell->ReleaseFrame + s_ReleaseDelay)
+		{
+			for (const MaterialHandle material : cell->Materials)
+				g_Resources->Materials.Remove(material);
+			cell->Materials.clear();
+			cell->Meshes.clear();
+
+			// Cells pushed out by the budget are remembered with their size, so they are only read again once they fit
+			if (cell->Distance <= m_LoadRadius)
+				cell->State = CellState::Deferred;
+			else
+				released.emplace_back(GetKey(cell->Coordinates));
+		}
+	}
+
+	for (Cell* cell : m_Order)
+	{
+		if (cell->State == CellState::Adding && budget > 0)
+			budget -= Advance(scene, *cell, budget);
+	}
+
+	for (const uint64_t key : released)
+		m_Cells.erase(key);
+	m_Order.clear();
+}
+
+size_t WorldPartition::GetMemoryUsage() const
+{
+	size_t usage = 0;
+	for (const auto& [key, cell] : m_Cells)
+	{
+		if (cell.State != CellState::Reading && cell.State != CellState::Missing && cell.State != CellState::Deferred)
+			usage += cell.MemoryCost;
+	}
+	return usage;
+}
+
+size_t WorldPartition::GetResidentCellCount() const
+{
+	return static_cast<size_t>(std::count_if(m_Cells.begin(), m_Cells.end(), [](const auto& cell) { return cell.second.State == CellState::Resident; }));
+}
+
+void WorldPartition::Clear()
+{
+	// Reads prefetch textures through the asset manager, so they have to finish first
+	for (const auto& [key, cell] : m_Cells)
+	{
+		if (cell.Read)
+			ThreadPool::Get().Wait(cell.Read);
+	}
+
+	m_Cells.clear();
+	m_Order.clear();
+}
+
+void WorldPartition::Request(const glm::ivec2& coordinates, const float distance)
+{
+	Cell& cell = m_Cells[GetKey(coordinates)];
+	cell.Coordinates = coordinates;
+	cell.State = CellState::Reading;
+	cell.Distance = distance;
+	cell.Load = std::make_shared<CellLoad>();
+
+	// Files that are missing are expected, the world need not cover every cell
+	cell.Read = ThreadPool::Get().Submit([load = cell.Load, path = GetPath(coordinates)]
+	{
+		load->Found = std::filesystem::exists(path) && load->File.Prepare(path);
+		load->Done.store(true, std::memory_order_release);
+	});
+}
+
+void WorldPartition::Drop(Scene& scene, Cell& cell)
+{
+	switch (cell.State)
+	{
+	case CellState::Waiting:
+		cell.Load.reset();
+		cell.State = CellState::Deferred;
+		break;
+
+	case CellState::Adding:
+	case CellState::Resident:
+	{
+		// Children go before their parents, so every entity is a leaf by the time it is destroyed
+		const entt::registry& registry = scene.GetRegistry();
+		const auto end = std::remove_if(cell.Entities.begin(), cell.Entities.end(), [&registry](const entt::entity entity)
+		{
+			return !registry.valid(entity);
+		});
+		cell.Entities.erase(end, cell.Entities.end());
+
+		std::vector<std::pair<uint32_t, entt::entity>> byDepth;
+		byDepth.reserve(cell.Entities.size());
+		for (const entt::entity entity : cell.Entities)
+			byDepth.emplace_back(registry.get<HierarchyComponent>(entity).Depth, entity);
+		std::sort(byDepth.begin(), byDepth.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+		for (size_t i = 0; i < byDepth.size(); i++)
+			cell.Entities[i] = byDepth[i].second;
+
+		cell.Load.reset();
+		cell.NextEntity = 0;
+		cell.State = CellState::Removing;
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+size_t WorldPartition::Advance(Scene& scene, Cell& cell, const size_t budget)
+{
+	const size_t count = std::min(budget, cell.Entities.size() - cell.NextEntity);
+
+	if (cell.State == CellState::Adding)
+	{
+		cell.NextEntity += count;
+		if (cell.Load->File.Continue(scene, count))
+		{
+			// The mapped file, decoded models and entity list are no longer needed
+			cell.Load.reset();
+			cell.State = CellState::Resident;
+		}
+	}
+	else if (cell.State == CellState::Removing)
+	{
+		// Entities may have been destroyed along with something outside the cell since
+		entt::registry& registry = scene.GetRegistry();
+		for (size_t i = cell.NextEntity; i < cell.NextEntity + count; i++)
+		{
+			const entt::entity entity = cell.Entities[i];
+			if (!registry.valid(entity))
+				continue;
+
+			// Meshes are held like materials, so their pooled ranges are not handed to a cell added meanwhile
+			if (const auto* shared = registry.try_get<SharedMeshComponent>(entity))
+				cell.Meshes.push_back(shared->Mesh);
+			if (auto* mesh = registry.try_get<TriangleMeshComponent>(entity))
+				cell.Meshes.push_back(std::make_shared<const TriangleMeshComponent>(std::move(*mesh)));
+			scene.DestroyEntity(entity);
+		}
+
+		cell.NextEntity += count;
+		if (cell.NextEntity == cell.Entities.size())
+		{
+			// Snapshots already handed to the render thread may still draw with the cell's meshes and materials
+			cell.Entities = std::vector<entt::entity>();
+			cell.ReleaseFrame = m_Frame;
+			cell.State = CellState::Releasing;
+		}
+	}
+
+	return count;
+}
+
+float WorldPartition::GetDistance(const glm::ivec2& coordinates, const glm::vec3& position) const
+{
+	const glm::vec2 min = glm::vec2(coordinates) * m_CellSize;
+	const glm::vec2 point(position.x, position.z);
+	return glm::distance(point, glm::clamp(point, min, min + m_CellSize));
+}
+
+std::string WorldPartition::GetPath(const std::string& directory, const glm::ivec2& coordinates)
+{
+	return directory + "\\cell_" + std::to_string(coordinates.x) + "_" + std::to_string(coordinates.y) + ".scene";
+}
+
+uint64_t WorldPartition::GetKey(const glm::ivec2& coordinates)
+{
+	return static_cast<uint64_t>(static_cast<uint32_t>(coordinates.x)) << 32 | static_cast<uint32_t>(coordinates.y);
+}
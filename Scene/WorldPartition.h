@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include "SceneFile.h"
+#include "..\ThreadPool.h"
+
+class Scene;
+
+/* Streams a world split into square cells on the XZ plane, each a scene file of its own, into a live scene.
+* Build writes the cells: every root entity lands, with its children, in the cell holding its world position.
+* Cells within the load radius of the camera are read, nearest first, on the worker pool, where their textures are
+* decoded and their models opened. Their entities are then added a batch per update, so no frame does all of a cell.
+* Cells are dropped once they are beyond the larger unload radius, so walking along a cell boundary doesn't keep
+* reloading them, or sooner, farthest first, when the resident cells would exceed the memory budget. Dropped entities
+* are destroyed a batch per update too, and their materials released once no snapshot in flight can still draw them.
+* Their textures belong to the asset manager, which keeps those other cells share.
+*/
+class WorldPartition
+{
+public:
+	WorldPartition(std::string directory, float cellSize, float loadRadius, float unloadRadius, size_t memoryBudget);
+	WorldPartition(const WorldPartition&) = delete;
+	WorldPartition& operator=(const WorldPartition&) = delete;
+
+	// Writes every root entity and its children into the cell file under its world position. World transforms have
+	// to be current. Returns the number of cells written
+	static size_t Build(Scene& scene, const std::string& directory, float cellSize);
+
+	// Streams cells in and out around position. Run once per frame on the GL thread with nothing else touching the
+	// registry, e.g. from an exclusive scene system
+	void Update(Scene& scene, const glm::vec3& position);
+
+	// Entities added or destroyed per update, across all cells
+	void SetEntityBudget(const size_t entityBudget) { m_EntityBudget = entityBudget; }
+	// Estimated bytes taken up by cells that are loading or loaded
+	size_t GetMemoryUsage() const;
+	size_t GetResidentCellCount() const;
+
+	// Waits for cells still being read and drops every cell, along with the meshes and loads they hold. Run on the GL
+	// thread before the scene, asset manager and pools go away
+	void Clear();
+
+	~WorldPartition() = default;
+
+private:
+	enum class CellState
+	{
+		Reading, // Prepared on a worker
+		Waiting, // Prepared, until the memory budget has room for it
+		Adding, // Entities are being added
+		Resident,
+		Removing, // Entities are being destroyed
+		Releasing, // Waiting for snapshots in flight before releasing its resources
+		Missing, // There is no file for it
+		Deferred // Read before, but given up until there is room for its MemoryCost
+	};
+
+	// Shared with the worker preparing it, which may finish after the cell was dropped
+	struct CellLoad
+	{
+		SceneFileLoad File;
+		std::atomic<bool> Done = false;
+		bool Found = false;
+	};
+
+	struct Cell
+	{
+		glm::ivec2 Coordinates = glm::ivec2(0);
+		CellState State = CellState::Reading;
+		std::shared_ptr<CellLoad> Load;
+		JobHandle Read; // The worker preparing Load
+		std::vector<entt::entity> Entities; // Deepest first while removing
+		size_t NextEntity = 0;
+		std::vector<MaterialHandle> Materials;
+		std::vector<std::shared_ptr<const TriangleMeshComponent>> Meshes; // Held from removal until release
+		size_t MemoryCost = 0;
+		uint64_t ReleaseFrame = 0;
+		float Distance = 0.0f; // From the camera to the nearest point of the cell, on the XZ plane
+	};
+
+	// Starts reading the cell's file
+	void Request(const glm::ivec2& coordinates, float distance);
+	// Moves a cell towards removal, from whatever state it is in
+	void Drop(Scene& scene, Cell& cell);
+	// Advances a cell by up to budget entities, returns how many it used
+	size_t Advance(Scene& scene, Cell& cell, size_t budget);
+
+	float GetDistance(const glm::ivec2& coordinates, const glm::vec3& position) const;
+	std::string GetPath(const glm::ivec2& coordinates) const { return GetPath(m_Directory, coordinates); }
+	static std::string GetPath(const std::string& directory, const glm::ivec2& coordinates);
+	static uint64_t GetKey(const glm::ivec2& coordinates);
+
+private:
+	std::string m_Directory;
+	float m_CellSize = 0.0f;
+	float m_LoadRadius = 0.0f, m_UnloadRadius = 0.0f;
+	size_t m_MemoryBudget = 0;
+	size_t m_EntityBudget = 512;
+
+	std::unordered_map<uint64_t, Cell> m_Cells;
+	std::vector<Cell*> m_Order; // Cells nearest first, rebuilt every update
+	uint64_t m_Frame = 0;
+
+	static constexpr uint32_t s_MaxReads = 2; // Cells read on workers at once
+	static constexpr uint64_t s_ReleaseDelay = 3; // Updates before a dropped cell's resources may be released
+};
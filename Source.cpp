@@ -3,7 +3,9 @@
 #include <glm\glm.hpp>
 #include <glm\gtc\matrix_transform.hpp>
 
+#include <algorithm>
 #include <iostream>
+#include <tuple>
 #include <vector>
 // #define LOCK_FRAMERATE
 #ifdef LOCK_FRAMERATE
@@ -11,20 +13,39 @@
 #endif
 
 #include "utils.h"
+#include "ThreadPool.h"
 
 // #include "Renderbuffer.h"
 // #include "Framebuffer.h"
 
 #include "Scene\Scene.h"
 #include "Scene\Model.h"
+#include "Scene\SceneFile.h"
+#include "Scene\StaticBatcher.h"
+#include "Scene\WorldPartition.h"
+#include "Scene\Components\ColorPalette.h"
+#include "Renderer\AssetManager.h"
+#include "Renderer\UploadManager.h"
+#include "Renderer\BufferPool.h"
+#include "Renderer\ReleaseQueue.h"
+#include "Renderer\Resources.h"
+#include "Renderer\RenderThread.h"
 
 constexpr unsigned int SCR_WIDTH = 800;
 constexpr unsigned int SCR_HEIGHT = 600;
+constexpr const char* SCENE_PATH = ".\\sandbox.scene";
+constexpr const char* WORLD_PATH = ".\\world";
+constexpr const char* WORLD_LIGHTS_PATH = ".\\world\\lights.scene";
+constexpr float WORLD_CELL_SIZE = 32.0f;
+constexpr float STATIC_BATCH_CELL_SIZE = 16.0f;
 
 #ifdef LOCK_FRAMERATE
 constexpr unsigned int DESIRED_FRAME_RATE = 60;
 #endif
 
+int viewportWidth = SCR_WIDTH;
+int viewportHeight = SCR_HEIGHT;
+
 bool renderFilled = true;
 bool renderAxis = false;
 bool renderNormals = false;
@@ -39,9 +60,11 @@ bool firstMouse = true;
 
 std::vector<int> frameRateHistory(10, 0);
 
+// GLFW calls this from glfwPollEvents on the main thread, the render thread applies the size with the next snapshot
 void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	viewportWidth = width;
+	viewportHeight = height;
 }
 
 void ProcessInput(GLFWwindow* window)
@@ -53,10 +76,7 @@ void ProcessInput(GLFWwindow* window)
 
 	renderNormals = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS;
 
-	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-	else
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	renderFilled = glfwGetKey(window, GLFW_KEY_F) != GLFW_PRESS;
 
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 		camera->ProcessKeyboard(FORWARD, deltaTime);
@@ -115,8 +135,8 @@ GLFWwindow* Init()
 		return nullptr;
 	}
 
-	glfwMakeContextCurrent(window);
 	// Register window resizing callback
+	glfwGetFramebufferSize(window, &viewportWidth, &viewportHeight);
 	glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
 
 	// Register mouse callback
@@ -126,12 +146,18 @@ GLFWwindow* Init()
 	// Register scroll callback
 	glfwSetScrollCallback(window, ScrollCallback);
 
+	return window;
+}
+
+// Runs on the render thread with the window's context current
+bool InitGraphics()
+{
 	// Initialize GLAD
 	// ---------------
 	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)))
 	{
 		std::cout << "Failed to initialize GLAD" << std::endl;
-		return nullptr;
+		return false;
 	}
 
 	glEnable(GL_DEBUG_OUTPUT);
@@ -154,7 +180,32 @@ GLFWwindow* Init()
 	g_SkyboxShader = std::make_shared<Shader>("skybox.vert", "skybox.frag");
 	//g_ScreenShader = std::make_shared<Shader>("screen.vert", "texture2D.frag");
 
-	return window;
+	g_UploadManager = std::make_shared<UploadManager>();
+	g_ReleaseQueue = std::make_shared<ReleaseQueue>();
+	g_VertexPool = std::make_shared<BufferPool>("Vertices", 64 << 20);
+	g_IndexPool = std::make_shared<BufferPool>("Indices", 16 << 20);
+	g_ColorPalette = std::make_shared<ColorPalette>();
+	g_Resources = std::make_shared<Resources>();
+	g_AssetManager = std::make_shared<AssetManager>();
+
+	g_IsolatedShader->Use();
+	for (int i = 0; i < 16; i++)
+		g_IsolatedShader->SetInt("textures[" + std::to_string(i) + "]", i);
+
+	g_LitObjectShader->Use();
+	for (int i = 0; i < 8; i++)
+		g_LitObjectShader->SetInt("textures[" + std::to_string(i) + "]", i);
+
+	g_MirrorShader->Use();
+	g_MirrorShader->SetInt("skybox", 0);
+
+	g_RefractorShader->Use();
+	g_RefractorShader->SetInt("skybox", 0);
+
+	g_SkyboxShader->Use();
+	g_SkyboxShader->SetInt("skybox", 0);
+
+	return true;
 }
 
 void UpdateFrameRate(GLFWwindow* window)
@@ -202,83 +253,192 @@ std::pair<std::shared_ptr<Scene>, std::shared_ptr<Renderer>> SandboxScene()
 	//scene->AddEmptyComponent<SkyboxTag>(skybox);
 	//scene->AddComponent<CubeComponent>(skybox);
 	//auto& skyboxMaterial = scene->AddComponent<CubeMapMaterialComponent>(
-	//	skybox, std::weak_ptr<Shader>(g_SkyboxShader), cubeTexture
+	//	skybox, g_Resources->Shaders.Add(g_SkyboxShader), g_Resources->Textures.Add(cubeTexture)
 	//);
-	//scene->m_SceneData.SkyboxTexture = skyboxMaterial.m_Texture->m_ID;
+	//scene->m_SceneData.SkyboxTexture = g_Resources->Textures.Get(skyboxMaterial.Texture).m_ID;
 
 	// Display default cube
 	auto defaultCube = scene->CreateEntity();
 	scene->AddComponent<CubeComponent>(defaultCube);
-	auto textures = std::vector<std::shared_ptr<Tex2D>> {
-		std::make_shared<Tex2D>(glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), "BaseColor")
-	};
-	auto& material = scene->AddComponent<MaterialComponent>(
-		defaultCube, std::weak_ptr<Shader>(g_IsolatedShader), textures, 1.0f
-	);
-	material.m_SetShininess = false;
+	auto material = std::make_shared<Material>(g_Resources->Shaders.Add(g_IsolatedShader), 1.0f);
+	material->SetBaseColor(*g_ColorPalette, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+	material->SetShininess = false;
+	scene->AddComponent<MaterialComponent>(defaultCube, g_Resources->Materials.Add(std::move(material)));
 	scene->AddEmptyComponent<RenderableTag>(defaultCube);
+	scene->SetStatic(defaultCube, true);
 
 	return std::make_pair(scene, renderer);
 }
 
-int main()
+// The scene the last session saved, or nothing if there is none
+std::pair<std::shared_ptr<Scene>, std::shared_ptr<Renderer>> SavedScene()
 {
-	GLFWwindow* window = Init();
-	if (!window) return EXIT_FAILURE;
+	auto renderer = std::make_shared<Renderer>();
+	auto scene = std::make_shared<Scene>(std::weak_ptr(renderer));
+	if (!SceneFile::Load(SCENE_PATH, *scene))
+		return {};
 
-	g_IsolatedShader->Use();
-	for (int i = 0; i < 16; i++)
-		g_IsolatedShader->SetInt("textures[" + std::to_string(i) + "]", i);
+	// The main loop steers the flashlight
+	if (!scene->m_SceneData.Flashlight)
+		scene->m_SceneData.Flashlight = std::make_shared<SpotLight>(12.5f, 0.2f, 0.5f, 0.99f);
 
-	g_LitObjectShader->Use();
-	for (int i = 0; i < 16; i++)
-		g_LitObjectShader->SetInt("textures[" + std::to_string(i) + "]", i);
+	// Static meshes are merged once, after the first update has propagated their world transforms
+	scene->GetSystems().AddSystem("StaticBatching", Reads<>(), Writes<>(),
+		[batched = false](Scene& loaded) mutable
+		{
+			if (!batched)
+				StaticBatcher::Build(loaded, STATIC_BATCH_CELL_SIZE);
+			batched = true;
+		}, SystemAffinity::Exclusive);
 
-	g_MirrorShader->Use();
-	g_MirrorShader->SetInt("skybox", 0);
+	return std::make_pair(scene, renderer);
+}
 
-	g_RefractorShader->Use();
-	g_RefractorShader->SetInt("skybox", 0);
+// The lights of a world split into cells, whose entities stream in around the camera, or nothing if there is none
+std::pair<std::shared_ptr<Scene>, std::shared_ptr<Renderer>> StreamedScene(WorldPartition& world)
+{
+	auto renderer = std::make_shared<Renderer>();
+	auto scene = std::make_shared<Scene>(std::weak_ptr(renderer));
+	if (!SceneFile::Load(WORLD_LIGHTS_PATH, *scene))
+		return {};
 
-	g_SkyboxShader->Use();
-	g_SkyboxShader->SetInt("skybox", 0);
+	if (!scene->m_SceneData.Flashlight)
+		scene->m_SceneData.Flashlight = std::make_shared<SpotLight>(12.5f, 0.2f, 0.5f, 0.99f);
+
+	// The simulation thread waits while exclusive systems run, so reading the camera here is safe
+	scene->GetSystems().AddSystem("WorldStreaming", Reads<>(), Writes<>(),
+		[&world](Scene& streamed) { world.Update(streamed, camera->m_Position); }, SystemAffinity::Exclusive);
+
+	return std::make_pair(scene, renderer);
+}
 
-	auto [scene, renderer] = SandboxScene();
+int main()
+{
+	GLFWwindow* window = Init();
+	if (!window) return EXIT_FAILURE;
 
-	const auto uniformMatrixBuffer = std::make_shared<UniformBuffer>();
-	uniformMatrixBuffer->SetData(2 * sizeof(glm::mat4), nullptr);
-	uniformMatrixBuffer->BindDataRange(0, 0, 2 * sizeof(glm::mat4));
-	// SetUniformBuffer(uniformMatrixBuffer, "Matrices");
+	// The render thread takes over the context. The scene is built there too, since creating meshes issues GL calls
+	std::shared_ptr<Scene> scene;
+	std::shared_ptr<Renderer> renderer;
+	WorldPartition world(WORLD_PATH, WORLD_CELL_SIZE, 96.0f, 128.0f, 512ull << 20);
+	glfwMakeContextCurrent(nullptr);
+	RenderThread renderThread(window, [&scene, &renderer, &world]
+	{
+		if (!InitGraphics())
+			return false;
+
+		std::tie(scene, renderer) = StreamedScene(world);
+		if (!scene)
+			std::tie(scene, renderer) = SavedScene();
+		if (!scene)
+			std::tie(scene, renderer) = SandboxScene();
+		return true;
+	});
+
+	if (!renderThread.IsRunning())
+	{
+		glfwTerminate();
+		return EXIT_FAILURE;
+	}
 
-	// Render Loop
+	// Unreferenced textures are evicted on the GL thread, while nothing else touches the resource pools
+	scene->GetSystems().AddSystem("AssetEviction", Reads<>(), Writes<>(),
+		[](Scene&) { g_AssetManager->Update(); }, SystemAffinity::Exclusive);
+
+	// Saving reads the resource pools the render thread adds to, so it runs on the GL thread in the next update
+	bool saveRequested = false;
+	bool buildRequested = false;
+	scene->GetSystems().AddSystem("SceneExport", Reads<>(), Writes<>(),
+		[&saveRequested, &buildRequested](Scene& exported)
+		{
+			if (saveRequested)
+				SceneFile::Write(SCENE_PATH, exported);
+
+			if (buildRequested)
+			{
+				const size_t cells = WorldPartition::Build(exported, WORLD_PATH, WORLD_CELL_SIZE);
+				SceneFile::Write(WORLD_LIGHTS_PATH, SceneFile::Serialize(exported, {}, true));
+				std::cout << "Wrote " << cells << " world cells" << std::endl;
+			}
+			saveRequested = buildRequested = false;
+		}, SystemAffinity::Exclusive);
+
+	// Simulation Loop
 	std::cout << "Starting render loop" << std::endl;
+	bool savePressed = false;
+	bool buildPressed = false;
 	while (!glfwWindowShouldClose(window))
 	{
+		glfwPollEvents();
 		UpdateFrameRate(window);
 		ProcessInput(window);
 
-		// Set uniform view and projection matrices
-		glm::mat4 view = camera->GetViewMatrix();
-		glm::mat4 proj = glm::perspective(glm::radians(camera->m_Zoom),
-			static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT), 0.1f, 100.0f);
-		uniformMatrixBuffer->SetSubData(0, sizeof(proj), glm::value_ptr(proj));
-		uniformMatrixBuffer->SetSubData(sizeof(proj), sizeof(view), glm::value_ptr(view));
-
 		// Update flashlight position to match camera's
 		scene->m_SceneData.Flashlight->Update(glm::vec4(camera->m_Position, 1.0f), camera->m_Front);
 
-		// Render
+		// Update
 		scene->OnUpdate();
 
-		// Check and call events and swap buffers
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		// Hand this frame to the render thread, which draws it while the next one is simulated
+		FrameSnapshot& snapshot = renderThread.BeginFrame();
+		snapshot.View = camera->GetViewMatrix();
+		snapshot.Projection = glm::perspective(glm::radians(camera->m_Zoom),
+			static_cast<float>(viewportWidth) / static_cast<float>(std::max(viewportHeight, 1)), 0.1f, 100.0f);
+		snapshot.CameraPosition = camera->m_Position;
+		snapshot.ViewportWidth = viewportWidth;
+		snapshot.ViewportHeight = viewportHeight;
+		snapshot.Wireframe = !renderFilled;
+		scene->BuildSnapshot(snapshot);
+		renderThread.EndFrame();
+
+		// Hold L to submit draws directly instead of through command lists, to compare the two
+		renderThread.SetUseCommandLists(glfwGetKey(window, GLFW_KEY_L) != GLFW_PRESS);
+
+		// Press P to save the scene, the next launch starts from it
+		if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !savePressed)
+			saveRequested = true;
+		savePressed = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+
+		// Press B to split the scene into world cells, the next launch streams them in around the camera
+		if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !buildPressed)
+			buildRequested = true;
+		buildPressed = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+
+		// Hold T to print how long each scene system and the last frame's submission took
+		if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
+		{
+			for (const auto& timing : scene->GetSystems().GetTimings())
+				std::cout << timing.Name << ": " << timing.Milliseconds << " ms" << std::endl;
+			std::cout << "Render thread submit: " << renderThread.GetSubmitMilliseconds() << " ms ("
+				<< (renderThread.GetUseCommandLists() ? "command lists" : "direct") << ", record " << renderThread.GetRecordMilliseconds()
+				<< " ms, issue " << renderThread.GetIssueMilliseconds() << " ms)" << std::endl;
+
+			const AssetStats assets = g_AssetManager->GetStats();
+			std::cout << "Textures: " << assets.Hits << " hits, " << assets.CpuHits << " cpu hits, " << assets.Misses << " misses, "
+				<< assets.Evictions << " evictions, " << assets.GpuTextures << " resident (" << (assets.GpuBytes >> 20) << " MB gpu, "
+				<< (assets.CpuBytes >> 20) << " MB cpu)" << std::endl;
+		}
 		
 #ifdef LOCK_FRAMERATE
 		std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<int>(static_cast<float>(averageFrameRate) / static_cast<float>(DESIRED_FRAME_RATE) * 1e7f)));
 #endif
 	}
 
+	// The world's cells, the scene's meshes, pooled resources, the staging ring and buffer pools are GL objects, so
+	// release them on the render thread while the context still exists
+	renderThread.Stop([&scene, &renderer, &world]
+	{
+		world.Clear();
+		scene.reset();
+		renderer.reset();
+		g_AssetManager.reset();
+		g_ReleaseQueue.reset(); // Nothing is drawn anymore, so the meshes the scene left behind go straight away
+		g_Resources.reset();
+		g_ColorPalette.reset();
+		g_UploadManager.reset();
+		g_VertexPool.reset();
+		g_IndexPool.reset();
+	});
 	glfwTerminate();
 	return EXIT_SUCCESS;
 }
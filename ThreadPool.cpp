@@ -0,0 +1,249 @@
+#include "ThreadPool.h"
+
+namespace
+{
+	// Identifies which pool and deque the current thread works for, if any
+	thread_local const ThreadPool* t_Pool = nullptr;
+	thread_local size_t t_WorkerIndex = 0;
+}
+
+ThreadPool::ThreadPool(const unsigned int threadCount)
+	: m_MainThread(std::this_thread::get_id())
+{
+	m_Queues.reserve(threadCount);
+	for (unsigned int i = 0; i < threadCount; i++)
+		m_Queues.emplace_back(std::make_unique<WorkQueue>());
+
+	m_Workers.reserve(threadCount);
+	for (unsigned int i = 0; i < threadCount; i++)
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+JobHandle ThreadPool::Submit(std::function<void()> task, const std::vector<JobHandle>& dependencies)
+{
+	return CreateJob(std::move(task), false, dependencies);
+}
+
+JobHandle ThreadPool::SubmitToMainThread(std::function<void()> task, const std::vector<JobHandle>& dependencies)
+{
+	return CreateJob(std::move(task), true, dependencies);
+}
+
+void ThreadPool::Wait(const JobHandle& job)
+{
+	while (!job->IsDone())
+	{
+		if ((IsMainThread() && TryRunMainThreadJob()) || TryRunJob())
+			continue;
+
+		// Nothing to help with, sleep until a job finishes or more work shows up
+		m_Waiting++;
+		{
+			std::unique_lock lock(m_Mutex);
+			const bool mainThread = IsMainThread();
+			m_JobFinished.wait(lock, [this, &job, mainThread]
+				{ return job->IsDone() || m_Queued > 0 || (mainThread && m_MainQueued > 0); });
+		}
+		m_Waiting--;
+	}
+}
+
+void ThreadPool::RunMainThreadJobs()
+{
+	while (TryRunMainThreadJob()) {}
+}
+
+void ThreadPool::SetMainThreadWake(std::function<void()> wake)
+{
+	std::lock_guard lock(m_MainMutex);
+	m_MainThreadWake = std::move(wake);
+}
+
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_Condition.notify_all();
+
+	for (auto& worker : m_Workers)
+		worker.join();
+}
+
+JobHandle ThreadPool::CreateJob(std::function<void()> task, const bool mainThread, const std::vector<JobHandle>& dependencies)
+{
+	auto job = std::make_shared<Job>();
+	job->m_Task = std::move(task);
+	job->m_MainThread = mainThread;
+
+	// Register with every unfinished dependency. The extra count taken at construction keeps the job
+	// from being scheduled by a dependency that finishes before this loop is done
+	for (const auto& dependency : dependencies)
+	{
+		if (!dependency)
+			continue;
+
+		std::lock_guard lock(dependency->m_Mutex);
+		if (dependency->IsDone())
+			continue;
+
+		job->m_Unfinished++;
+		dependency->m_Continuations.emplace_back(job);
+	}
+
+	if (--job->m_Unfinished == 0)
+		Schedule(job);
+
+	return job;
+}
+
+void ThreadPool::Schedule(const JobHandle& job)
+{
+	if (job->m_MainThread)
+	{
+		std::function<void()> wake;
+		{
+			std::lock_guard lock(m_MainMutex);
+			m_MainJobs.emplace_back(job);
+			wake = m_MainThreadWake;
+		}
+
+		// The main thread may be blocked in Wait on something that depends on this job
+		{
+			std::lock_guard lock(m_Mutex);
+			m_MainQueued++;
+		}
+		m_JobFinished.notify_all();
+		if (wake)
+			wake();
+		return;
+	}
+
+	if (m_Workers.empty())
+	{
+		Execute(job);
+		return;
+	}
+
+	// Workers keep their own jobs local, everyone else spreads work round robin
+	const size_t index = t_Pool == this ? t_WorkerIndex : m_NextQueue++ % m_Queues.size();
+	{
+		std::lock_guard lock(m_Queues[index]->Mutex);
+		m_Queues[index]->Jobs.emplace_back(job);
+	}
+
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Queued++;
+	}
+	m_Condition.notify_one();
+	if (m_Waiting > 0)
+		m_JobFinished.notify_all();
+}
+
+void ThreadPool::Execute(const JobHandle& job)
+{
+	job->m_Task();
+	job->m_Task = nullptr;
+
+	std::vector<JobHandle> continuations;
+	{
+		std::lock_guard lock(job->m_Mutex);
+		job->m_Done = true; // Sequentially consistent, so it can't be reordered past the m_Waiting check below
+		continuations.swap(job->m_Continuations);
+	}
+
+	for (const auto& continuation : continuations)
+	{
+		if (--continuation->m_Unfinished == 0)
+			Schedule(continuation);
+	}
+
+	if (m_Waiting > 0)
+	{
+		{ std::lock_guard lock(m_Mutex); }
+		m_JobFinished.notify_all();
+	}
+}
+
+bool ThreadPool::TryRunJob()
+{
+	if (m_Queues.empty())
+		return false;
+
+	JobHandle job;
+	const bool isWorker = t_Pool == this;
+	const size_t start = isWorker ? t_WorkerIndex : m_NextQueue.load() % m_Queues.size();
+
+	// Own deque first, newest job first
+	if (isWorker)
+	{
+		WorkQueue& queue = *m_Queues[start];
+		std::lock_guard lock(queue.Mutex);
+		if (!queue.Jobs.empty())
+		{
+			job = std::move(queue.Jobs.back());
+			queue.Jobs.pop_back();
+		}
+	}
+
+	// Then steal the oldest job from someone else
+	for (size_t i = isWorker ? 1 : 0; !job && i < m_Queues.size(); i++)
+	{
+		WorkQueue& queue = *m_Queues[(start + i) % m_Queues.size()];
+		std::lock_guard lock(queue.Mutex);
+		if (!queue.Jobs.empty())
+		{
+			job = std::move(queue.Jobs.front());
+			queue.Jobs.pop_front();
+		}
+	}
+
+	if (!job)
+		return false;
+
+	m_Queued--;
+	Execute(job);
+	return true;
+}
+
+bool ThreadPool::TryRunMainThreadJob()
+{
+	JobHandle job;
+	{
+		std::lock_guard lock(m_MainMutex);
+		if (m_MainJobs.empty())
+			return false;
+
+		job = std::move(m_MainJobs.front());
+		m_MainJobs.pop_front();
+	}
+
+	m_MainQueued--;
+	Execute(job);
+	return true;
+}
+
+void ThreadPool::WorkerLoop(const size_t index)
+{
+	t_Pool = this;
+	t_WorkerIndex = index;
+
+	while (true)
+	{
+		if (TryRunJob())
+			continue;
+
+		std::unique_lock lock(m_Mutex);
+		m_Condition.wait(lock, [this] { return m_Stopping || m_Queued > 0; });
+		if (m_Stopping && m_Queued <= 0)
+			return;
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+// A submitted task. Other tasks can depend on it, and any thread can wait for it to finish
+class Job
+{
+public:
+	bool IsDone() const { return m_Done.load(std::memory_order_acquire); }
+
+private:
+	friend class ThreadPool;
+
+	std::function<void()> m_Task;
+	bool m_MainThread = false;
+	std::atomic<int> m_Unfinished = 1; // Unfinished dependencies, plus one held until submission completes
+	std::atomic<bool> m_Done = false;
+	std::mutex m_Mutex; // Guards m_Continuations against the job finishing concurrently
+	std::vector<std::shared_ptr<Job>> m_Continuations; // Jobs waiting on this one
+};
+
+using JobHandle = std::shared_ptr<Job>;
+
+/* A work-stealing scheduler over a fixed set of worker threads.
+* Each worker owns a deque: it pushes and pops its own jobs at the back, so nested work stays hot in cache,
+* while idle workers steal the oldest jobs from the front of the others. Jobs may depend on other jobs and
+* only become runnable once those finish. Workers never touch OpenGL; jobs that need the context are
+* submitted with main thread affinity and run when the main thread calls RunMainThreadJobs().
+*/
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Queues a task to run on a worker once every dependency has finished
+	JobHandle Submit(std::function<void()> task, const std::vector<JobHandle>& dependencies = {});
+	// Queues a task to run on the main thread once every dependency has finished
+	JobHandle SubmitToMainThread(std::function<void()> task, const std::vector<JobHandle>& dependencies = {});
+
+	// Blocks until the job has finished, running other jobs in the meantime so waiting inside a job can't deadlock
+	void Wait(const JobHandle& job);
+	// Runs every main thread job that is ready. Call once per frame from the main thread
+	void RunMainThreadJobs();
+	// Called from whichever thread makes a main thread job runnable, so a main thread that sleeps between frames can wake for it
+	void SetMainThreadWake(std::function<void()> wake);
+
+	// Runs func(i) for every i in [0, count) across the workers and the calling thread, returning once all have finished.
+	// Safe to call from inside a task, since the caller keeps claiming indices and then helps out until the helpers are done.
+	template<typename Func>
+	void ParallelFor(size_t count, Func&& func);
+
+	size_t GetThreadCount() const { return m_Workers.size(); }
+	bool IsMainThread() const { return std::this_thread::get_id() == m_MainThread; }
+
+	// The process-wide pool. First use must come from the thread owning the GL context, which becomes the pool's main thread
+	static ThreadPool& Get();
+
+	~ThreadPool();
+
+private:
+	struct WorkQueue
+	{
+		std::mutex Mutex;
+		std::deque<JobHandle> Jobs;
+	};
+
+	JobHandle CreateJob(std::function<void()> task, bool mainThread, const std::vector<JobHandle>& dependencies);
+	// Makes a job whose dependencies have all finished runnable
+	void Schedule(const JobHandle& job);
+	void Execute(const JobHandle& job);
+	// Pops from the calling worker's own deque, or steals from another. Returns false if there was nothing to run
+	bool TryRunJob();
+	bool TryRunMainThreadJob();
+	void WorkerLoop(size_t index);
+
+private:
+	std::vector<std::thread> m_Workers;
+	std::vector<std::unique_ptr<WorkQueue>> m_Queues; // One per worker
+	std::atomic<size_t> m_NextQueue = 0; // Round robin target for jobs scheduled from outside the pool
+	std::atomic<long long> m_Queued = 0; // Jobs sitting in worker deques
+
+	std::mutex m_MainMutex;
+	std::deque<JobHandle> m_MainJobs;
+	std::atomic<long long> m_MainQueued = 0;
+	std::function<void()> m_MainThreadWake; // Guarded by m_MainMutex
+	std::thread::id m_MainThread;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition; // Wakes idle workers
+	std::condition_variable m_JobFinished; // Wakes threads blocked in Wait
+	std::atomic<int> m_Waiting = 0;
+	bool m_Stopping = false;
+};
+
+template<typename Func>
+void ThreadPool::ParallelFor(const size_t count, Func&& func)
+{
+	if (count == 0)
+		return;
+
+	// Indices are claimed one at a time, so uneven work spreads itself out
+	auto next = std::make_shared<std::atomic<size_t>>(0);
+	const auto run = [next, count, &func]
+	{
+		for (size_t i = (*next)++; i < count; i = (*next)++)
+			func(i);
+	};
+
+	std::vector<JobHandle> helpers;
+	const size_t helperCount = std::min(count - 1, m_Workers.size());
+	helpers.reserve(helperCount);
+	for (size_t i = 0; i < helperCount; i++)
+		helpers.emplace_back(Submit(run));
+
+	run();
+
+	// Helpers still reference func, so none may outlive this call
+	for (const auto& helper : helpers)
+		Wait(helper);
+}
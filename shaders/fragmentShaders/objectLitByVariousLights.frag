@@ -1,7 +1,8 @@
 #version 460 core
 
-#define TEXTURE_CAPACITY 16
+#define TEXTURE_CAPACITY 8 // Units 0 to 7, the shadow maps sit on units 8 and 9
 #define POINT_LIGHT_CAPACITY 1
+#define CASCADE_CAPACITY 4
 
 #define BASE_COLOR_MASK 1
 #define ALBEDO_MASK     2
@@ -16,6 +17,7 @@ struct Material
 {
     int activeMaps;
     float shininess;
+    vec4 baseColorTransform; // xy = scale, zw = offset into the base color map
 };
 
 struct DirLight
@@ -63,6 +65,17 @@ struct SpotLight
 uniform sampler2D textures[TEXTURE_CAPACITY];
 uniform samplerCube skybox;
 
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 cascadeViewProjections[CASCADE_CAPACITY];
+uniform int cascadeCount;
+
+// Point and spot light shadows share one atlas. Tiles are xy offset, zw scale in the atlas, zero when unshadowed
+uniform sampler2DShadow shadowAtlas;
+uniform mat4 pointShadowMatrices[POINT_LIGHT_CAPACITY * 6]; // Cube faces +X, -X, +Y, -Y, +Z, -Z
+uniform vec4 pointShadowTiles[POINT_LIGHT_CAPACITY * 6];
+uniform mat4 spotShadowMatrix;
+uniform vec4 spotShadowTile;
+
 uniform Material material;
 
 uniform int pointLightCount;
@@ -80,18 +93,30 @@ in VertexData
     vec2 TexCoords;
 } i_VertexData;
 
+in TangentData
+{
+    vec4 Tangent;
+} i_TangentData;
+
 out vec4 FragColor;
 
+vec3 surfaceNormal; // The vertex normal, bent by the normal map if there is one
+
 vec4 CalcDirLight(in DirLight light, in vec3 toViewer, in mat4 textureValues);
-vec4 CalcPointLight(in PointLight light, in vec3 toViewer, in mat4 textureValues);
-vec4 CalcSpotLight(in SpotLight light, in vec3 toViewer, in mat4 textureValues);
+vec4 CalcPointLight(in PointLight light, in vec3 toViewer, in mat4 textureValues, in float shadow);
+vec4 CalcSpotLight(in SpotLight light, in vec3 toViewer, in mat4 textureValues, in float shadow);
 void SetValues(out mat4 textureValues);
+vec3 CalcSurfaceNormal();
 
 float CalcSpec(in vec3 fragToLight, in vec3 toViewer);
+float CalcDirShadow(in vec3 fragToLight);
+float CalcAtlasShadow(in mat4 viewProjection, in vec4 tile, in vec3 fragToLight);
+float CalcPointShadow(in int index, in PointLight light);
 
 void main()
 {
     vec3 toViewer = normalize(viewPos - vec3(i_VertexData.FragPos));
+    surfaceNormal = CalcSurfaceNormal();
 
     mat4 textureValues; // Ambient, Diffuse, Specular, Emissive
 
@@ -102,9 +127,10 @@ void main()
     result += CalcDirLight(dirLight, toViewer, textureValues);
 
     for (int i = 0; i < pointLightCount && i < POINT_LIGHT_CAPACITY; i++)
-        result += CalcPointLight(pointLights[i], toViewer, textureValues);
+        result += CalcPointLight(pointLights[i], toViewer, textureValues, CalcPointShadow(i, pointLights[i]));
 
-    result += CalcSpotLight(spotLight, toViewer, textureValues);
+    vec3 toSpotLight = normalize(vec3(spotLight.position - i_VertexData.FragPos));
+    result += CalcSpotLight(spotLight, toViewer, textureValues, CalcAtlasShadow(spotShadowMatrix, spotShadowTile, toSpotLight));
 
     FragColor = vec4(result.rgb, textureValues[0].a);
 }
@@ -113,7 +139,7 @@ vec4 CalcDirLight(DirLight light, in vec3 toViewer, in mat4 textureValues)
 {
 	vec3 fragToLight = normalize(-light.direction);
 
-    float lambertian = max(dot(i_VertexData.Normal, fragToLight), 0.0);
+    float lambertian = max(dot(surfaceNormal, fragToLight), 0.0);
     float spec = lambertian > 0.0 ? CalcSpec(fragToLight, toViewer) : 0.0;
 
     vec4 ambient  = textureValues[0];
@@ -121,21 +147,92 @@ vec4 CalcDirLight(DirLight light, in vec3 toViewer, in mat4 textureValues)
     vec4 specular = textureValues[2];
     vec4 emissive = textureValues[3];
 
+    float shadow = lambertian > 0.0 ? CalcDirShadow(fragToLight) : 1.0;
+
     ambient  *= light.kA;
-    diffuse  *= light.kD * lambertian;
-    specular *= light.kS * spec;
+    diffuse  *= light.kD * lambertian * shadow;
+    specular *= light.kS * spec * shadow;
 
     return (ambient + diffuse + specular + emissive) * light.color;
 }
 
-vec4 CalcPointLight(PointLight light, in vec3 toViewer, in mat4 textureValues)
+// Fraction of the sun reaching the fragment, from the first cascade that covers it
+float CalcDirShadow(in vec3 fragToLight)
+{
+    for (int i = 0; i < cascadeCount && i < CASCADE_CAPACITY; i++)
+    {
+        vec4 lightSpace = cascadeViewProjections[i] * i_VertexData.FragPos;
+        vec3 coords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+
+        // Leave room for the filter at the window's edge
+        vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+        if (any(lessThan(coords.xy, 2.0 * texel)) || any(greaterThan(coords.xy, 1.0 - 2.0 * texel)) || coords.z > 1.0)
+            continue;
+
+        // Grazing light needs more bias, and each cascade's texels cover more ground than the last
+        float slope = 1.0 - max(dot(i_VertexData.Normal, fragToLight), 0.0);
+        float bias = (0.0005 + 0.002 * slope) * (i + 1);
+
+        float lit = 0.0;
+        for (int x = -1; x <= 1; x++)
+            for (int y = -1; y <= 1; y++)
+                lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * texel, i, coords.z - bias));
+        return lit / 9.0;
+    }
+
+    return 1.0;
+}
+
+// Fraction of a light reaching the fragment, from the light's view in its atlas tile
+float CalcAtlasShadow(in mat4 viewProjection, in vec4 tile, in vec3 fragToLight)
+{
+    if (tile.z == 0.0)
+        return 1.0;
+
+    vec4 lightSpace = viewProjection * i_VertexData.FragPos;
+    vec3 coords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+    if (lightSpace.w <= 0.0 || coords.z > 1.0)
+        return 1.0;
+
+    // Keep the filter inside the tile so it never reads a neighbour's texels
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    vec2 uv = clamp(tile.xy + coords.xy * tile.zw, tile.xy + 1.5 * texel, tile.xy + tile.zw - 1.5 * texel);
+
+    float slope = 1.0 - max(dot(i_VertexData.Normal, fragToLight), 0.0);
+    float bias = 0.00005 + 0.0002 * slope;
+
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(shadowAtlas, vec3(uv + vec2(x, y) * texel, coords.z - bias));
+    return lit / 9.0;
+}
+
+// Picks the cube face the fragment lies in, by the major axis of the direction from the light
+float CalcPointShadow(in int index, in PointLight light)
+{
+    vec3 fromLight = vec3(i_VertexData.FragPos - light.position);
+    vec3 magnitude = abs(fromLight);
+
+    int face;
+    if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z)
+        face = fromLight.x > 0.0 ? 0 : 1;
+    else if (magnitude.y >= magnitude.z)
+        face = fromLight.y > 0.0 ? 2 : 3;
+    else
+        face = fromLight.z > 0.0 ? 4 : 5;
+
+    return CalcAtlasShadow(pointShadowMatrices[index * 6 + face], pointShadowTiles[index * 6 + face], normalize(-fromLight));
+}
+
+vec4 CalcPointLight(PointLight light, in vec3 toViewer, in mat4 textureValues, in float shadow)
 {
     float distance = length(light.position - i_VertexData.FragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
     vec3 fragToLight = normalize(vec3(light.position - i_VertexData.FragPos));
 
-    float lambertian = max(dot(i_VertexData.Normal, fragToLight), 0.0);
+    float lambertian = max(dot(surfaceNormal, fragToLight), 0.0);
     float spec = lambertian > 0.0 ? CalcSpec(fragToLight, toViewer) : 0.0;
 
     vec4 ambient  = textureValues[0];
@@ -144,13 +241,13 @@ vec4 CalcPointLight(PointLight light, in vec3 toViewer, in mat4 textureValues)
     vec4 emissive = textureValues[3];
 
     ambient  *= light.kA * attenuation;
-    diffuse  *= light.kD * attenuation * lambertian;
-    specular *= light.kS * attenuation * spec;
+    diffuse  *= light.kD * attenuation * lambertian * shadow;
+    specular *= light.kS * attenuation * spec * shadow;
 
     return (ambient + diffuse + specular + emissive) * light.color;
 }
 
-vec4 CalcSpotLight(SpotLight light, in vec3 toViewer, in mat4 textureValues)
+vec4 CalcSpotLight(SpotLight light, in vec3 toViewer, in mat4 textureValues, in float shadow)
 {
 
     vec3 fragToLight = normalize(vec3(light.position - i_VertexData.FragPos));
@@ -159,7 +256,7 @@ vec4 CalcSpotLight(SpotLight light, in vec3 toViewer, in mat4 textureValues)
     float epsilon = light.innerCutOff - light.outerCutOff;
     float intensity = clamp((phi - light.outerCutOff) / epsilon, 0.0, 1.0);
 
-    float lambertian = max(dot(i_VertexData.Normal, fragToLight), 0.0);
+    float lambertian = max(dot(surfaceNormal, fragToLight), 0.0);
     float spec = lambertian > 0.0 ? CalcSpec(fragToLight, toViewer) : 0.0;
     
     float distance = length(light.position - i_VertexData.FragPos);
@@ -171,15 +268,15 @@ vec4 CalcSpotLight(SpotLight light, in vec3 toViewer, in mat4 textureValues)
     vec4 emissive = textureValues[3];
 
     ambient  *= light.kA;
-    diffuse  *= light.kD * intensity * attenuation * lambertian;
-    specular *= light.kS * intensity * attenuation * spec;
+    diffuse  *= light.kD * intensity * attenuation * lambertian * shadow;
+    specular *= light.kS * intensity * attenuation * spec * shadow;
 
     return (ambient + diffuse + specular + emissive) * light.color;
 }
 
 float CalcSpec(in vec3 fragToLight, in vec3 toViewer)
 {
-    vec3 reflected = reflect(-fragToLight, i_VertexData.Normal);
+    vec3 reflected = reflect(-fragToLight, surfaceNormal);
 
     float specAngle = max(dot(toViewer, reflected), 0.0);
     return pow(specAngle, material.shininess * 128.0);
@@ -190,7 +287,7 @@ void SetValues(out mat4 textureValues)
     // Iterate through diffuse textures
     if (bool(material.activeMaps & BASE_COLOR_MASK))
     {
-        if (texture(textures[0], i_VertexData.TexCoords).a == 0.0)
+        if (texture(textures[0], i_VertexData.TexCoords * material.baseColorTransform.xy + material.baseColorTransform.zw).a == 0.0)
             discard;
         textureValues[0] += texture(textures[1], i_VertexData.TexCoords);
         textureValues[1] += texture(textures[1], i_VertexData.TexCoords);
@@ -204,3 +301,15 @@ void SetValues(out mat4 textureValues)
     if (bool(material.activeMaps & EMISSIVE_MASK))
         textureValues[3] += texture(textures[7], i_VertexData.TexCoords);
 }
+
+// Normal map texels are in the MikkTSpace frame. Like MikkTSpace, the bitangent is rebuilt from the interpolated normal
+// and tangent, and only the result is normalized
+vec3 CalcSurfaceNormal()
+{
+    if (!bool(material.activeMaps & NORMAL_MASK))
+        return normalize(i_VertexData.Normal);
+
+    vec3 bitangent = i_TangentData.Tangent.w * cross(i_VertexData.Normal, i_TangentData.Tangent.xyz);
+    vec3 texel = texture(textures[5], i_VertexData.TexCoords).xyz * 2.0 - 1.0;
+    return normalize(texel.x * i_TangentData.Tangent.xyz + texel.y * bitangent + texel.z * i_VertexData.Normal);
+}
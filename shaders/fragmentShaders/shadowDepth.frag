@@ -0,0 +1,6 @@
+#version 460 core
+
+// Depth only, the rasteriser writes everything a shadow map needs
+void main()
+{
+}
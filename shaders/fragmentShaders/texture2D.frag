@@ -14,6 +14,7 @@ struct Material
 {
     int activeMaps;
     float shininess;
+    vec4 baseColorTransform; // xy = scale, zw = offset into the base color map
 };
 
 uniform sampler2D textures[TEXTURE_CAPACITY];
@@ -32,7 +33,7 @@ out vec4 FragColor;
 void main()
 {
     if (bool(material.activeMaps & BASE_COLOR_MASK)) {
-	    FragColor = vec4(texture(textures[0], i_VertexData.TexCoords));
+	    FragColor = vec4(texture(textures[0], i_VertexData.TexCoords * material.baseColorTransform.xy + material.baseColorTransform.zw));
     } else {
         FragColor = vec4(1.0, 0.0, 1.0, 1.0);
     }
@@ -3,9 +3,10 @@
 layout (location = 0) in vec4 a_Position;
 layout (location = 1) in vec3 a_Normal;
 layout (location = 2) in vec2 a_TexCoords;
+layout (location = 3) in vec4 a_TangentFrame; // Quaternion rotating +X onto the tangent, a negative w flips the bitangent
 
-uniform mat4 modelInv;
 uniform mat4 model;
+uniform mat3 normalMatrix;
 layout (std140) uniform Matrices
 {
     mat4 projection;
@@ -19,11 +20,27 @@ out VertexData
     vec2 TexCoords;
 } o_VertexData;
 
+// Separate from VertexData, so fragment shaders without normal maps needn't declare it
+out TangentData
+{
+    vec4 Tangent; // xyz in world space, w is the bitangent's sign
+} o_TangentData;
+
+vec3 Rotate(in vec4 q, in vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
 void main()
 {
     o_VertexData.FragPos = model * a_Position;
-    o_VertexData.Normal = normalize(mat3(transpose(modelInv)) * a_Normal);
+    o_VertexData.Normal = normalize(normalMatrix * a_Normal);
     o_VertexData.TexCoords = a_TexCoords;
 
+    // A mirroring model matrix flips the bitangent too
+    vec4 frame = normalize(a_TangentFrame);
+    float sign = (frame.w < 0.0) != (determinant(mat3(model)) < 0.0) ? -1.0 : 1.0;
+    o_TangentData.Tangent = vec4(normalize(mat3(model) * Rotate(frame, vec3(1.0, 0.0, 0.0))), sign);
+
     gl_Position = projection * view * o_VertexData.FragPos;
 } 
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 460 core
+layout (location = 0) in vec4 a_Position;
+
+uniform mat4 model;
+uniform mat4 lightSpace; // The cascade's view projection
+
+void main()
+{
+    gl_Position = lightSpace * model * a_Position;
+}
@@ -0,0 +1,10 @@
+#version 460 core
+layout (location = 0) in vec4 a_Position;
+
+uniform mat4 model;
+
+// World space only, the geometry shader projects into each view
+void main()
+{
+    gl_Position = model * a_Position;
+}